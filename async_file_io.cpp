@@ -0,0 +1,330 @@
+#include "async_file_io.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <uhd/utils/log.hpp>
+#include <utility>
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifdef TXRX_USE_IO_URING
+#include <liburing.h>
+#endif
+
+using std::format;
+using std::string;
+using std::vector;
+
+namespace {
+    // The kernel limits every registered buffer, and a single transfer, to 1 GiB
+    constexpr size_t kMaxChunkBytes = size_t{1} << 30;
+} // namespace
+
+struct AsyncFileIo::Ring {
+#ifdef TXRX_USE_IO_URING
+    io_uring uring{};
+#endif
+};
+
+AsyncFileIo::AsyncFileIo(vector<int> fds, vector<string> names, size_t queue_depth) :
+    fds(std::move(fds)), names(std::move(names)), queue_depth(std::max<size_t>(queue_depth, 1)) {
+#ifdef TXRX_USE_IO_URING
+    auto uring = std::make_unique<Ring>();
+    if (int ret = io_uring_queue_init(static_cast<unsigned>(this->queue_depth), &uring->uring, 0); ret == 0) {
+        ring = std::move(uring);
+        slots.resize(this->queue_depth);
+        for (size_t slot = this->queue_depth; slot-- > 0;) {
+            free_slots.push_back(slot);
+        }
+        return;
+    } else {
+        UHD_LOG_WARNING("FILE-IO", format("io_uring unavailable ({}), using a thread per file", strerror(-ret)));
+    }
+#endif
+    for (size_t file = 0; file < this->fds.size(); ++file) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (size_t file = 0; file < workers.size(); ++file) {
+        workers[file]->thread = std::thread(&AsyncFileIo::WorkerLoop, this, file);
+    }
+}
+
+AsyncFileIo::~AsyncFileIo() {
+    try {
+        Drain();
+    } catch (const std::exception &e) {
+        UHD_LOG_ERROR("FILE-IO", format("Error while finishing file I/O: {}", e.what()));
+    }
+    if (ring) {
+#ifdef TXRX_USE_IO_URING
+        io_uring_queue_exit(&ring->uring);
+#endif
+        return;
+    }
+    {
+        std::lock_guard lock(mutex);
+        shutdown = true;
+    }
+    for (auto &worker: workers) {
+        worker->cv.notify_one();
+    }
+    for (auto &worker: workers) {
+        worker->thread.join();
+    }
+}
+
+void AsyncFileIo::RegisterBuffers(std::span<std::byte> memory) {
+    if (not ring or memory.empty()) {
+        return;
+    }
+#ifdef TXRX_USE_IO_URING
+    vector<iovec> iovecs;
+    for (size_t offset = 0; offset < memory.size(); offset += kMaxChunkBytes) {
+        iovecs.push_back({memory.data() + offset, std::min(kMaxChunkBytes, memory.size() - offset)});
+    }
+    if (int ret = io_uring_register_buffers(&ring->uring, iovecs.data(), static_cast<unsigned>(iovecs.size())); ret < 0) {
+        UHD_LOG_DEBUG("FILE-IO", format("Cannot register {} MiB of I/O buffers ({}), using plain writes", memory.size() >> 20, strerror(-ret)));
+        return;
+    }
+    for (size_t i = 0; i < iovecs.size(); ++i) {
+        registered[static_cast<const std::byte *>(iovecs[i].iov_base)] = {iovecs[i].iov_len, static_cast<int>(i)};
+    }
+#endif
+}
+
+void AsyncFileIo::Write(size_t file, const std::byte *data, size_t bytes, uint64_t offset, uint64_t tag) {
+    Request request{file, const_cast<std::byte *>(data), bytes, offset, tag, true, kNotFixed};
+    // A fixed write must lie within one registered buffer
+    if (auto it = registered.upper_bound(data); it != registered.begin()) {
+        --it;
+        if (data + bytes <= it->first + it->second.first) {
+            request.buf_index = it->second.second;
+        }
+    }
+    Submit(request);
+}
+
+void AsyncFileIo::Read(size_t file, std::byte *data, size_t bytes, uint64_t offset, uint64_t tag) { Submit({file, data, bytes, offset, tag, false, kNotFixed}); }
+
+std::vector<uint64_t> AsyncFileIo::Reap() {
+    if (not reaped.empty()) {
+        return std::exchange(reaped, {});
+    }
+    if (in_flight == 0) {
+        return {};
+    }
+    return WaitCompletions();
+}
+
+void AsyncFileIo::Drain() {
+    // Every request is waited for even after an error, so no buffer is still in use on return
+    std::exception_ptr error;
+    while (in_flight > 0) {
+        try {
+            WaitCompletions();
+        } catch (...) {
+            if (not error) {
+                error = std::current_exception();
+            }
+        }
+    }
+    reaped.clear();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void AsyncFileIo::Submit(Request request) {
+    if (request.file >= fds.size()) {
+        throw std::out_of_range(format("No file {} (have {})", request.file, fds.size()));
+    }
+    while (in_flight >= queue_depth) {
+        auto tags = WaitCompletions();
+        reaped.insert(reaped.end(), tags.begin(), tags.end());
+    }
+
+    ++in_flight;
+    if (ring) {
+        const size_t slot = free_slots.back();
+        free_slots.pop_back();
+        slots[slot] = request;
+        try {
+            SubmitToRing(slot);
+        } catch (...) {
+            free_slots.push_back(slot);
+            --in_flight;
+            throw;
+        }
+        return;
+    }
+
+    Worker &worker = *workers[request.file];
+    {
+        std::lock_guard lock(mutex);
+        worker.queue.push_back(request);
+    }
+    worker.cv.notify_one();
+}
+
+void AsyncFileIo::SubmitToRing(size_t slot) {
+#ifdef TXRX_USE_IO_URING
+    const Request &request = slots[slot];
+    // At most queue_depth requests are in flight and every one is submitted right away, so an entry is always free
+    io_uring_sqe *sqe = io_uring_get_sqe(&ring->uring);
+    if (sqe == nullptr) {
+        throw std::runtime_error("io_uring submission queue full");
+    }
+    const int fd = fds[request.file];
+    const auto bytes = static_cast<unsigned>(std::min(request.bytes, kMaxChunkBytes));
+    if (not request.write) {
+        io_uring_prep_read(sqe, fd, request.data, bytes, request.offset);
+    } else if (request.buf_index != kNotFixed) {
+        io_uring_prep_write_fixed(sqe, fd, request.data, bytes, request.offset, request.buf_index);
+    } else {
+        io_uring_prep_write(sqe, fd, request.data, bytes, request.offset);
+    }
+    io_uring_sqe_set_data64(sqe, slot);
+    if (int ret = io_uring_submit(&ring->uring); ret < 0) {
+        throw std::runtime_error(format("io_uring submit failed: {}", strerror(-ret)));
+    }
+#endif
+}
+
+std::vector<uint64_t> AsyncFileIo::WaitCompletions() {
+    if (ring) {
+        return WaitRing();
+    }
+
+    std::unique_lock lock(mutex);
+    done_cv.wait(lock, [this] { return not done.empty(); });
+    auto finished = std::exchange(done, {});
+    lock.unlock();
+
+    in_flight -= finished.size();
+    vector<uint64_t> tags;
+    const Completion *failure = nullptr;
+    for (const auto &completion: finished) {
+        if (completion.failed) {
+            failure = &completion;
+        } else {
+            tags.push_back(completion.tag);
+        }
+    }
+    if (failure) {
+        throw std::runtime_error(failure->error);
+    }
+    return tags;
+}
+
+std::vector<uint64_t> AsyncFileIo::WaitRing() {
+    vector<uint64_t> tags;
+#ifdef TXRX_USE_IO_URING
+    io_uring_cqe *cqe;
+    if (int ret = io_uring_wait_cqe(&ring->uring, &cqe); ret < 0) {
+        if (ret == -EINTR) {
+            return tags;
+        }
+        throw std::runtime_error(format("io_uring wait failed: {}", strerror(-ret)));
+    }
+
+    bool failed = false;
+    string error;
+    do {
+        const size_t slot = io_uring_cqe_get_data64(cqe);
+        const int res = cqe->res;
+        io_uring_cqe_seen(&ring->uring, cqe);
+
+        Request &request = slots[slot];
+        bool finished = true;
+        bool request_failed = false;
+        if (res == -EINTR or res == -EAGAIN) {
+            finished = false;
+        } else if (res < 0) {
+            request_failed = true;
+            error = format("{} {} failed: {}", request.write ? "Write to" : "Read from", names[request.file], strerror(-res));
+        } else if (res == 0 and request.write) {
+            request_failed = true;
+            error = format("Write to {} made no progress", names[request.file]);
+        } else if (res > 0 and static_cast<size_t>(res) < request.bytes) {
+            // Short transfer: continue where it stopped (a read that hit the end of the file stops at 0)
+            request.data += res;
+            request.bytes -= res;
+            request.offset += res;
+            finished = false;
+        }
+
+        if (not finished) {
+            try {
+                SubmitToRing(slot);
+                continue;
+            } catch (const std::exception &e) {
+                request_failed = true;
+                error = e.what();
+            }
+        }
+        if (not request_failed) {
+            tags.push_back(request.tag);
+        }
+        failed = failed or request_failed;
+        free_slots.push_back(slot);
+        --in_flight;
+    } while (io_uring_peek_cqe(&ring->uring, &cqe) == 0);
+
+    if (failed) {
+        throw std::runtime_error(error);
+    }
+#endif
+    return tags;
+}
+
+void AsyncFileIo::WorkerLoop(size_t file) {
+    Worker &worker = *workers[file];
+    const int fd = fds[file];
+    while (true) {
+        Request request;
+        {
+            std::unique_lock lock(mutex);
+            worker.cv.wait(lock, [&] { return shutdown or not worker.queue.empty(); });
+            if (worker.queue.empty()) {
+                return;
+            }
+            request = worker.queue.front();
+            worker.queue.pop_front();
+        }
+
+        bool failed = false;
+        string error;
+        while (request.bytes > 0) {
+            const ssize_t n = request.write ? pwrite(fd, request.data, request.bytes, static_cast<off_t>(request.offset))
+                                            : pread(fd, request.data, request.bytes, static_cast<off_t>(request.offset));
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                failed = true;
+                error = format("{} {} failed: {}", request.write ? "Write to" : "Read from", names[file], strerror(errno));
+                break;
+            }
+            if (n == 0) {
+                // End of file for a read
+                if (request.write) {
+                    failed = true;
+                    error = format("Write to {} made no progress", names[file]);
+                }
+                break;
+            }
+            request.data += n;
+            request.bytes -= n;
+            request.offset += n;
+        }
+
+        {
+            std::lock_guard lock(mutex);
+            done.push_back({request.tag, failed, std::move(error)});
+        }
+        done_cv.notify_one();
+    }
+}
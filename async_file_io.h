@@ -0,0 +1,146 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Positional reads and writes on a set of files, with many requests in flight
+ *
+ * Built with TXRX_USE_IO_URING (liburing found by CMake), the requests of every file go
+ * through one io_uring, up to queue_depth at a time, and writes from buffers passed to
+ * RegisterBuffers use fixed buffers, so the kernel does not pin their pages on every
+ * request. Without liburing, or when the kernel refuses to set up a ring, each file gets a
+ * worker thread issuing pread / pwrite. Either way the files are served in parallel, so
+ * throughput grows with the number of files instead of being serialized on one thread.
+ *
+ * Requests are identified by a caller-chosen tag; Reap returns the tags of finished ones.
+ * Short transfers are resumed until the request is complete. The object is used from one
+ * thread.
+ */
+class AsyncFileIo {
+public:
+    /**
+     * @param fds Open files, identified by their index in later requests; not closed here
+     * @param names File names for error messages
+     * @param queue_depth Maximum number of requests in flight over all files
+     */
+    AsyncFileIo(std::vector<int> fds, std::vector<std::string> names, size_t queue_depth);
+
+    /**
+     * Waits for the requests still in flight (their errors are dropped)
+     */
+    ~AsyncFileIo();
+
+    AsyncFileIo(const AsyncFileIo &) = delete;
+
+    AsyncFileIo &operator=(const AsyncFileIo &) = delete;
+
+    /**
+     * Registers memory that later writes come from, before the first request (io_uring only)
+     *
+     * Failing to register (e.g. RLIMIT_MEMLOCK) only costs the fixed-buffer speedup.
+     */
+    void RegisterBuffers(std::span<std::byte> memory);
+
+    /**
+     * Queues a write of bytes from data at offset in file, waiting for a free slot first
+     */
+    void Write(size_t file, const std::byte *data, size_t bytes, uint64_t offset, uint64_t tag);
+
+    /**
+     * Queues a read of bytes at offset in file into data, waiting for a free slot first
+     *
+     * A read that reaches the end of the file finishes with what was read (see Reap).
+     */
+    void Read(size_t file, std::byte *data, size_t bytes, uint64_t offset, uint64_t tag);
+
+    /**
+     * Collects finished requests, waiting for at least one if any is in flight
+     *
+     * @return Tags of the requests that finished
+     * @throws std::runtime_error if a request failed
+     */
+    std::vector<uint64_t> Reap();
+
+    /**
+     * Waits until every queued request has finished
+     *
+     * @throws std::runtime_error if a request failed
+     */
+    void Drain();
+
+    [[nodiscard]] size_t InFlight() const { return in_flight; }
+
+    [[nodiscard]] size_t QueueDepth() const { return queue_depth; }
+
+    /**
+     * @return "io_uring" or "threads"
+     */
+    [[nodiscard]] const char *Backend() const { return ring ? "io_uring" : "threads"; }
+
+private:
+    static constexpr int kNotFixed = -1;
+
+    struct Request {
+        size_t file{0};
+        std::byte *data{nullptr};
+        size_t bytes{0}; // Left to transfer
+        uint64_t offset{0};
+        uint64_t tag{0};
+        bool write{false};
+        int buf_index{kNotFixed}; // Registered buffer holding data, or kNotFixed
+    };
+
+    std::vector<int> fds;
+    std::vector<std::string> names;
+    size_t queue_depth;
+    size_t in_flight{0};
+
+    // io_uring backend
+    struct Ring;
+    std::unique_ptr<Ring> ring;
+    std::vector<Request> slots; // Requests in flight, indexed by their user_data (the slot)
+    std::vector<size_t> free_slots;
+    std::map<const std::byte *, std::pair<size_t, int>> registered; // Start -> (length, buffer index)
+
+    // Thread backend: one worker per file
+    struct Worker {
+        std::deque<Request> queue;
+        std::condition_variable cv;
+        std::thread thread;
+    };
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    std::vector<std::unique_ptr<Worker>> workers;
+    struct Completion {
+        uint64_t tag{0};
+        bool failed{false};
+        std::string error;
+    };
+    std::vector<Completion> done; // Finished by the workers
+    bool shutdown{false};
+
+    std::vector<uint64_t> reaped; // Finished while Submit waited for a free slot, returned by the next Reap
+
+    void Submit(Request request);
+
+    void SubmitToRing(size_t slot);
+
+    /**
+     * Waits for at least one completion of the active backend
+     */
+    std::vector<uint64_t> WaitCompletions();
+
+    std::vector<uint64_t> WaitRing();
+
+    void WorkerLoop(size_t file);
+};
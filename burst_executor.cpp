@@ -0,0 +1,599 @@
+#include "burst_executor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <future>
+
+using std::format;
+using std::string;
+
+namespace {
+    // 每通道的 RX 容量：扫频为所有频点之和，批量执行为所有突发之和
+    size_t RxCapacity(const BurstJob &job) {
+        if (not job.schedule.empty()) {
+            size_t total = 0;
+            for (const auto &burst: job.schedule) {
+                total += burst.rx_samps;
+            }
+            return total;
+        }
+        return job.config.sweep_freqs.empty() ? job.config.rx_samps : SweepSamples(job.config);
+    }
+
+    // 批量执行中下一个突发的配置：样本数取自该突发，给出频率时重调谐，否则沿用之前的频率
+    void ApplyBurst(UsrpConfig &config, const ScheduledBurst &burst) {
+        config.tx_samps = burst.tx_samps;
+        config.rx_samps = burst.rx_samps;
+        if (not burst.tx_freqs.empty()) {
+            config.tx_freqs = burst.tx_freqs;
+        }
+        if (not burst.rx_freqs.empty()) {
+            config.rx_freqs = burst.rx_freqs;
+        }
+    }
+} // namespace
+
+BurstExecutor::BurstExecutor(UsrpTransceiver &transceiver, zmq::context_t &ctx, const string &done_endpoint, const string &rx_shm_name,
+                             size_t rx_pool_size, double lead, std::atomic<bool> &stop_signal) :
+    transceiver(transceiver), done_sock(ctx, zmq::socket_type::pair), rx_pool(rx_shm_name, rx_pool_size), lead(lead), stop_signal(stop_signal) {
+    done_sock.connect(done_endpoint);
+    worker = std::thread(&BurstExecutor::Run, this);
+}
+
+BurstExecutor::~BurstExecutor() {
+    {
+        std::lock_guard lock(mutex);
+        shutdown = true;
+    }
+    abort_running = true;
+    cv.notify_all();
+    worker.join();
+}
+
+uint64_t BurstExecutor::Submit(BurstJob job) {
+    uint64_t id;
+    {
+        std::lock_guard lock(mutex);
+        id = job.id = next_job_id++;
+        jobs[id] = JobRecord{};
+        queue.push_back(std::move(job));
+    }
+    cv.notify_one();
+    return id;
+}
+
+usrp_proto::Response BurstExecutor::Status(uint64_t job_id) const {
+    std::lock_guard lock(mutex);
+    auto it = jobs.find(job_id);
+    if (it == jobs.end()) {
+        throw std::runtime_error(format("Unknown job {}", job_id));
+    }
+
+    usrp_proto::Response status;
+    if (it->second.state == usrp_proto::JOB_QUEUED) {
+        auto pos = std::ranges::find(queue, job_id, &BurstJob::id);
+        status.set_queue_position(pos - queue.begin() + (busy ? 1 : 0));
+        status.set_status(usrp_proto::SUCCESS);
+    } else if (it->second.state == usrp_proto::JOB_RUNNING) {
+        status.set_status(usrp_proto::SUCCESS);
+    } else {
+        status = it->second.result;
+    }
+    status.set_job_id(job_id);
+    status.set_job_state(it->second.state);
+    return status;
+}
+
+usrp_proto::JobState BurstExecutor::Cancel(uint64_t job_id, std::vector<string> &envelope) {
+    std::lock_guard lock(mutex);
+    auto it = jobs.find(job_id);
+    if (it == jobs.end()) {
+        return usrp_proto::JOB_UNKNOWN;
+    }
+    if (it->second.state == usrp_proto::JOB_RUNNING) {
+        abort_running = true;
+        return usrp_proto::JOB_RUNNING;
+    }
+    if (it->second.state != usrp_proto::JOB_QUEUED) {
+        return it->second.state;
+    }
+
+    auto pos = std::ranges::find(queue, job_id, &BurstJob::id);
+    envelope = std::move(pos->envelope);
+    queue.erase(pos);
+
+    it->second.state = usrp_proto::JOB_CANCELLED;
+    it->second.result.set_status(usrp_proto::ERROR);
+    it->second.result.set_msg("Cancelled");
+    finished.push_back(job_id);
+    UHD_LOG_INFO("BURST", format("Job {} cancelled before it started", job_id));
+    return usrp_proto::JOB_CANCELLED;
+}
+
+bool BurstExecutor::Idle() const {
+    std::lock_guard lock(mutex);
+    return queue.empty() and not busy;
+}
+
+size_t BurstExecutor::Pending() const {
+    std::lock_guard lock(mutex);
+    return queue.size();
+}
+
+void BurstExecutor::Run() {
+    while (true) {
+        BurstJob job;
+        bool back_to_back;
+        {
+            std::unique_lock lock(mutex);
+            busy = false;
+            // A job that is already here when the previous burst ends can follow it directly
+            back_to_back = not queue.empty() and have_previous;
+            cv.wait(lock, [this] { return shutdown or not queue.empty(); });
+            if (shutdown) {
+                break;
+            }
+            job = std::move(queue.front());
+            queue.pop_front();
+            busy = true;
+            jobs[job.id].state = usrp_proto::JOB_RUNNING;
+            abort_running = false;
+        }
+
+        usrp_proto::Response reply;
+        try {
+            Execute(job, back_to_back, reply);
+        } catch (const std::exception &e) {
+            reply.Clear();
+            reply.set_status(usrp_proto::ERROR);
+            reply.set_msg(e.what());
+            have_previous = false;
+            UHD_LOG_ERROR("BURST", format("Exception: {}", e.what()));
+        }
+        Finish(job, reply);
+    }
+}
+
+void BurstExecutor::Execute(BurstJob &job, bool back_to_back, usrp_proto::Response &reply) {
+    const UsrpConfig &config = job.config;
+    // Re-syncing the device time invalidates previous_end; other changes are applied incrementally
+    const bool resync = config.clock_source != transceiver.Config().clock_source or config.time_source != transceiver.Config().time_source;
+    // 批量执行时先应用第一个突发的配置，之后的突发在 CaptureSchedule 中逐个应用
+    UsrpConfig first_config = config;
+    if (not job.schedule.empty()) {
+        ApplyBurst(first_config, job.schedule.front());
+    }
+    const auto config_start = std::chrono::steady_clock::now();
+    transceiver.ApplyConfiguration(first_config, stop_signal);
+    std::chrono::duration<double> config_time = std::chrono::steady_clock::now() - config_start;
+
+    if (back_to_back and not resync) {
+        transceiver.ScheduleAfter(previous_end, lead);
+    } else {
+        transceiver.CalculateTransmissionTime();
+    }
+
+    // RX goes into a segment no client is still reading
+    const size_t sample_size = SampleSize(config.cpu_format);
+    const size_t num_rx_ch = config.rx_channels.size();
+    const size_t rx_capacity = RxCapacity(job); // 每通道容量
+    const size_t total_rx_bytes = num_rx_ch * rx_capacity * sample_size;
+    ShmSegment &segment = rx_pool.Acquire(job.rx_shm_name, job.client, total_rx_bytes, config.numa_node);
+    // 指标是累计值，本次突发的部分是前后两次快照之差
+    const StreamMetricsSnapshot tx_before = transceiver.TxMetrics();
+    const StreamMetricsSnapshot rx_before = transceiver.RxMetrics();
+    try {
+        if (job.schedule.empty()) {
+            Capture(job, segment, reply);
+        } else {
+            CaptureSchedule(job, transceiver.start_time, segment, reply, config_time);
+        }
+    } catch (...) {
+        rx_pool.Finish(segment, false);
+        throw;
+    }
+    rx_pool.Finish(segment, true);
+    reply.set_config_time(config_time.count());
+    SetStreamMetrics(*reply.mutable_tx_metrics(), transceiver.TxMetrics().Since(tx_before));
+    SetStreamMetrics(*reply.mutable_rx_metrics(), transceiver.RxMetrics().Since(rx_before));
+}
+
+void BurstExecutor::WaitTransmit(std::future<void> &tx_thread, std::atomic<bool> &tx_stop) {
+    // 有限次重复发射可能比接收更长：取消或关闭时也要停止
+    while (tx_thread.wait_for(std::chrono::milliseconds(10)) != std::future_status::ready) {
+        if (abort_running) {
+            tx_stop = true;
+        }
+    }
+}
+
+void BurstExecutor::Capture(const BurstJob &job, ShmSegment &segment, usrp_proto::Response &reply) {
+    const UsrpConfig &config = job.config;
+    const size_t sample_size = SampleSize(config.cpu_format);
+    const size_t num_rx_ch = config.rx_channels.size();
+    const size_t rx_capacity = RxCapacity(job);
+
+    std::vector<std::byte *> rx_ptrs;
+    std::byte *raw_rx_ptr = static_cast<std::byte *>(segment.data());
+    for (size_t i = 0; raw_rx_ptr and i < num_rx_ch; ++i) {
+        rx_ptrs.push_back(raw_rx_ptr + i * rx_capacity * sample_size);
+    }
+
+    // 发射在接收结束后停止（tx_repeat = 0 时无限循环发射，直到接收完成）
+    std::atomic<bool> tx_stop{false};
+    const uhd::time_spec_t start_time = transceiver.start_time;
+    auto tx_thread = std::async(std::launch::async, &UsrpTransceiver::TransmitFromBuffer, &transceiver, std::cref(job.tx_views), std::ref(tx_stop));
+    std::vector<SweepSegment> sweep;
+    std::vector<TriggerWindow> windows;
+    auto rx_future = std::async(std::launch::async, [&] {
+        if (not config.trigger_mode.empty()) {
+            // 触发采集的窗口依次紧密存放，总长度即收到的样本数
+            windows = transceiver.ReceiveTriggered(rx_ptrs, abort_running);
+            return windows.empty() ? size_t{0} : windows.back().offset + windows.back().nsamps;
+        }
+        if (config.sweep_freqs.empty()) {
+            return transceiver.ReceiveToMemory(rx_ptrs, abort_running);
+        }
+        // 扫频时各频点的数据段位置由 sweep_segments 给出，段内未收满的部分不压紧
+        sweep = transceiver.ReceiveSweep(rx_ptrs, abort_running);
+        return rx_capacity;
+    });
+
+    size_t rx_samps_per_ch;
+    try {
+        rx_samps_per_ch = rx_future.get();
+    } catch (...) {
+        tx_stop = true;
+        throw;
+    }
+    if (config.tx_repeat == 0) {
+        tx_stop = true;
+    }
+    WaitTransmit(tx_thread, tx_stop);
+    previous_end = transceiver.BurstEndTime();
+    have_previous = true;
+
+    // 提前停止时收到的样本少于容量：把各通道数据压紧，保持 [通道][样本] 连续布局
+    if (rx_samps_per_ch < rx_capacity) {
+        for (size_t i = 1; i < num_rx_ch; ++i) {
+            std::memmove(raw_rx_ptr + i * rx_samps_per_ch * sample_size, rx_ptrs[i], rx_samps_per_ch * sample_size);
+        }
+        segment.Resize(num_rx_ch * rx_samps_per_ch * sample_size);
+    }
+
+    reply.set_status(usrp_proto::SUCCESS);
+    reply.set_rx_shm_name(segment.name());
+    reply.set_rx_nsamps_per_ch(rx_samps_per_ch);
+    reply.set_num_rx_ch(num_rx_ch);
+    reply.set_cpu_format(config.cpu_format);
+    reply.set_start_time(start_time.get_real_secs());
+    SetStreamStats(reply, transceiver.Stats());
+    for (const auto &hop: sweep) {
+        auto *proto_segment = reply.add_sweep_segments();
+        proto_segment->set_freq(hop.freq);
+        proto_segment->set_offset(hop.offset);
+        proto_segment->set_nsamps(hop.nsamps);
+        proto_segment->set_time_full(hop.time_spec.get_full_secs());
+        proto_segment->set_time_frac(hop.time_spec.get_frac_secs());
+    }
+    for (const auto &window: windows) {
+        auto *proto_window = reply.add_trigger_windows();
+        proto_window->set_offset(window.offset);
+        proto_window->set_nsamps(window.nsamps);
+        proto_window->set_time_full(window.time_spec.get_full_secs());
+        proto_window->set_time_frac(window.time_spec.get_frac_secs());
+        proto_window->set_trigger_full(window.trigger_time.get_full_secs());
+        proto_window->set_trigger_frac(window.trigger_time.get_frac_secs());
+        proto_window->set_metric(window.metric);
+    }
+}
+
+void BurstExecutor::CaptureSchedule(const BurstJob &job, const uhd::time_spec_t &first_start, ShmSegment &segment, usrp_proto::Response &reply,
+                                    std::chrono::duration<double> &config_time) {
+    UsrpConfig config = job.config;
+    ApplyBurst(config, job.schedule.front());
+    const size_t sample_size = SampleSize(config.cpu_format);
+    const size_t tx_sample_size = SampleSize(TxStreamFormat(config)); // 暂存过的 TX 数据已是流格式
+    const size_t num_rx_ch = config.rx_channels.size();
+    const size_t rx_capacity = RxCapacity(job);
+    std::byte *raw_rx_ptr = static_cast<std::byte *>(segment.data());
+
+    const double settle = SweepSettle(config);
+
+    StreamStats total;
+    size_t rx_offset = 0;
+    uhd::time_spec_t schedule_start;
+    for (size_t i = 0; i < job.schedule.size() and not abort_running; ++i) {
+        const ScheduledBurst &burst = job.schedule[i];
+        // 按 time_offset 定时开始，但不早于上一个突发结束，并为定时命令留出 lead
+        const uhd::time_spec_t planned = first_start + uhd::time_spec_t(burst.time_offset);
+        if (i > 0) {
+            // 重调谐在上一个突发结束后执行，本突发在 settle 之后开始
+            const double guard = burst.tx_freqs.empty() and burst.rx_freqs.empty() ? 0.0 : settle;
+            const uhd::time_spec_t earliest = previous_end + uhd::time_spec_t(guard);
+            transceiver.ScheduleAfter(earliest > planned ? earliest : planned, lead + guard);
+            // 变化的频率作为定时命令排入设备队列，不等待调谐完成；锁定状态在整批结束后检查一次
+            ApplyBurst(config, burst);
+            const auto config_start = std::chrono::steady_clock::now();
+            transceiver.ApplyTimedRetune(config, transceiver.start_time - uhd::time_spec_t(guard));
+            config_time += std::chrono::steady_clock::now() - config_start;
+        } else {
+            transceiver.ScheduleAfter(planned, lead);
+        }
+        const uhd::time_spec_t start_time = transceiver.start_time;
+        if (i == 0) {
+            schedule_start = start_time;
+        }
+
+        std::vector<std::byte *> rx_ptrs;
+        for (size_t ch = 0; raw_rx_ptr and ch < num_rx_ch; ++ch) {
+            rx_ptrs.push_back(raw_rx_ptr + (ch * rx_capacity + rx_offset) * sample_size);
+        }
+        std::vector<TxChannelView> tx_views;
+        for (const auto &view: job.tx_views) {
+            tx_views.push_back(view.subspan(burst.tx_offset * tx_sample_size, burst.tx_samps * tx_sample_size));
+        }
+
+        std::atomic<bool> tx_stop{false};
+        const bool transmit = burst.tx_samps > 0 and not tx_views.empty();
+        std::future<void> tx_thread;
+        if (transmit) {
+            tx_thread = std::async(std::launch::async, &UsrpTransceiver::TransmitFromBuffer, &transceiver, std::cref(tx_views), std::ref(tx_stop));
+        }
+        auto rx_future = std::async(std::launch::async, &UsrpTransceiver::ReceiveToMemory, &transceiver, std::cref(rx_ptrs), std::ref(abort_running));
+        size_t rx_samps_per_ch;
+        try {
+            rx_samps_per_ch = rx_future.get();
+        } catch (...) {
+            tx_stop = true;
+            throw;
+        }
+        if (transmit) {
+            WaitTransmit(tx_thread, tx_stop);
+        }
+        previous_end = transceiver.BurstEndTime();
+        have_previous = true;
+
+        // 只累计本突发实际运行的方向：未运行的方向的统计仍是上一个突发的
+        const StreamStats stats = transceiver.Stats();
+        auto *result = reply.add_bursts();
+        result->set_offset(rx_offset);
+        result->set_nsamps(rx_samps_per_ch);
+        result->set_time_full(start_time.get_full_secs());
+        result->set_time_frac(start_time.get_frac_secs());
+        if (burst.rx_samps > 0) {
+            total.rx_overflows += stats.rx_overflows;
+            total.rx_dropped += stats.rx_dropped;
+            for (const auto &gap: stats.rx_gaps) {
+                total.rx_gaps.push_back({gap.offset + rx_offset, gap.nsamps});
+            }
+            result->set_rx_overflows(stats.rx_overflows);
+        }
+        if (transmit) {
+            total.tx_underflows += stats.tx_underflows;
+            total.tx_seq_errors += stats.tx_seq_errors;
+            total.tx_time_errors += stats.tx_time_errors;
+            result->set_tx_underflows(stats.tx_underflows);
+        }
+        rx_offset += burst.rx_samps;
+    }
+    UHD_LOG_INFO("BURST", format("Schedule finished: {} of {} bursts", reply.bursts_size(), job.schedule.size()));
+
+    // 所有重调谐都已执行，整批只检查一次锁定状态
+    const auto lock_start = std::chrono::steady_clock::now();
+    transceiver.CheckRetuneLocks();
+    config_time += std::chrono::steady_clock::now() - lock_start;
+
+    // 各突发的数据段位置由 bursts 给出，段内未收满的部分不压紧
+    reply.set_status(usrp_proto::SUCCESS);
+    reply.set_rx_shm_name(segment.name());
+    reply.set_rx_nsamps_per_ch(rx_capacity);
+    reply.set_num_rx_ch(num_rx_ch);
+    reply.set_cpu_format(config.cpu_format);
+    reply.set_start_time(schedule_start.get_real_secs());
+    SetStreamStats(reply, total);
+}
+
+void SetStreamStats(usrp_proto::Response &reply, const StreamStats &stats) {
+    reply.set_rx_overflows(stats.rx_overflows);
+    reply.set_rx_dropped_samps(stats.rx_dropped);
+    for (const auto &gap: stats.rx_gaps) {
+        auto *proto_gap = reply.add_rx_gaps();
+        proto_gap->set_offset(gap.offset);
+        proto_gap->set_nsamps(gap.nsamps);
+    }
+    reply.set_tx_underflows(stats.tx_underflows);
+    reply.set_tx_seq_errors(stats.tx_seq_errors);
+    reply.set_tx_time_errors(stats.tx_time_errors);
+}
+
+void SetStreamMetrics(usrp_proto::StreamMetrics &proto, const StreamMetricsSnapshot &metrics) {
+    proto.set_samples(metrics.samples);
+    proto.set_calls(metrics.calls);
+    proto.set_timeouts(metrics.timeouts);
+    proto.set_overflows(metrics.overflows);
+    proto.set_underflows(metrics.underflows);
+    proto.set_late_packets(metrics.late_packets);
+    proto.set_seq_errors(metrics.seq_errors);
+    proto.set_call_seconds(static_cast<double>(metrics.latency_ns) * 1e-9);
+    proto.mutable_call_buckets()->Assign(metrics.latency_buckets.begin(), metrics.latency_buckets.end());
+    proto.set_first_sample_offset(metrics.first_sample_offset);
+    proto.set_first_sample_wait(metrics.first_sample_wait);
+}
+
+void BurstExecutor::Finish(const BurstJob &job, usrp_proto::Response &reply) {
+    {
+        std::lock_guard lock(mutex);
+        auto state = reply.status() != usrp_proto::SUCCESS ? usrp_proto::JOB_FAILED : abort_running ? usrp_proto::JOB_CANCELLED : usrp_proto::JOB_DONE;
+        reply.set_job_id(job.id);
+        reply.set_job_state(state);
+        jobs[job.id] = JobRecord{state, reply};
+
+        finished.push_back(job.id);
+        while (finished.size() > kMaxFinishedJobs) {
+            jobs.erase(finished.front());
+            finished.pop_front();
+        }
+    }
+
+    string serialized_reply;
+    reply.SerializeToString(&serialized_reply);
+
+    for (const auto &frame: job.envelope) {
+        done_sock.send(zmq::buffer(frame), zmq::send_flags::sndmore);
+    }
+    done_sock.send(zmq::buffer(serialized_reply), zmq::send_flags::none);
+}
+
+// 辅助函数：将 Protobuf 配置转换为原生结构体
+// host 提供线程与 NUMA 设置的默认值（来自服务器命令行）
+UsrpConfig ConvertConfig(const usrp_proto::UsrpConfig &proto_cfg, const UsrpConfig &host) {
+    UsrpConfig c;
+    c.clock_source = proto_cfg.clock_source();
+    c.time_source = proto_cfg.time_source();
+    c.spb = proto_cfg.spb();
+    c.delay = proto_cfg.delay();
+    c.rx_samps = proto_cfg.rx_samps();
+    c.tx_samps = proto_cfg.tx_samps();
+    c.tx_repeat = proto_cfg.has_tx_repeat() ? proto_cfg.tx_repeat() : 1;
+
+    c.tx_channels.assign(proto_cfg.tx_channels().begin(), proto_cfg.tx_channels().end());
+    c.rx_channels.assign(proto_cfg.rx_channels().begin(), proto_cfg.rx_channels().end());
+    c.tx_rates.assign(proto_cfg.tx_rates().begin(), proto_cfg.tx_rates().end());
+    c.rx_rates.assign(proto_cfg.rx_rates().begin(), proto_cfg.rx_rates().end());
+    c.tx_freqs.assign(proto_cfg.tx_freqs().begin(), proto_cfg.tx_freqs().end());
+    c.rx_freqs.assign(proto_cfg.rx_freqs().begin(), proto_cfg.rx_freqs().end());
+    c.tx_gains.assign(proto_cfg.tx_gains().begin(), proto_cfg.tx_gains().end());
+    c.rx_gains.assign(proto_cfg.rx_gains().begin(), proto_cfg.rx_gains().end());
+    c.tx_ants.assign(proto_cfg.tx_ants().begin(), proto_cfg.tx_ants().end());
+    c.rx_ants.assign(proto_cfg.rx_ants().begin(), proto_cfg.rx_ants().end());
+    if (not proto_cfg.cpu_format().empty())
+        c.cpu_format = proto_cfg.cpu_format();
+    if (not proto_cfg.otw_format().empty())
+        c.otw_format = proto_cfg.otw_format();
+
+    c.tx_cpus = proto_cfg.tx_cpus().empty() ? host.tx_cpus : std::vector<size_t>(proto_cfg.tx_cpus().begin(), proto_cfg.tx_cpus().end());
+    c.rx_cpus = proto_cfg.rx_cpus().empty() ? host.rx_cpus : std::vector<size_t>(proto_cfg.rx_cpus().begin(), proto_cfg.rx_cpus().end());
+    c.thread_priority = proto_cfg.has_thread_priority() ? proto_cfg.thread_priority() : host.thread_priority;
+    c.numa_node = proto_cfg.has_numa_node() ? proto_cfg.numa_node() : host.numa_node;
+
+    c.settle_time = proto_cfg.has_settle_time() ? proto_cfg.settle_time() : -1;
+    c.sweep_freqs.assign(proto_cfg.sweep_freqs().begin(), proto_cfg.sweep_freqs().end());
+    c.sweep_dwells.assign(proto_cfg.sweep_dwells().begin(), proto_cfg.sweep_dwells().end());
+    c.sweep_dsp_tune = proto_cfg.sweep_dsp_tune();
+    c.rx_channels_per_stream = proto_cfg.rx_channels_per_stream();
+    c.rx_fill_gaps = not proto_cfg.has_rx_fill_gaps() or proto_cfg.rx_fill_gaps();
+
+    c.tx_stream_format = proto_cfg.tx_stream_format();
+    auto convert_corrections = [](const auto &proto_corrections) {
+        std::vector<SampleCorrection> corrections;
+        for (const auto &proto_correction: proto_corrections) {
+            corrections.push_back(MakeCorrection(proto_correction.gain_db(), proto_correction.phase_deg(), {proto_correction.dc_i(), proto_correction.dc_q()},
+                                                 proto_correction.clip()));
+        }
+        return corrections;
+    };
+    c.tx_corrections = convert_corrections(proto_cfg.tx_corrections());
+    c.rx_corrections = convert_corrections(proto_cfg.rx_corrections());
+    c.rx_decimation = std::max<size_t>(proto_cfg.rx_decimation(), 1);
+    c.rx_mix_freqs.assign(proto_cfg.rx_mix_freqs().begin(), proto_cfg.rx_mix_freqs().end());
+    c.rx_fir_taps.assign(proto_cfg.rx_fir_taps().begin(), proto_cfg.rx_fir_taps().end());
+
+    c.trigger_mode = proto_cfg.trigger_mode();
+    if (proto_cfg.has_trigger_threshold())
+        c.trigger_threshold = proto_cfg.trigger_threshold();
+    if (proto_cfg.trigger_window() > 0)
+        c.trigger_window = proto_cfg.trigger_window();
+    for (int i = 0; i + 1 < proto_cfg.trigger_reference_size(); i += 2) {
+        c.trigger_reference.emplace_back(proto_cfg.trigger_reference(i), proto_cfg.trigger_reference(i + 1));
+    }
+    c.trigger_pre = proto_cfg.trigger_pre();
+    c.trigger_post = proto_cfg.trigger_post();
+    c.trigger_max = proto_cfg.trigger_max();
+    c.trigger_channel = proto_cfg.trigger_channel();
+    c.trigger_timeout = proto_cfg.trigger_timeout();
+
+
+    UHD_LOG_DEBUG("CONFIG", std::format("Converted Config - Clock: {}, Time: {}, SPB: {}, Delay: {}, RX Samps: {}, TX Samps: {}", c.clock_source, c.time_source,
+                                        c.spb, c.delay, c.rx_samps, c.tx_samps));
+
+    return c;
+}
+
+// 在请求循环中准备 EXECUTE：校验配置并映射 TX 共享内存，与正在进行的突发重叠
+// tx_shm 缓存上一次的映射，名称、对象和大小不变时复用
+BurstJob StageBurst(const usrp_proto::Request &req_proto, const UsrpConfig &host, UsrpTransceiver &transceiver, std::shared_ptr<const ShmSegment> &tx_shm) {
+    BurstJob job;
+    job.config = ConvertConfig(req_proto.config(), host);
+    const UsrpConfig &config = job.config;
+    const string &tx_shm_name = req_proto.tx_shm_name();
+
+    if (!transceiver.ValidateConfiguration(config, false)) {
+        throw std::runtime_error("Configuration validation failed");
+    }
+
+    // 批量执行：每个突发发送 TX 数据中的一段，TX 共享内存仍按 config.tx_samps 分通道
+    for (const auto &proto_burst: req_proto.schedule()) {
+        ScheduledBurst &burst = job.schedule.emplace_back();
+        burst.time_offset = proto_burst.time_offset();
+        burst.tx_offset = proto_burst.tx_offset();
+        burst.tx_samps = proto_burst.tx_samps();
+        burst.rx_samps = proto_burst.rx_samps();
+        burst.tx_freqs.assign(proto_burst.tx_freqs().begin(), proto_burst.tx_freqs().end());
+        burst.rx_freqs.assign(proto_burst.rx_freqs().begin(), proto_burst.rx_freqs().end());
+        const size_t index = job.schedule.size() - 1;
+        if (burst.time_offset < 0) {
+            throw std::runtime_error(std::format("Scheduled burst {} has a negative time offset", index));
+        }
+        if (burst.tx_samps > config.tx_samps or burst.tx_offset > config.tx_samps - burst.tx_samps) {
+            throw std::runtime_error(std::format("Scheduled burst {} sends {} TX samples from {}, the TX buffer has {}", index, burst.tx_samps,
+                                                 burst.tx_offset, config.tx_samps));
+        }
+        if ((not burst.tx_freqs.empty() and burst.tx_freqs.size() != config.tx_channels.size()) or
+            (not burst.rx_freqs.empty() and burst.rx_freqs.size() != config.rx_channels.size())) {
+            throw std::runtime_error(std::format("Scheduled burst {} needs one frequency per channel", index));
+        }
+    }
+    if (not job.schedule.empty() and (not config.sweep_freqs.empty() or not config.trigger_mode.empty() or config.tx_repeat == 0)) {
+        throw std::runtime_error("A schedule cannot be combined with a sweep, a trigger or tx_repeat = 0");
+    }
+
+    if (not tx_shm or not tx_shm->IsCurrent(tx_shm_name)) {
+        UHD_LOG_INFO("SERVER", std::format("Opening TX SHM: {}", tx_shm_name));
+        tx_shm = std::make_shared<const ShmSegment>(ShmSegment::Open(tx_shm_name));
+    }
+
+    const size_t sample_size = SampleSize(config.cpu_format);
+    size_t num_tx_ch = config.tx_channels.size();
+    size_t tx_bytes = num_tx_ch * config.tx_samps * sample_size;
+    if (tx_shm->size() < tx_bytes) {
+        throw std::runtime_error(std::format("TX SHM too small: {} bytes, expected {}", tx_shm->size(), tx_bytes));
+    }
+
+    // 直接在映射区上按通道切分，不再拷贝；任务持有映射，客户端提前 unlink 也不影响
+    job.tx_shm = tx_shm;
+    const std::byte *raw_tx_ptr = static_cast<const std::byte *>(tx_shm->data());
+    if (req_proto.tx_interleaved() or NeedsTxStaging(config)) {
+        // 需要解交织、格式转换或数字校正时才拷贝：在请求循环中完成，与正在进行的突发重叠
+        std::vector<TxChannelView> shm_views;
+        if (req_proto.tx_interleaved()) {
+            shm_views.emplace_back(raw_tx_ptr, tx_bytes);
+        } else {
+            for (size_t i = 0; i < num_tx_ch; ++i) {
+                shm_views.emplace_back(raw_tx_ptr + i * config.tx_samps * sample_size, config.tx_samps * sample_size);
+            }
+        }
+        job.tx_staged = StageTxSamples(shm_views, config, req_proto.tx_interleaved());
+        job.tx_shm.reset();
+        for (const auto &buff: job.tx_staged) {
+            job.tx_views.emplace_back(buff);
+        }
+        return job;
+    }
+    for (size_t i = 0; i < num_tx_ch; ++i) {
+        job.tx_views.emplace_back(raw_tx_ptr + i * config.tx_samps * sample_size, config.tx_samps * sample_size);
+    }
+    return job;
+}
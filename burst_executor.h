@@ -0,0 +1,216 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <zmq.hpp>
+
+#include "rx_segment_pool.h"
+#include "shm_segment.h"
+#include "usrp_protocol.pb.h"
+#include "usrp_transceiver.h"
+
+/**
+ * One burst of a batched EXECUTE, run with the job's configuration
+ */
+struct ScheduledBurst {
+    double time_offset{0}; // Start relative to the first burst's scheduled start, in seconds
+    size_t tx_offset{0}; // First sample per channel of the job's TX buffers this burst sends
+    size_t tx_samps{0}; // Samples per channel sent (tx_repeat times); 0 sends nothing
+    size_t rx_samps{0}; // Samples per channel received; 0 receives nothing
+    std::vector<double> tx_freqs, rx_freqs; // Retune before the burst; empty keeps the current frequencies
+};
+
+/**
+ * An EXECUTE request that has been parsed, validated and staged, ready to run on the radio
+ */
+struct BurstJob {
+    uint64_t id{0}; // Assigned by BurstExecutor::Submit
+    std::vector<std::string> envelope; // ROUTER routing frames of the client waiting for the reply; empty for SUBMIT
+    std::string client; // ROUTER identity of the submitting client, which holds the RX result
+    std::string rx_shm_name; // Client-supplied RX segment; empty uses the server's pool
+    UsrpConfig config;
+    std::shared_ptr<const ShmSegment> tx_shm; // Keeps the client's TX mapping alive while the job is queued
+    std::vector<SampleBuffer> tx_staged; // Host-processed copy of the TX samples (see StageTxSamples), used instead of tx_shm
+    std::vector<TxChannelView> tx_views; // Per-channel views into tx_shm or tx_staged
+    std::vector<ScheduledBurst> schedule; // Batched bursts; empty runs the configuration as one burst
+};
+
+/**
+ * Converts a request's configuration, filling thread and NUMA settings it leaves unset from host
+ */
+UsrpConfig ConvertConfig(const usrp_proto::UsrpConfig &proto_cfg, const UsrpConfig &host);
+
+/**
+ * Prepares an EXECUTE / SUBMIT request for the executor: validates the configuration and
+ * maps the TX SHM (reusing the mapping cached in tx_shm while it is current), staging the
+ * samples only when they need de-interleaving, conversion or corrections
+ *
+ * @throws std::runtime_error if the configuration is invalid or the TX SHM too small
+ */
+BurstJob StageBurst(const usrp_proto::Request &req_proto, const UsrpConfig &host, UsrpTransceiver &transceiver, std::shared_ptr<const ShmSegment> &tx_shm);
+
+/**
+ * Copies the streaming errors of a burst or stream into a reply
+ */
+void SetStreamStats(usrp_proto::Response &reply, const StreamStats &stats);
+
+/**
+ * Copies stream counters (cumulative or the difference of two snapshots) into a reply field
+ */
+void SetStreamMetrics(usrp_proto::StreamMetrics &proto, const StreamMetricsSnapshot &metrics);
+
+/**
+ * Runs staged bursts one after another on a dedicated worker thread
+ *
+ * The request loop stages the next job (parsing, validation, TX SHM mapping) while the
+ * current one streams. A job that is already waiting when the previous burst finishes,
+ * and does not change the clock or time source, is scheduled at a timed start right after that burst
+ * (see UsrpTransceiver::ScheduleAfter) instead of delay seconds from now.
+ *
+ * A job with a schedule runs all its bursts back-to-back: only the first waits for the
+ * delay (or follows the previous job), the others start at their offset from it, and never
+ * before the previous burst has ended. Their RX samples are stored one after another in a
+ * single result segment.
+ *
+ * Results go to segments of an RxSegmentPool, so a result stays intact while later
+ * bursts are captured, until its client releases it. Every finished job is reported as [envelope..., Response] on a PAIR
+ * socket connected to done_endpoint, for the request loop to forward to the waiting
+ * client (if any) and to announce on the PUB socket. The state of every job, and the
+ * result of the most recent finished ones, can be queried by ID.
+ */
+class BurstExecutor {
+public:
+    /**
+     * @param transceiver Radio the bursts run on; only the worker touches it while jobs are pending
+     * @param ctx ZMQ context of the request loop
+     * @param done_endpoint inproc endpoint bound by the request loop (PAIR)
+     * @param rx_shm_name Base name of the RX pool segments
+     * @param rx_pool_size Number of RX pool segments
+     * @param lead Minimum scheduling lead for back-to-back bursts, in seconds
+     * @param stop_signal Aborts a configuration (time sync) in progress when set
+     */
+    BurstExecutor(UsrpTransceiver &transceiver, zmq::context_t &ctx, const std::string &done_endpoint, const std::string &rx_shm_name, size_t rx_pool_size,
+                  double lead, std::atomic<bool> &stop_signal);
+
+    ~BurstExecutor();
+
+    BurstExecutor(const BurstExecutor &) = delete;
+
+    BurstExecutor &operator=(const BurstExecutor &) = delete;
+
+    /**
+     * Queues a staged job
+     *
+     * @return ID of the job
+     */
+    uint64_t Submit(BurstJob job);
+
+    /**
+     * Describes a job: job_id, job_state, queue_position while queued and the burst
+     * result once it has finished
+     */
+    [[nodiscard]] usrp_proto::Response Status(uint64_t job_id) const;
+
+    /**
+     * Cancels a queued job or aborts the running one
+     *
+     * @param envelope Receives the routing frames of a removed queued job, whose client still awaits a reply
+     * @return JOB_CANCELLED if the job was removed from the queue, JOB_RUNNING if it is being aborted,
+     *         otherwise the (final or unknown) state of the job
+     */
+    usrp_proto::JobState Cancel(uint64_t job_id, std::vector<std::string> &envelope);
+
+    /**
+     * Releases RX segments a client has finished reading (see RxSegmentPool::Release)
+     */
+    size_t Release(const std::string &rx_shm_name, const std::string &client) { return rx_pool.Release(rx_shm_name, client); }
+
+    /**
+     * @return Whether a client-supplied RX segment name can be used
+     */
+    [[nodiscard]] bool ValidRxName(const std::string &rx_shm_name) const { return rx_pool.ValidName(rx_shm_name); }
+
+    /**
+     * @return true when no job is queued or running, so the radio may be used directly
+     */
+    [[nodiscard]] bool Idle() const;
+
+    /**
+     * @return Number of jobs waiting to run (not counting the running one)
+     */
+    [[nodiscard]] size_t Pending() const;
+
+private:
+    UsrpTransceiver &transceiver;
+    zmq::socket_t done_sock; // Worker only
+    RxSegmentPool rx_pool;
+    double lead;
+    std::atomic<bool> &stop_signal;
+
+    static constexpr size_t kMaxFinishedJobs = 1024; // Results kept for STATUS
+
+    struct JobRecord {
+        usrp_proto::JobState state{usrp_proto::JOB_QUEUED};
+        usrp_proto::Response result; // Valid once finished
+    };
+
+    mutable std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<BurstJob> queue;
+    std::map<uint64_t, JobRecord> jobs;
+    std::deque<uint64_t> finished; // Oldest first, for eviction
+    uint64_t next_job_id{1};
+    bool busy{false};
+    bool shutdown{false};
+    std::atomic<bool> abort_running{false};
+
+    // Worker state
+    bool have_previous{false};
+    uhd::time_spec_t previous_end;
+
+    std::thread worker;
+
+    void Run();
+
+    /**
+     * Runs one burst and fills in its reply
+     *
+     * @param back_to_back The job was already queued when the previous burst finished
+     */
+    void Execute(BurstJob &job, bool back_to_back, usrp_proto::Response &reply);
+
+    /**
+     * Waits for a transmission to finish, stopping it once abort_running is set (CANCEL or shutdown)
+     */
+    void WaitTransmit(std::future<void> &tx_thread, std::atomic<bool> &tx_stop);
+
+    /**
+     * Streams the burst into an acquired RX segment
+     */
+    void Capture(const BurstJob &job, ShmSegment &segment, usrp_proto::Response &reply);
+
+    /**
+     * Streams every burst of a schedule into an acquired RX segment
+     *
+     * Retunes between bursts are queued as timed commands (ApplyTimedRetune) without waiting for
+     * them; the locks are checked once after the last burst.
+     *
+     * @param first_start Scheduled start of the first burst before its time_offset
+     * @param config_time Accumulates the time spent queueing retunes and checking the locks
+     */
+    void CaptureSchedule(const BurstJob &job, const uhd::time_spec_t &first_start, ShmSegment &segment, usrp_proto::Response &reply,
+                         std::chrono::duration<double> &config_time);
+
+    void Finish(const BurstJob &job, usrp_proto::Response &reply);
+};
@@ -0,0 +1,669 @@
+#include "dsp_kernels.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <format>
+#include <numbers>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DSP_KERNELS_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define DSP_KERNELS_NEON 1
+#endif
+
+using std::string;
+
+namespace {
+
+using complexf = std::complex<float>;
+
+constexpr float kSc16Scale = 32767.0f;
+constexpr float kSc8Scale = 127.0f;
+constexpr size_t kScratchSamples = 4096; // fc32 scratch per ProcessSamples chunk (32 KiB, stays in L1/L2)
+
+// Scalar kernels, also used for the tails of the vector ones
+
+void Fc32ToSc16Scalar(const float *in, int16_t *out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = static_cast<int16_t>(std::lrint(std::clamp(in[i] * kSc16Scale, -32768.0f, 32767.0f)));
+    }
+}
+
+void Sc16ToFc32Scalar(const int16_t *in, float *out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = static_cast<float>(in[i]) * (1.0f / kSc16Scale);
+    }
+}
+
+void Fc32ToSc8Scalar(const float *in, int8_t *out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = static_cast<int8_t>(std::lrint(std::clamp(in[i] * kSc8Scale, -128.0f, 127.0f)));
+    }
+}
+
+void Sc8ToFc32Scalar(const int8_t *in, float *out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = static_cast<float>(in[i]) * (1.0f / kSc8Scale);
+    }
+}
+
+void ComplexGainScalar(complexf *samples, size_t n, complexf gain, complexf offset) {
+    for (size_t i = 0; i < n; ++i) {
+        samples[i] = gain * samples[i] + offset;
+    }
+}
+
+void ClipScalar(float *values, size_t n, float limit) {
+    for (size_t i = 0; i < n; ++i) {
+        values[i] = std::clamp(values[i], -limit, limit);
+    }
+}
+
+void MultiplyScalar(complexf *samples, const complexf *factors, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        samples[i] *= factors[i];
+    }
+}
+
+complexf FirDotScalar(const complexf *samples, const float *paired_taps, size_t ntaps) {
+    float re = 0, im = 0;
+    for (size_t i = 0; i < ntaps; ++i) {
+        re += samples[i].real() * paired_taps[2 * i];
+        im += samples[i].imag() * paired_taps[2 * i + 1];
+    }
+    return {re, im};
+}
+
+complexf CorrelateScalar(const complexf *samples, const complexf *reference, size_t n) {
+    float re = 0, im = 0;
+    for (size_t i = 0; i < n; ++i) {
+        re += samples[i].real() * reference[i].real() + samples[i].imag() * reference[i].imag();
+        im += samples[i].imag() * reference[i].real() - samples[i].real() * reference[i].imag();
+    }
+    return {re, im};
+}
+
+void PowerScalar(const complexf *samples, float *out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = std::norm(samples[i]);
+    }
+}
+
+#ifdef DSP_KERNELS_X86
+
+// Values are clamped before the float -> int32 conversion, which would turn large positive values into INT_MIN
+
+__attribute__((target("avx2"))) void Fc32ToSc16Avx2(const float *in, int16_t *out, size_t n) {
+    const __m256 scale = _mm256_set1_ps(kSc16Scale);
+    const __m256 lo = _mm256_set1_ps(-32768.0f);
+    const __m256 hi = _mm256_set1_ps(32767.0f);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i a = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i), scale), lo), hi));
+        __m256i b = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i + 8), scale), lo), hi));
+        // packs works per 128-bit lane: a0-3 b0-3 a4-7 b4-7, restored to a b order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), packed);
+    }
+    Fc32ToSc16Scalar(in + i, out + i, n - i);
+}
+
+__attribute__((target("avx2"))) void Sc16ToFc32Avx2(const int16_t *in, float *out, size_t n) {
+    const __m256 scale = _mm256_set1_ps(1.0f / kSc16Scale);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i wide = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i)));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(wide), scale));
+    }
+    Sc16ToFc32Scalar(in + i, out + i, n - i);
+}
+
+__attribute__((target("avx2"))) void Fc32ToSc8Avx2(const float *in, int8_t *out, size_t n) {
+    const __m256 scale = _mm256_set1_ps(kSc8Scale);
+    const __m256 lo = _mm256_set1_ps(-128.0f);
+    const __m256 hi = _mm256_set1_ps(127.0f);
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v[4];
+        for (size_t k = 0; k < 4; ++k) {
+            v[k] = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i + 8 * k), scale), lo), hi));
+        }
+        // Two lane-wise packs leave 4-byte groups in the order a0 b0 c0 d0 a1 b1 c1 d1
+        __m256i packed = _mm256_packs_epi16(_mm256_packs_epi32(v[0], v[1]), _mm256_packs_epi32(v[2], v[3]));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_permutevar8x32_epi32(packed, order));
+    }
+    Fc32ToSc8Scalar(in + i, out + i, n - i);
+}
+
+__attribute__((target("avx2"))) void Sc8ToFc32Avx2(const int8_t *in, float *out, size_t n) {
+    const __m256 scale = _mm256_set1_ps(1.0f / kSc8Scale);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i wide = _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(in + i)));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(wide), scale));
+    }
+    Sc8ToFc32Scalar(in + i, out + i, n - i);
+}
+
+__attribute__((target("avx2"))) void ComplexGainAvx2(complexf *samples, size_t n, complexf gain, complexf offset) {
+    // With x = [re im], gain * x = re(g) * [re im] + im(g) * [-im re]
+    float *values = reinterpret_cast<float *>(samples);
+    const __m256 g_re = _mm256_set1_ps(gain.real());
+    const __m256 g_im = _mm256_setr_ps(-gain.imag(), gain.imag(), -gain.imag(), gain.imag(), -gain.imag(), gain.imag(), -gain.imag(), gain.imag());
+    const __m256 dc = _mm256_setr_ps(offset.real(), offset.imag(), offset.real(), offset.imag(), offset.real(), offset.imag(), offset.real(), offset.imag());
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256 x = _mm256_loadu_ps(values + 2 * i);
+        __m256 swapped = _mm256_permute_ps(x, 0xB1);
+        _mm256_storeu_ps(values + 2 * i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, g_re), _mm256_mul_ps(swapped, g_im)), dc));
+    }
+    ComplexGainScalar(samples + i, n - i, gain, offset);
+}
+
+__attribute__((target("avx2"))) void ClipAvx2(float *values, size_t n, float limit) {
+    const __m256 lo = _mm256_set1_ps(-limit);
+    const __m256 hi = _mm256_set1_ps(limit);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(values + i, _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(values + i), lo), hi));
+    }
+    ClipScalar(values + i, n - i, limit);
+}
+
+__attribute__((target("avx2"))) void MultiplyAvx2(complexf *samples, const complexf *factors, size_t n) {
+    float *values = reinterpret_cast<float *>(samples);
+    const float *f = reinterpret_cast<const float *>(factors);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256 x = _mm256_loadu_ps(values + 2 * i);
+        __m256 y = _mm256_loadu_ps(f + 2 * i);
+        // [re(x)re(y) - im(x)im(y), im(x)re(y) + re(x)im(y)]
+        __m256 re_part = _mm256_mul_ps(x, _mm256_moveldup_ps(y));
+        __m256 im_part = _mm256_mul_ps(_mm256_permute_ps(x, 0xB1), _mm256_movehdup_ps(y));
+        _mm256_storeu_ps(values + 2 * i, _mm256_addsub_ps(re_part, im_part));
+    }
+    MultiplyScalar(samples + i, factors + i, n - i);
+}
+
+__attribute__((target("avx2"))) float SumLanes(__m256 v, int first) {
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, v);
+    return lanes[first] + lanes[first + 2] + lanes[first + 4] + lanes[first + 6];
+}
+
+__attribute__((target("avx2"))) complexf FirDotAvx2(const complexf *samples, const float *paired_taps, size_t ntaps) {
+    const float *x = reinterpret_cast<const float *>(samples);
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= ntaps; i += 8) {
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(x + 2 * i), _mm256_loadu_ps(paired_taps + 2 * i)));
+        acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(x + 2 * i + 8), _mm256_loadu_ps(paired_taps + 2 * i + 8)));
+    }
+    const __m256 acc = _mm256_add_ps(acc0, acc1);
+    return complexf(SumLanes(acc, 0), SumLanes(acc, 1)) + FirDotScalar(samples + i, paired_taps + 2 * i, ntaps - i);
+}
+
+__attribute__((target("avx2"))) complexf CorrelateAvx2(const complexf *samples, const complexf *reference, size_t n) {
+    const float *x = reinterpret_cast<const float *>(samples);
+    const float *r = reinterpret_cast<const float *>(reference);
+    // direct = [re(x)re(r), im(x)re(r)], swapped = [im(x)im(r), re(x)im(r)]
+    __m256 direct = _mm256_setzero_ps();
+    __m256 swapped = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m256 xv = _mm256_loadu_ps(x + 2 * i);
+        const __m256 rv = _mm256_loadu_ps(r + 2 * i);
+        direct = _mm256_add_ps(direct, _mm256_mul_ps(xv, _mm256_moveldup_ps(rv)));
+        swapped = _mm256_add_ps(swapped, _mm256_mul_ps(_mm256_permute_ps(xv, 0xB1), _mm256_movehdup_ps(rv)));
+    }
+    return complexf(SumLanes(direct, 0) + SumLanes(swapped, 0), SumLanes(direct, 1) - SumLanes(swapped, 1)) +
+           CorrelateScalar(samples + i, reference + i, n - i);
+}
+
+__attribute__((target("avx2"))) void PowerAvx2(const complexf *samples, float *out, size_t n) {
+    const float *x = reinterpret_cast<const float *>(samples);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 a = _mm256_loadu_ps(x + 2 * i);
+        const __m256 b = _mm256_loadu_ps(x + 2 * i + 8);
+        // hadd pairs within 128-bit lanes; the 64-bit permute restores sample order
+        const __m256 sums = _mm256_hadd_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(b, b));
+        _mm256_storeu_ps(out + i, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(sums), 0xD8)));
+    }
+    PowerScalar(samples + i, out + i, n - i);
+}
+
+// AVX-512F narrows with saturation directly (vpmovsdw / vpmovsdb)
+
+__attribute__((target("avx512f"))) void Fc32ToSc16Avx512(const float *in, int16_t *out, size_t n) {
+    const __m512 scale = _mm512_set1_ps(kSc16Scale);
+    const __m512 lo = _mm512_set1_ps(-32768.0f);
+    const __m512 hi = _mm512_set1_ps(32767.0f);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i v = _mm512_cvtps_epi32(_mm512_min_ps(_mm512_max_ps(_mm512_mul_ps(_mm512_loadu_ps(in + i), scale), lo), hi));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm512_cvtsepi32_epi16(v));
+    }
+    Fc32ToSc16Scalar(in + i, out + i, n - i);
+}
+
+__attribute__((target("avx512f"))) void Sc16ToFc32Avx512(const int16_t *in, float *out, size_t n) {
+    const __m512 scale = _mm512_set1_ps(1.0f / kSc16Scale);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i wide = _mm512_cvtepi16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i)));
+        _mm512_storeu_ps(out + i, _mm512_mul_ps(_mm512_cvtepi32_ps(wide), scale));
+    }
+    Sc16ToFc32Scalar(in + i, out + i, n - i);
+}
+
+__attribute__((target("avx512f"))) void Fc32ToSc8Avx512(const float *in, int8_t *out, size_t n) {
+    const __m512 scale = _mm512_set1_ps(kSc8Scale);
+    const __m512 lo = _mm512_set1_ps(-128.0f);
+    const __m512 hi = _mm512_set1_ps(127.0f);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i v = _mm512_cvtps_epi32(_mm512_min_ps(_mm512_max_ps(_mm512_mul_ps(_mm512_loadu_ps(in + i), scale), lo), hi));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm512_cvtsepi32_epi8(v));
+    }
+    Fc32ToSc8Scalar(in + i, out + i, n - i);
+}
+
+__attribute__((target("avx512f"))) void Sc8ToFc32Avx512(const int8_t *in, float *out, size_t n) {
+    const __m512 scale = _mm512_set1_ps(1.0f / kSc8Scale);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i wide = _mm512_cvtepi8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i)));
+        _mm512_storeu_ps(out + i, _mm512_mul_ps(_mm512_cvtepi32_ps(wide), scale));
+    }
+    Sc8ToFc32Scalar(in + i, out + i, n - i);
+}
+
+__attribute__((target("avx512f"))) void ComplexGainAvx512(complexf *samples, size_t n, complexf gain, complexf offset) {
+    float *values = reinterpret_cast<float *>(samples);
+    const __m512 g_re = _mm512_set1_ps(gain.real());
+    const __m512 g_im = _mm512_castpd_ps(_mm512_set1_pd(std::bit_cast<double>(std::array<float, 2>{-gain.imag(), gain.imag()})));
+    const __m512 dc = _mm512_castpd_ps(_mm512_set1_pd(std::bit_cast<double>(std::array<float, 2>{offset.real(), offset.imag()})));
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512 x = _mm512_loadu_ps(values + 2 * i);
+        __m512 swapped = _mm512_permute_ps(x, 0xB1);
+        _mm512_storeu_ps(values + 2 * i, _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(x, g_re), _mm512_mul_ps(swapped, g_im)), dc));
+    }
+    ComplexGainAvx2(samples + i, n - i, gain, offset);
+}
+
+__attribute__((target("avx512f"))) void ClipAvx512(float *values, size_t n, float limit) {
+    const __m512 lo = _mm512_set1_ps(-limit);
+    const __m512 hi = _mm512_set1_ps(limit);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm512_storeu_ps(values + i, _mm512_min_ps(_mm512_max_ps(_mm512_loadu_ps(values + i), lo), hi));
+    }
+    ClipScalar(values + i, n - i, limit);
+}
+
+__attribute__((target("avx512f"))) void MultiplyAvx512(complexf *samples, const complexf *factors, size_t n) {
+    float *values = reinterpret_cast<float *>(samples);
+    const float *f = reinterpret_cast<const float *>(factors);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512 x = _mm512_loadu_ps(values + 2 * i);
+        __m512 y = _mm512_loadu_ps(f + 2 * i);
+        __m512 im_part = _mm512_mul_ps(_mm512_permute_ps(x, 0xB1), _mm512_movehdup_ps(y));
+        _mm512_storeu_ps(values + 2 * i, _mm512_fmaddsub_ps(x, _mm512_moveldup_ps(y), im_part));
+    }
+    MultiplyAvx2(samples + i, factors + i, n - i);
+}
+
+__attribute__((target("avx512f"))) complexf FirDotAvx512(const complexf *samples, const float *paired_taps, size_t ntaps) {
+    const float *x = reinterpret_cast<const float *>(samples);
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= ntaps; i += 16) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(x + 2 * i), _mm512_loadu_ps(paired_taps + 2 * i), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(x + 2 * i + 16), _mm512_loadu_ps(paired_taps + 2 * i + 16), acc1);
+    }
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, _mm512_add_ps(acc0, acc1));
+    float re = 0, im = 0;
+    for (size_t lane = 0; lane < 16; lane += 2) {
+        re += lanes[lane];
+        im += lanes[lane + 1];
+    }
+    return complexf(re, im) + FirDotAvx2(samples + i, paired_taps + 2 * i, ntaps - i);
+}
+
+__attribute__((target("avx512f"))) complexf CorrelateAvx512(const complexf *samples, const complexf *reference, size_t n) {
+    const float *x = reinterpret_cast<const float *>(samples);
+    const float *r = reinterpret_cast<const float *>(reference);
+    __m512 direct = _mm512_setzero_ps();
+    __m512 swapped = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m512 xv = _mm512_loadu_ps(x + 2 * i);
+        const __m512 rv = _mm512_loadu_ps(r + 2 * i);
+        direct = _mm512_fmadd_ps(xv, _mm512_moveldup_ps(rv), direct);
+        swapped = _mm512_fmadd_ps(_mm512_permute_ps(xv, 0xB1), _mm512_movehdup_ps(rv), swapped);
+    }
+    alignas(64) float d[16], s[16];
+    _mm512_store_ps(d, direct);
+    _mm512_store_ps(s, swapped);
+    float re = 0, im = 0;
+    for (size_t lane = 0; lane < 16; lane += 2) {
+        re += d[lane] + s[lane];
+        im += d[lane + 1] - s[lane + 1];
+    }
+    return complexf(re, im) + CorrelateAvx2(samples + i, reference + i, n - i);
+}
+
+#endif
+
+#ifdef DSP_KERNELS_NEON
+
+void Fc32ToSc16Neon(const float *in, int16_t *out, size_t n) {
+    const float32x4_t scale = vdupq_n_f32(kSc16Scale);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        // vcvtnq saturates to int32, vqmovn to int16
+        int32x4_t a = vcvtnq_s32_f32(vmulq_f32(vld1q_f32(in + i), scale));
+        int32x4_t b = vcvtnq_s32_f32(vmulq_f32(vld1q_f32(in + i + 4), scale));
+        vst1q_s16(out + i, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+    }
+    Fc32ToSc16Scalar(in + i, out + i, n - i);
+}
+
+void Sc16ToFc32Neon(const int16_t *in, float *out, size_t n) {
+    const float32x4_t scale = vdupq_n_f32(1.0f / kSc16Scale);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t v = vld1q_s16(in + i);
+        vst1q_f32(out + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale));
+        vst1q_f32(out + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+    }
+    Sc16ToFc32Scalar(in + i, out + i, n - i);
+}
+
+void Fc32ToSc8Neon(const float *in, int8_t *out, size_t n) {
+    const float32x4_t scale = vdupq_n_f32(kSc8Scale);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int32x4_t a = vcvtnq_s32_f32(vmulq_f32(vld1q_f32(in + i), scale));
+        int32x4_t b = vcvtnq_s32_f32(vmulq_f32(vld1q_f32(in + i + 4), scale));
+        vst1_s8(out + i, vqmovn_s16(vcombine_s16(vqmovn_s32(a), vqmovn_s32(b))));
+    }
+    Fc32ToSc8Scalar(in + i, out + i, n - i);
+}
+
+void Sc8ToFc32Neon(const int8_t *in, float *out, size_t n) {
+    const float32x4_t scale = vdupq_n_f32(1.0f / kSc8Scale);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t v = vmovl_s8(vld1_s8(in + i));
+        vst1q_f32(out + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale));
+        vst1q_f32(out + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+    }
+    Sc8ToFc32Scalar(in + i, out + i, n - i);
+}
+
+void ComplexGainNeon(complexf *samples, size_t n, complexf gain, complexf offset) {
+    float *values = reinterpret_cast<float *>(samples);
+    const float32x4_t g_re = vdupq_n_f32(gain.real());
+    const float32x4_t g_im = vdupq_n_f32(gain.imag());
+    const float32x4_t dc_re = vdupq_n_f32(offset.real());
+    const float32x4_t dc_im = vdupq_n_f32(offset.imag());
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        float32x4x2_t x = vld2q_f32(values + 2 * i); // De-interleaved into re and im
+        float32x4x2_t y;
+        y.val[0] = vaddq_f32(vmlsq_f32(vmulq_f32(x.val[0], g_re), x.val[1], g_im), dc_re);
+        y.val[1] = vaddq_f32(vmlaq_f32(vmulq_f32(x.val[1], g_re), x.val[0], g_im), dc_im);
+        vst2q_f32(values + 2 * i, y);
+    }
+    ComplexGainScalar(samples + i, n - i, gain, offset);
+}
+
+void ClipNeon(float *values, size_t n, float limit) {
+    const float32x4_t lo = vdupq_n_f32(-limit);
+    const float32x4_t hi = vdupq_n_f32(limit);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(values + i, vminq_f32(vmaxq_f32(vld1q_f32(values + i), lo), hi));
+    }
+    ClipScalar(values + i, n - i, limit);
+}
+
+void MultiplyNeon(complexf *samples, const complexf *factors, size_t n) {
+    float *values = reinterpret_cast<float *>(samples);
+    const float *f = reinterpret_cast<const float *>(factors);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        float32x4x2_t x = vld2q_f32(values + 2 * i);
+        float32x4x2_t y = vld2q_f32(f + 2 * i);
+        float32x4x2_t z;
+        z.val[0] = vmlsq_f32(vmulq_f32(x.val[0], y.val[0]), x.val[1], y.val[1]);
+        z.val[1] = vmlaq_f32(vmulq_f32(x.val[1], y.val[0]), x.val[0], y.val[1]);
+        vst2q_f32(values + 2 * i, z);
+    }
+    MultiplyScalar(samples + i, factors + i, n - i);
+}
+
+complexf FirDotNeon(const complexf *samples, const float *paired_taps, size_t ntaps) {
+    const float *x = reinterpret_cast<const float *>(samples);
+    float32x4_t acc0 = vdupq_n_f32(0);
+    float32x4_t acc1 = vdupq_n_f32(0);
+    size_t i = 0;
+    for (; i + 4 <= ntaps; i += 4) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(x + 2 * i), vld1q_f32(paired_taps + 2 * i));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(x + 2 * i + 4), vld1q_f32(paired_taps + 2 * i + 4));
+    }
+    // Lanes alternate I and Q
+    const float32x2_t pairs = vadd_f32(vget_low_f32(vaddq_f32(acc0, acc1)), vget_high_f32(vaddq_f32(acc0, acc1)));
+    return complexf(vget_lane_f32(pairs, 0), vget_lane_f32(pairs, 1)) + FirDotScalar(samples + i, paired_taps + 2 * i, ntaps - i);
+}
+
+complexf CorrelateNeon(const complexf *samples, const complexf *reference, size_t n) {
+    const float *x = reinterpret_cast<const float *>(samples);
+    const float *r = reinterpret_cast<const float *>(reference);
+    float32x4_t re = vdupq_n_f32(0);
+    float32x4_t im = vdupq_n_f32(0);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const float32x4x2_t xv = vld2q_f32(x + 2 * i);
+        const float32x4x2_t rv = vld2q_f32(r + 2 * i);
+        re = vmlaq_f32(vmlaq_f32(re, xv.val[0], rv.val[0]), xv.val[1], rv.val[1]);
+        im = vmlsq_f32(vmlaq_f32(im, xv.val[1], rv.val[0]), xv.val[0], rv.val[1]);
+    }
+    return complexf(vaddvq_f32(re), vaddvq_f32(im)) + CorrelateScalar(samples + i, reference + i, n - i);
+}
+
+void PowerNeon(const complexf *samples, float *out, size_t n) {
+    const float *x = reinterpret_cast<const float *>(samples);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const float32x4x2_t xv = vld2q_f32(x + 2 * i);
+        vst1q_f32(out + i, vmlaq_f32(vmulq_f32(xv.val[0], xv.val[0]), xv.val[1], xv.val[1]));
+    }
+    PowerScalar(samples + i, out + i, n - i);
+}
+
+#endif
+
+struct KernelTable {
+    const char *isa;
+    void (*fc32_to_sc16)(const float *, int16_t *, size_t);
+    void (*sc16_to_fc32)(const int16_t *, float *, size_t);
+    void (*fc32_to_sc8)(const float *, int8_t *, size_t);
+    void (*sc8_to_fc32)(const int8_t *, float *, size_t);
+    void (*complex_gain)(complexf *, size_t, complexf, complexf);
+    void (*clip)(float *, size_t, float);
+    void (*multiply)(complexf *, const complexf *, size_t);
+    complexf (*fir_dot)(const complexf *, const float *, size_t);
+    complexf (*correlate)(const complexf *, const complexf *, size_t);
+    void (*power)(const complexf *, float *, size_t);
+};
+
+KernelTable SelectKernels() {
+#ifdef DSP_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return {"avx512", Fc32ToSc16Avx512, Sc16ToFc32Avx512, Fc32ToSc8Avx512, Sc8ToFc32Avx512, ComplexGainAvx512, ClipAvx512, MultiplyAvx512, FirDotAvx512,
+                CorrelateAvx512, PowerAvx2};
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return {"avx2", Fc32ToSc16Avx2, Sc16ToFc32Avx2, Fc32ToSc8Avx2, Sc8ToFc32Avx2, ComplexGainAvx2, ClipAvx2, MultiplyAvx2, FirDotAvx2, CorrelateAvx2, PowerAvx2};
+    }
+#elif defined(DSP_KERNELS_NEON)
+    return {"neon", Fc32ToSc16Neon, Sc16ToFc32Neon, Fc32ToSc8Neon, Sc8ToFc32Neon, ComplexGainNeon, ClipNeon, MultiplyNeon, FirDotNeon, CorrelateNeon, PowerNeon};
+#endif
+    return {"scalar", Fc32ToSc16Scalar, Sc16ToFc32Scalar, Fc32ToSc8Scalar, Sc8ToFc32Scalar, ComplexGainScalar, ClipScalar, MultiplyScalar, FirDotScalar,
+            CorrelateScalar, PowerScalar};
+}
+
+const KernelTable &Kernels() {
+    static const KernelTable table = SelectKernels();
+    return table;
+}
+
+void CheckFormat(const string &format) {
+    if (format != "fc32" and format != "sc16" and format != "sc8") {
+        throw std::invalid_argument(std::format("Unsupported sample format: {}", format));
+    }
+}
+
+/**
+ * Converts n samples of any supported format to fc32
+ */
+void ToFc32(const std::byte *in, const string &format, float *out, size_t n) {
+    if (format == "fc32") {
+        if (reinterpret_cast<const float *>(in) != out) {
+            std::memcpy(out, in, n * sizeof(complexf));
+        }
+    } else if (format == "sc16") {
+        Kernels().sc16_to_fc32(reinterpret_cast<const int16_t *>(in), out, 2 * n);
+    } else {
+        Kernels().sc8_to_fc32(reinterpret_cast<const int8_t *>(in), out, 2 * n);
+    }
+}
+
+void FromFc32(const float *in, std::byte *out, const string &format, size_t n) {
+    if (format == "fc32") {
+        if (reinterpret_cast<float *>(out) != in) {
+            std::memcpy(out, in, n * sizeof(complexf));
+        }
+    } else if (format == "sc16") {
+        Kernels().fc32_to_sc16(in, reinterpret_cast<int16_t *>(out), 2 * n);
+    } else {
+        Kernels().fc32_to_sc8(in, reinterpret_cast<int8_t *>(out), 2 * n);
+    }
+}
+
+void Correct(float *values, size_t n, const SampleCorrection &correction) {
+    if (correction.gain != complexf(1, 0) or correction.offset != complexf(0, 0)) {
+        Kernels().complex_gain(reinterpret_cast<complexf *>(values), n, correction.gain, correction.offset);
+    }
+    if (correction.clip > 0) {
+        Kernels().clip(values, 2 * n, correction.clip);
+    }
+}
+
+size_t FormatSize(const string &format) { return format == "fc32" ? sizeof(complexf) : format == "sc16" ? 2 * sizeof(int16_t) : 2 * sizeof(int8_t); }
+
+} // namespace
+
+SampleCorrection MakeCorrection(double gain_db, double phase_deg, complexf offset, float clip) {
+    const auto gain = std::polar(std::pow(10.0, gain_db / 20), phase_deg * std::numbers::pi / 180);
+    return {complexf(gain), offset, clip};
+}
+
+const char *KernelIsa() { return Kernels().isa; }
+
+void Fc32ToSc16(const float *in, int16_t *out, size_t nvalues) { Kernels().fc32_to_sc16(in, out, nvalues); }
+
+void Sc16ToFc32(const int16_t *in, float *out, size_t nvalues) { Kernels().sc16_to_fc32(in, out, nvalues); }
+
+void Fc32ToSc8(const float *in, int8_t *out, size_t nvalues) { Kernels().fc32_to_sc8(in, out, nvalues); }
+
+void Sc8ToFc32(const int8_t *in, float *out, size_t nvalues) { Kernels().sc8_to_fc32(in, out, nvalues); }
+
+void ApplyComplexGain(complexf *samples, size_t nsamps, complexf gain, complexf offset) { Kernels().complex_gain(samples, nsamps, gain, offset); }
+
+void ClipValues(float *values, size_t nvalues, float limit) { Kernels().clip(values, nvalues, limit); }
+
+void MultiplyComplex(complexf *samples, const complexf *factors, size_t nsamps) { Kernels().multiply(samples, factors, nsamps); }
+
+complexf FirDotProduct(const complexf *samples, const float *paired_taps, size_t ntaps) { return Kernels().fir_dot(samples, paired_taps, ntaps); }
+
+complexf CorrelateConjugate(const complexf *samples, const complexf *reference, size_t nsamps) { return Kernels().correlate(samples, reference, nsamps); }
+
+void MagnitudeSquared(const complexf *samples, float *out, size_t nsamps) { Kernels().power(samples, out, nsamps); }
+
+void ProcessSamples(const std::byte *in, const string &in_format, std::byte *out, const string &out_format, size_t nsamps,
+                    const SampleCorrection &correction) {
+    CheckFormat(in_format);
+    CheckFormat(out_format);
+    if (in_format == out_format and correction.Identity()) {
+        if (in != out) {
+            std::memcpy(out, in, nsamps * FormatSize(in_format));
+        }
+        return;
+    }
+
+    // fc32 output is corrected in place in the destination; other formats go through a small scratch buffer
+    if (out_format == "fc32") {
+        float *values = reinterpret_cast<float *>(out);
+        ToFc32(in, in_format, values, nsamps);
+        Correct(values, nsamps, correction);
+        return;
+    }
+    if (in_format == "fc32" and correction.Identity()) {
+        FromFc32(reinterpret_cast<const float *>(in), out, out_format, nsamps);
+        return;
+    }
+
+    thread_local std::array<complexf, kScratchSamples> scratch;
+    float *values = reinterpret_cast<float *>(scratch.data());
+    const size_t in_size = FormatSize(in_format);
+    const size_t out_size = FormatSize(out_format);
+    for (size_t done = 0; done < nsamps; done += kScratchSamples) {
+        const size_t n = std::min(kScratchSamples, nsamps - done);
+        ToFc32(in + done * in_size, in_format, values, n);
+        Correct(values, n, correction);
+        FromFc32(values, out + done * out_size, out_format, n);
+    }
+}
+
+void DeinterleaveChannels(const std::byte *in, size_t sample_size, size_t nsamps, const std::vector<std::byte *> &out) {
+    const size_t num_ch = out.size();
+    const size_t stride = num_ch * sample_size;
+
+    // Fixed-size copies let the compiler turn each sample into a single load/store
+    auto split = [&]<size_t kSize>() {
+        for (size_t i = 0; i < nsamps; ++i) {
+            const std::byte *src = in + i * stride;
+            for (size_t ch = 0; ch < num_ch; ++ch) {
+                std::memcpy(out[ch] + i * kSize, src + ch * kSize, kSize);
+            }
+        }
+    };
+    switch (sample_size) {
+        case 2: split.operator()<2>(); break;
+        case 4: split.operator()<4>(); break;
+        case 8: split.operator()<8>(); break;
+        default:
+            for (size_t i = 0; i < nsamps; ++i) {
+                for (size_t ch = 0; ch < num_ch; ++ch) {
+                    std::memcpy(out[ch] + i * sample_size, in + i * stride + ch * sample_size, sample_size);
+                }
+            }
+    }
+}
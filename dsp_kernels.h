@@ -0,0 +1,94 @@
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Host-side correction of one channel's samples: y = clip(gain * x + offset)
+ *
+ * Samples are scaled to full scale 1.0 (fc32); sc16 and sc8 map 1.0 to 32767 and 127.
+ */
+struct SampleCorrection {
+    std::complex<float> gain{1, 0}; // Digital gain and phase rotation
+    std::complex<float> offset{0, 0}; // DC offset added after the gain
+    float clip{0}; // Saturates I and Q to [-clip, clip]; 0 disables clipping
+
+    [[nodiscard]] bool Identity() const { return gain == std::complex<float>(1, 0) and offset == std::complex<float>(0, 0) and clip == 0; }
+
+    bool operator==(const SampleCorrection &) const = default;
+};
+
+/**
+ * Builds a correction from a gain in dB and a phase rotation in degrees
+ */
+SampleCorrection MakeCorrection(double gain_db, double phase_deg = 0, std::complex<float> offset = {0, 0}, float clip = 0);
+
+/**
+ * Instruction set the kernels use on this CPU: "avx512", "avx2", "neon" or "scalar"
+ *
+ * Selected once at run time, so one binary uses the widest kernels the host supports.
+ */
+const char *KernelIsa();
+
+/**
+ * Converts nvalues interleaved I/Q values (2 per sample) between host formats, saturating
+ */
+void Fc32ToSc16(const float *in, int16_t *out, size_t nvalues);
+
+void Sc16ToFc32(const int16_t *in, float *out, size_t nvalues);
+
+void Fc32ToSc8(const float *in, int8_t *out, size_t nvalues);
+
+void Sc8ToFc32(const int8_t *in, float *out, size_t nvalues);
+
+/**
+ * samples = gain * samples + offset, in place
+ */
+void ApplyComplexGain(std::complex<float> *samples, size_t nsamps, std::complex<float> gain, std::complex<float> offset);
+
+/**
+ * Saturates nvalues values to [-limit, limit], in place
+ */
+void ClipValues(float *values, size_t nvalues, float limit);
+
+/**
+ * samples[i] *= factors[i], in place (e.g. mixing with an NCO table)
+ */
+void MultiplyComplex(std::complex<float> *samples, const std::complex<float> *factors, size_t nsamps);
+
+/**
+ * sum(samples[i] * taps[i]) over ntaps complex samples and real taps
+ *
+ * @param paired_taps The taps with every value repeated twice (once for I, once for Q), 2 * ntaps floats
+ */
+std::complex<float> FirDotProduct(const std::complex<float> *samples, const float *paired_taps, size_t ntaps);
+
+/**
+ * sum(samples[i] * conj(reference[i])) over nsamps samples (one lag of a cross-correlation)
+ */
+std::complex<float> CorrelateConjugate(const std::complex<float> *samples, const std::complex<float> *reference, size_t nsamps);
+
+/**
+ * out[i] = |samples[i]|^2
+ */
+void MagnitudeSquared(const std::complex<float> *samples, float *out, size_t nsamps);
+
+/**
+ * Converts nsamps samples between host formats (fc32, sc16, sc8) and applies a correction
+ *
+ * in and out may be the same buffer when the formats have the same sample size. Non-fc32
+ * samples with a correction go through an fc32 scratch buffer, chunk by chunk.
+ */
+void ProcessSamples(const std::byte *in, const std::string &in_format, std::byte *out, const std::string &out_format, size_t nsamps,
+                    const SampleCorrection &correction = {});
+
+/**
+ * Splits a sample-major buffer (sample 0 of every channel, then sample 1, ...) into one buffer per channel
+ *
+ * @param sample_size Bytes per sample
+ * @param out One destination per channel, each with room for nsamps samples
+ */
+void DeinterleaveChannels(const std::byte *in, size_t sample_size, size_t nsamps, const std::vector<std::byte *> &out);
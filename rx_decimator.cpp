@@ -0,0 +1,112 @@
+#include "rx_decimator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <numbers>
+#include <numeric>
+#include <ranges>
+#include <stdexcept>
+#include <utility>
+
+#include "dsp_kernels.h"
+#include "usrp_transceiver.h"
+
+using std::string;
+
+RxDecimator::RxDecimator(size_t num_channels, size_t decimation, double rate, const std::vector<double> &mix_freqs, const std::vector<float> &taps,
+                         string cpu_format) : decimation(decimation), cpu_format(std::move(cpu_format)) {
+    if (decimation == 0) {
+        throw std::invalid_argument("Decimation must be at least 1");
+    }
+    if (not mix_freqs.empty() and mix_freqs.size() != num_channels) {
+        throw std::invalid_argument(std::format("Expected {} mixer frequencies, got {}", num_channels, mix_freqs.size()));
+    }
+
+    const std::vector<float> filter = taps.empty() ? DesignLowpass(decimation) : taps;
+    ntaps = filter.size();
+    for (auto tap: filter | std::views::reverse) {
+        paired_taps.push_back(tap);
+        paired_taps.push_back(tap);
+    }
+
+    channels.resize(num_channels);
+    for (size_t ch = 0; ch < num_channels; ++ch) {
+        Channel &channel = channels[ch];
+        channel.work.assign(ntaps - 1 + kChunk, {0, 0});
+        channel.results.resize(kChunk / decimation + 1);
+        if (not mix_freqs.empty() and mix_freqs[ch] != 0) {
+            channel.step = -2 * std::numbers::pi * mix_freqs[ch] / rate;
+            for (size_t i = 0; i < kChunk; ++i) {
+                channel.rotation.emplace_back(std::polar(1.0, channel.step * static_cast<double>(i)));
+            }
+        }
+    }
+}
+
+size_t RxDecimator::Process(size_t ch, const std::byte *in, size_t nsamps, std::byte *out) {
+    Channel &channel = channels[ch];
+    const size_t in_size = SampleSize(cpu_format);
+    const size_t history = ntaps - 1;
+
+    size_t written = 0;
+    for (size_t done = 0; done < nsamps; done += kChunk) {
+        const size_t n = std::min(kChunk, nsamps - done);
+        std::complex<float> *data = channel.work.data() + history;
+        ProcessSamples(in + done * in_size, cpu_format, reinterpret_cast<std::byte *>(data), "fc32", n);
+
+        if (not channel.rotation.empty()) {
+            MultiplyComplex(data, channel.rotation.data(), n);
+            ApplyComplexGain(data, n, std::polar(1.0f, static_cast<float>(channel.phase)), {0, 0});
+            channel.phase = std::remainder(channel.phase + channel.step * static_cast<double>(n), 2 * std::numbers::pi);
+        }
+
+        // Only the kept outputs are computed: window [k, k + taps) of work ends at input sample k of the chunk
+        size_t count = 0;
+        size_t k = channel.next;
+        for (; k < n; k += decimation) {
+            channel.results[count++] = FirDotProduct(channel.work.data() + k, paired_taps.data(), ntaps);
+        }
+        channel.next = k - n;
+
+        ProcessSamples(reinterpret_cast<const std::byte *>(channel.results.data()), "fc32", out + written * in_size, cpu_format, count);
+        written += count;
+        std::copy(channel.work.begin() + static_cast<std::ptrdiff_t>(n), channel.work.begin() + static_cast<std::ptrdiff_t>(n + history), channel.work.begin());
+    }
+    return written;
+}
+
+size_t RxDecimator::Skip(size_t ch, size_t nsamps) {
+    Channel &channel = channels[ch];
+    std::fill(channel.work.begin(), channel.work.end(), std::complex<float>(0, 0));
+    channel.phase = std::remainder(channel.phase + channel.step * static_cast<double>(nsamps), 2 * std::numbers::pi);
+
+    const size_t skipped = channel.next < nsamps ? (nsamps - channel.next + decimation - 1) / decimation : 0;
+    channel.next = channel.next + skipped * decimation - nsamps;
+    return skipped;
+}
+
+std::vector<float> RxDecimator::DesignLowpass(size_t decimation) {
+    if (decimation <= 1) {
+        return {1.0f};
+    }
+    constexpr double kBeta = 7.0;
+    const size_t ntaps = 16 * decimation + 1;
+    const double center = static_cast<double>(ntaps - 1) / 2;
+    const double cutoff = 0.5 / static_cast<double>(decimation); // Cycles per input sample
+
+    std::vector<double> taps(ntaps);
+    for (size_t i = 0; i < ntaps; ++i) {
+        const double t = static_cast<double>(i) - center;
+        const double sinc = t == 0 ? 2 * cutoff : std::sin(2 * std::numbers::pi * cutoff * t) / (std::numbers::pi * t);
+        const double ratio = t / center;
+        taps[i] = sinc * std::cyl_bessel_i(0.0, kBeta * std::sqrt(1 - ratio * ratio)) / std::cyl_bessel_i(0.0, kBeta);
+    }
+    // Unity gain at DC
+    const double sum = std::accumulate(taps.begin(), taps.end(), 0.0);
+    std::vector<float> normalized;
+    for (double tap: taps) {
+        normalized.push_back(static_cast<float>(tap / sum));
+    }
+    return normalized;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * Per-channel NCO mixer and polyphase FIR decimator for RX samples
+ *
+ * Every channel is mixed by e^(-j 2 pi mix_freq t), which moves a band at +mix_freq to DC,
+ * low-pass filtered and decimated, computing only the outputs that are kept. Samples are
+ * in the CPU format on both sides and in fc32 inside. Channels keep their own NCO phase
+ * and filter history, so a stream can be processed in pieces of any size and different
+ * channels can be processed concurrently.
+ *
+ * Output k corresponds to input k * decimation; the filter delays the signal by
+ * (taps - 1) / 2 input samples.
+ */
+class RxDecimator {
+public:
+    /**
+     * @param num_channels Channels to keep state for
+     * @param decimation Input samples per output sample
+     * @param rate Input sample rate in Hz
+     * @param mix_freqs NCO frequency of each channel in Hz; empty does not mix
+     * @param taps Low-pass filter at the input rate; empty uses DesignLowpass(decimation)
+     * @param cpu_format Sample format of the input and output
+     */
+    RxDecimator(size_t num_channels, size_t decimation, double rate, const std::vector<double> &mix_freqs, const std::vector<float> &taps,
+                std::string cpu_format);
+
+    /**
+     * Mixes and filters nsamps input samples of one channel and writes the outputs they complete
+     *
+     * @param out Room for MaxOutput(nsamps) samples in the CPU format
+     * @return Output samples written
+     */
+    size_t Process(size_t ch, const std::byte *in, size_t nsamps, std::byte *out);
+
+    /**
+     * Advances one channel over nsamps lost input samples, clearing its filter history
+     *
+     * @return Output samples that fall into the gap
+     */
+    size_t Skip(size_t ch, size_t nsamps);
+
+    [[nodiscard]] size_t MaxOutput(size_t nsamps) const { return nsamps / decimation + 1; }
+
+    [[nodiscard]] size_t Decimation() const { return decimation; }
+
+    /**
+     * Kaiser-windowed low-pass (16 * decimation + 1 taps, about 70 dB stopband) with its -6 dB
+     * point at the output Nyquist frequency, flat over roughly the inner 70% of the output band
+     */
+    static std::vector<float> DesignLowpass(size_t decimation);
+
+private:
+    static constexpr size_t kChunk = 4096; // Input samples per processing step
+
+    struct Channel {
+        std::vector<std::complex<float>> work; // Filter history (taps - 1 samples) followed by the current chunk in fc32
+        std::vector<std::complex<float>> rotation; // e^(j step i) for i < kChunk; empty when not mixing
+        double step{0}; // NCO phase increment per input sample
+        double phase{0};
+        size_t next{0}; // Index of the next output's input sample within the current chunk
+        std::vector<std::complex<float>> results; // fc32 outputs of one chunk, before conversion
+    };
+
+    size_t decimation;
+    std::string cpu_format;
+    size_t ntaps;
+    std::vector<float> paired_taps; // Reversed taps, each repeated for I and Q (see FirDotProduct)
+    std::vector<Channel> channels;
+};
@@ -0,0 +1,92 @@
+#include "rx_publisher.h"
+
+#include <format>
+
+#include "usrp_protocol.pb.h"
+
+using std::format;
+using std::string;
+
+RxPublisher::RxPublisher(zmq::socket_t &pub_sock, UsrpTransceiver &transceiver) : pub_sock(pub_sock), transceiver(transceiver) {}
+
+RxPublisher::~RxPublisher() {
+    try {
+        Stop();
+    } catch (const std::exception &e) {
+        UHD_LOG_ERROR("PUBLISH", format("Error while stopping RX stream: {}", e.what()));
+    }
+}
+
+void RxPublisher::Start(size_t num_channels, const string &cpu_format, size_t block_samps, size_t num_blocks, int numa_node) {
+    if (Running()) {
+        throw std::runtime_error("RX stream already running");
+    }
+
+    this->cpu_format = cpu_format;
+    ring = std::make_unique<SampleRing>(num_channels, SampleSize(cpu_format), block_samps, num_blocks, true, numa_node);
+    published = 0;
+    error = nullptr;
+    stop_signal = false;
+
+    UHD_LOG_INFO("PUBLISH", format("Starting RX stream: {} channels, {} samples per block, {} blocks buffered", num_channels, block_samps, num_blocks));
+    thread = std::thread(&RxPublisher::Run, this);
+}
+
+size_t RxPublisher::Stop() {
+    if (not Running()) {
+        return published;
+    }
+    stop_signal = true;
+    thread.join();
+
+    UHD_LOG_INFO("PUBLISH", format("RX stream stopped after {} blocks ({} dropped)", published, ring->Overflows()));
+    if (error) {
+        std::rethrow_exception(std::exchange(error, nullptr));
+    }
+    return published;
+}
+
+void RxPublisher::Run() {
+    std::thread publish_thread(&RxPublisher::PublishLoop, this);
+
+    try {
+        transceiver.ReceiveToBlocks([this] { return ring->Acquire(); },
+                                    [this](const RxBlock &block, size_t nsamps, const uhd::time_spec_t &time_spec) { ring->Commit(block, nsamps, time_spec); },
+                                    stop_signal);
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    ring->Close();
+    publish_thread.join();
+}
+
+void RxPublisher::PublishLoop() {
+    while (ring->Wait()) {
+        Publish(ring->Front(), ring->FrontInfo());
+        ring->Release();
+    }
+}
+
+void RxPublisher::Publish(const RxBlock &block, const SampleRing::BlockInfo &info) {
+    usrp_proto::StreamBlock header;
+    header.set_seq(info.seq);
+    header.set_time_full(info.time_spec.get_full_secs());
+    header.set_time_frac(info.time_spec.get_frac_secs());
+    header.set_nsamps(info.nsamps);
+    header.set_num_ch(block.buffs.size());
+    header.set_cpu_format(cpu_format);
+
+    string serialized_header;
+    header.SerializeToString(&serialized_header);
+
+    // seq counts every committed block, so blocks dropped by the ring or by PUB show up as gaps
+    const size_t bytes = info.nsamps * SampleSize(cpu_format);
+    pub_sock.send(zmq::str_buffer("rx"), zmq::send_flags::sndmore);
+    pub_sock.send(zmq::buffer(serialized_header), zmq::send_flags::sndmore);
+    for (size_t ch = 0; ch < block.buffs.size(); ++ch) {
+        auto flags = ch + 1 < block.buffs.size() ? zmq::send_flags::sndmore : zmq::send_flags::none;
+        pub_sock.send(zmq::buffer(block.buffs[ch], bytes), flags);
+    }
+    ++published;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <zmq.hpp>
+
+#include "sample_ring.h"
+#include "usrp_transceiver.h"
+
+/**
+ * Continuous RX stream published block by block on a ZMQ PUB socket
+ *
+ * Reception runs on its own thread so the server's request socket stays responsive.
+ * Received blocks go through a SampleRing to a second thread that sends each one as a
+ * multipart message ["rx", StreamBlock, ch0, ch1, ...], so ZMQ never delays recv.
+ * The PUB socket is only touched by the publishing thread while the stream runs.
+ */
+class RxPublisher {
+public:
+    RxPublisher(zmq::socket_t &pub_sock, UsrpTransceiver &transceiver);
+
+    ~RxPublisher();
+
+    RxPublisher(const RxPublisher &) = delete;
+
+    RxPublisher &operator=(const RxPublisher &) = delete;
+
+    /**
+     * Starts streaming with the transceiver's current configuration
+     *
+     * @param num_channels Number of RX channels
+     * @param cpu_format Host sample format of the published data
+     * @param block_samps Samples per channel in each published block
+     * @param num_blocks Blocks buffered between reception and publishing
+     * @param numa_node NUMA node for the block buffers (-1 = any)
+     */
+    void Start(size_t num_channels, const std::string &cpu_format, size_t block_samps, size_t num_blocks, int numa_node = -1);
+
+    /**
+     * Stops streaming and waits for the streaming thread
+     *
+     * Rethrows any error raised while streaming.
+     *
+     * @return Number of blocks published
+     */
+    size_t Stop();
+
+    [[nodiscard]] bool Running() const { return thread.joinable(); }
+
+    /**
+     * @return Blocks dropped because publishing fell behind reception (last stream)
+     */
+    [[nodiscard]] uint64_t Overflows() const { return ring ? ring->Overflows() : 0; }
+
+private:
+    zmq::socket_t &pub_sock;
+    UsrpTransceiver &transceiver;
+
+    std::atomic<bool> stop_signal{false};
+    std::thread thread;
+    std::exception_ptr error;
+
+    std::string cpu_format;
+    std::unique_ptr<SampleRing> ring;
+    size_t published{0};
+
+    void Run();
+
+    void PublishLoop();
+
+    void Publish(const RxBlock &block, const SampleRing::BlockInfo &info);
+};
@@ -0,0 +1,129 @@
+#include "rx_segment_pool.h"
+
+#include <format>
+#include <stdexcept>
+#include <utility>
+
+#include <uhd/utils/log.hpp>
+
+using std::format;
+using std::string;
+
+RxSegmentPool::RxSegmentPool(string base_name, size_t pool_size) : base_name(std::move(base_name)) {
+    if (pool_size == 0) {
+        throw std::invalid_argument("RX segment pool needs at least one segment");
+    }
+    for (size_t i = 0; i < pool_size; ++i) {
+        entries[i == 0 ? this->base_name : format("{}_{}", this->base_name, i)].pooled = true;
+    }
+}
+
+ShmSegment &RxSegmentPool::Acquire(const string &requested, const string &client, size_t bytes, int numa_node) {
+    Entry *entry = nullptr;
+    string name = requested;
+    {
+        std::lock_guard lock(mutex);
+        if (not requested.empty()) {
+            entry = &entries[requested];
+            if (entry->state == State::Held and entry->client != client) {
+                throw std::runtime_error(format("RX segment {} is held by another client", requested));
+            }
+        } else {
+            // A free pool segment, otherwise the one holding the oldest result
+            Entry *oldest = nullptr;
+            for (auto &[pool_name, candidate]: entries) {
+                if (not candidate.pooled) {
+                    continue;
+                }
+                if (candidate.state == State::Free) {
+                    entry = &candidate;
+                    name = pool_name;
+                    break;
+                }
+                if (candidate.state == State::Held and (not oldest or candidate.held_seq < oldest->held_seq)) {
+                    oldest = &candidate;
+                    name = pool_name;
+                }
+            }
+            if (not entry) {
+                entry = oldest;
+                UHD_LOG_WARNING("RXPOOL", format("All RX pool segments are held, overwriting the oldest result in {}", name));
+            }
+        }
+        entry->state = State::Capturing;
+        entry->client = client;
+    }
+
+    // Only the burst worker touches a capturing segment, so it is (re)created without the lock
+    try {
+        if (not entry->segment.valid()) {
+            entry->segment = ShmSegment::Create(name, bytes, numa_node);
+        } else if (entry->segment.size() != bytes) {
+            entry->segment.Resize(bytes);
+        }
+    } catch (...) {
+        std::lock_guard lock(mutex);
+        entry->state = State::Free;
+        throw;
+    }
+    return entry->segment;
+}
+
+void RxSegmentPool::Finish(const ShmSegment &segment, bool delivered) {
+    std::lock_guard lock(mutex);
+    Entry &entry = Find(segment);
+    if (delivered) {
+        entry.state = State::Held;
+        entry.held_seq = ++deliveries;
+    } else {
+        entry.state = State::Free;
+    }
+}
+
+size_t RxSegmentPool::Release(const string &name, const string &client) {
+    std::lock_guard lock(mutex);
+    size_t released = 0;
+    for (auto it = entries.begin(); it != entries.end();) {
+        auto &[entry_name, entry] = *it;
+        const bool selected = name.empty() ? entry.state == State::Held and entry.client == client : entry_name == name;
+        if (not selected) {
+            ++it;
+            continue;
+        }
+        if (entry.state == State::Capturing) {
+            throw std::runtime_error(format("RX segment {} is being captured into", entry_name));
+        }
+        if (entry.state == State::Held and entry.client != client) {
+            throw std::runtime_error(format("RX segment {} is held by another client", entry_name));
+        }
+
+        ++released;
+        if (entry.pooled) {
+            entry.state = State::Free;
+            entry.client.clear();
+            ++it;
+        } else {
+            UHD_LOG_DEBUG("RXPOOL", format("Removing RX segment {}", entry_name));
+            it = entries.erase(it);
+        }
+    }
+    return released;
+}
+
+bool RxSegmentPool::ValidName(const string &name) const {
+    if (name.size() < 2 or name.size() > 255 or name[0] != '/' or name.find('/', 1) != string::npos) {
+        return false;
+    }
+    std::lock_guard lock(mutex);
+    auto it = entries.find(name);
+    return it == entries.end() or not it->second.pooled;
+}
+
+RxSegmentPool::Entry &RxSegmentPool::Find(const ShmSegment &segment) {
+    for (auto &[name, entry]: entries) {
+        if (&entry.segment == &segment) {
+            return entry;
+        }
+    }
+    throw std::logic_error("Segment does not belong to this pool");
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "shm_segment.h"
+
+/**
+ * Server-owned RX result segments, held by clients until they RELEASE them
+ *
+ * A capture goes either into a segment named by the client, which is dedicated to it
+ * and reused for later captures of the same name, or into one of pool_size shared
+ * segments (base_name, base_name_1, ...). A pool segment is not reused while a client
+ * holds its result, unless every pool segment is held, in which case the oldest result
+ * is overwritten. Segments are resized for every capture and keep their mapping
+ * between captures.
+ *
+ * Acquire/Finish are called by the burst worker, Release by the request loop.
+ */
+class RxSegmentPool {
+public:
+    /**
+     * @param base_name Name of the first pool segment; the others get a _<n> suffix
+     * @param pool_size Number of pool segments (at least 1)
+     */
+    RxSegmentPool(std::string base_name, size_t pool_size);
+
+    RxSegmentPool(const RxSegmentPool &) = delete;
+
+    RxSegmentPool &operator=(const RxSegmentPool &) = delete;
+
+    /**
+     * Reserves a segment of the given size for a capture
+     *
+     * The reference stays valid, and the segment is not released, until Finish.
+     *
+     * @param requested Client-supplied name; empty picks a pool segment
+     * @param client Identity of the client the result will belong to
+     * @param bytes Capture size
+     * @param numa_node NUMA node for newly created segments (-1 = any)
+     */
+    ShmSegment &Acquire(const std::string &requested, const std::string &client, size_t bytes, int numa_node);
+
+    /**
+     * Ends a capture started by Acquire
+     *
+     * @param delivered The result was handed to the client, who holds it until Release
+     */
+    void Finish(const ShmSegment &segment, bool delivered);
+
+    /**
+     * Releases a segment held by a client
+     *
+     * Client-named segments are removed; pool segments become free for the next capture.
+     *
+     * @param name Segment to release; empty releases every segment held by client
+     * @return Number of segments released
+     */
+    size_t Release(const std::string &name, const std::string &client);
+
+    /**
+     * Checks that a client-supplied segment name is usable
+     */
+    [[nodiscard]] bool ValidName(const std::string &name) const;
+
+private:
+    enum class State { Free, Capturing, Held };
+
+    struct Entry {
+        ShmSegment segment;
+        State state{State::Free};
+        bool pooled{false};
+        std::string client;
+        uint64_t held_seq{0}; // Order in which results were delivered
+    };
+
+    std::string base_name;
+    mutable std::mutex mutex;
+    std::map<std::string, Entry> entries; // Node-based, so Acquire's references survive other inserts
+    uint64_t deliveries{0};
+
+    Entry &Find(const ShmSegment &segment);
+};
@@ -0,0 +1,97 @@
+#include "rx_trigger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+#include "dsp_kernels.h"
+#include "usrp_transceiver.h"
+
+TriggerDetector::TriggerDetector(const std::string &mode, double threshold, size_t window, const std::vector<std::complex<float>> &reference,
+                                 std::string cpu_format) : cpu_format(std::move(cpu_format)), reference(reference) {
+    if (mode == "correlation") {
+        if (reference.empty()) {
+            throw std::invalid_argument("Correlation trigger needs a reference");
+        }
+        correlate = true;
+        length = reference.size();
+        for (const auto &sample: reference) {
+            reference_energy += std::norm(sample);
+        }
+        if (reference_energy == 0) {
+            throw std::invalid_argument("Correlation trigger reference is all zeros");
+        }
+        this->threshold = static_cast<float>(threshold * threshold);
+    } else if (mode == "power") {
+        if (window == 0) {
+            throw std::invalid_argument("Power trigger window must be at least 1 sample");
+        }
+        correlate = false;
+        length = window;
+        this->threshold = static_cast<float>(std::pow(10.0, threshold / 10));
+    } else {
+        throw std::invalid_argument(std::format("Unknown trigger mode: {}", mode));
+    }
+    work.assign(length - 1 + kChunk, {0, 0});
+    power.assign(length - 1 + kChunk, 0);
+}
+
+void TriggerDetector::Process(const std::byte *in, size_t nsamps, long long position, const Fire &fire) {
+    const size_t in_size = SampleSize(cpu_format);
+    const size_t keep = length - 1;
+
+    for (size_t done = 0; done < nsamps; done += kChunk) {
+        const size_t n = std::min(kChunk, nsamps - done);
+        std::complex<float> *data = work.data() + keep;
+        ProcessSamples(in + done * in_size, cpu_format, reinterpret_cast<std::byte *>(data), "fc32", n);
+        MagnitudeSquared(data, power.data() + keep, n);
+
+        // Window [k, k + L) of work starts at stream position chunk_start + k - (L - 1)
+        const long long chunk_start = position + static_cast<long long>(done) - static_cast<long long>(keep);
+        const size_t first = keep - history;
+        if (first < n) {
+            double energy = std::accumulate(power.begin() + static_cast<std::ptrdiff_t>(first),
+                                            power.begin() + static_cast<std::ptrdiff_t>(first + length), 0.0);
+            for (size_t k = first; k < n; ++k) {
+                const long long start = chunk_start + static_cast<long long>(k);
+                if (pending and start > pending_position + static_cast<long long>(length)) {
+                    pending = false;
+                    fire(pending_position, Reported(pending_metric));
+                }
+                if (start >= armed and energy > 0) {
+                    float metric;
+                    if (correlate) {
+                        metric = static_cast<float>(std::norm(CorrelateConjugate(work.data() + k, reference.data(), length)) / (reference_energy * energy));
+                    } else {
+                        metric = static_cast<float>(energy / static_cast<double>(length));
+                    }
+                    if (metric >= threshold and (not pending or metric > pending_metric)) {
+                        pending = true;
+                        pending_position = start;
+                        pending_metric = metric;
+                    }
+                }
+                if (k + 1 < n) {
+                    energy += power[k + length] - power[k];
+                }
+            }
+        }
+
+        std::copy(work.begin() + static_cast<std::ptrdiff_t>(n), work.begin() + static_cast<std::ptrdiff_t>(n + keep), work.begin());
+        std::copy(power.begin() + static_cast<std::ptrdiff_t>(n), power.begin() + static_cast<std::ptrdiff_t>(n + keep), power.begin());
+        history = std::min(keep, history + n);
+    }
+}
+
+void TriggerDetector::Flush(const Fire &fire) {
+    if (std::exchange(pending, false)) {
+        fire(pending_position, Reported(pending_metric));
+    }
+}
+
+void TriggerDetector::Reset() { history = 0; }
+
+float TriggerDetector::Reported(float metric) const { return correlate ? std::sqrt(metric) : 10 * std::log10(metric); }
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Burst detector for the trigger channel of a triggered capture
+ *
+ * Slides a window of L samples over the stream and fires where the window's metric
+ * crosses the threshold:
+ *
+ *   power:       mean |x|^2 over L = trigger_window samples, threshold in dBFS
+ *   correlation: |sum x[k] conj(r[k])| / (|x| |r|) against the L-sample reference r,
+ *                threshold between 0 and 1 (independent of the signal level)
+ *
+ * After a crossing the detector keeps looking for one more window length and reports the
+ * window with the highest metric, so a correlation peak is located to the sample. The
+ * reported position is the first sample of that window. Samples are in the CPU format;
+ * the stream can be passed in pieces of any size.
+ */
+class TriggerDetector {
+public:
+    /**
+     * Called with the stream position of a detection and its metric (dBFS or correlation)
+     */
+    using Fire = std::function<void(long long position, float metric)>;
+
+    /**
+     * @param mode "power" or "correlation"
+     * @param threshold dBFS for power, 0 to 1 for correlation
+     * @param window Averaging length for power
+     * @param reference Preamble to correlate against (fc32, full scale 1.0)
+     * @param cpu_format Sample format of the input
+     */
+    TriggerDetector(const std::string &mode, double threshold, size_t window, const std::vector<std::complex<float>> &reference, std::string cpu_format);
+
+    /**
+     * Scans nsamps samples that follow the previous call's, calling fire for every detection
+     *
+     * @param position Stream position of in[0]
+     */
+    void Process(const std::byte *in, size_t nsamps, long long position, const Fire &fire);
+
+    /**
+     * Reports a detection still waiting for its window to pass, at the end of the stream
+     */
+    void Flush(const Fire &fire);
+
+    /**
+     * Forgets the history after samples were lost, so no window spans the gap
+     */
+    void Reset();
+
+    /**
+     * Ignores windows that start before position; may be called from fire
+     */
+    void Arm(long long position) { armed = position; }
+
+    /**
+     * How far behind the newest sample a reported window can start (about two window lengths)
+     */
+    [[nodiscard]] size_t Lag() const { return 2 * length + 1; }
+
+private:
+    static constexpr size_t kChunk = 4096; // Input samples per processing step
+
+    bool correlate;
+    size_t length; // L
+    float threshold; // Linear mean power, or squared correlation
+    std::string cpu_format;
+    std::vector<std::complex<float>> reference;
+    double reference_energy{0};
+
+    std::vector<std::complex<float>> work; // History (L - 1 samples) followed by the current chunk in fc32
+    std::vector<float> power; // |work|^2
+    size_t history{0}; // Valid history samples, fewer than L - 1 right after a reset
+    long long armed{0};
+
+    // Best window since the last crossing, reported once a window length has passed without a higher one
+    bool pending{false};
+    long long pending_position{0};
+    float pending_metric{0};
+
+    [[nodiscard]] float Reported(float metric) const;
+};
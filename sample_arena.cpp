@@ -0,0 +1,129 @@
+#include "sample_arena.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <stdexcept>
+
+#include <linux/mman.h>
+#include <sys/mman.h>
+
+#include <uhd/utils/log.hpp>
+
+#include "thread_utils.h"
+
+using std::format;
+
+namespace {
+    constexpr size_t kHugePageSize = 2 << 20;
+    constexpr size_t kGigaPageSize = size_t{1} << 30;
+
+    size_t AlignUp(size_t value, size_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+} // namespace
+
+SampleArena &SampleArena::Instance() {
+    static SampleArena arena;
+    return arena;
+}
+
+SampleArena::~SampleArena() {
+    if (memory) {
+        munmap(memory, mapped_bytes);
+    }
+}
+
+void SampleArena::Configure(size_t bytes, bool lock, int numa_node) {
+    std::lock_guard guard(mutex);
+    if (memory or live > 0) {
+        throw std::logic_error("SampleArena must be configured once, before any buffer is allocated");
+    }
+    if (numa_node < -1 or numa_node >= kMaxNumaNodes) {
+        throw std::invalid_argument(format("Invalid NUMA node for the sample arena: {}", numa_node));
+    }
+    if (bytes == 0) {
+        return;
+    }
+
+    // 1 GiB pages for large arenas, then 2 MiB pages, then transparent huge pages
+    void *ptr = MAP_FAILED;
+    const char *backing = "hugetlb 1 GiB";
+    if (bytes >= kGigaPageSize) {
+        mapped_bytes = AlignUp(bytes, kGigaPageSize);
+        ptr = mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_1GB, -1, 0);
+    }
+    if (ptr == MAP_FAILED) {
+        backing = "hugetlb 2 MiB";
+        mapped_bytes = AlignUp(bytes, kHugePageSize);
+        ptr = mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+    }
+    if (ptr == MAP_FAILED) {
+        backing = "transparent huge pages";
+        ptr = mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) {
+            throw std::runtime_error(format("Cannot reserve a {} MiB sample arena: {}", mapped_bytes >> 20, strerror(errno)));
+        }
+        madvise(ptr, mapped_bytes, MADV_HUGEPAGE);
+    }
+    memory = static_cast<std::byte *>(ptr);
+    capacity = mapped_bytes;
+    free_blocks.emplace(0, capacity);
+
+    // Bind before the first touch so no page has to be migrated, then fault everything in now
+    BindToNumaNode(memory, mapped_bytes, numa_node);
+    std::memset(memory, 0, mapped_bytes);
+    if (lock and mlock(memory, mapped_bytes) == -1) {
+        UHD_LOG_WARNING("ARENA", format("mlock of the sample arena failed (raise RLIMIT_MEMLOCK): {}", strerror(errno)));
+    }
+    UHD_LOG_INFO("ARENA", format("Sample arena: {} MiB, {}{}", mapped_bytes >> 20, backing, lock ? ", locked" : ""));
+}
+
+void *SampleArena::Allocate(size_t bytes) {
+    {
+        std::lock_guard guard(mutex);
+        const size_t size = AlignUp(std::max<size_t>(bytes, 1), kAlignment);
+        const auto block = std::ranges::find_if(free_blocks, [size](const auto &free) { return free.second >= size; });
+        if (block != free_blocks.end()) {
+            const auto [offset, free_size] = *block;
+            free_blocks.erase(block);
+            if (free_size > size) {
+                free_blocks.emplace(offset + size, free_size - size);
+            }
+            in_use += size;
+            ++live;
+            return memory + offset;
+        }
+        if (memory) {
+            UHD_LOG_WARNING("ARENA", format("Sample arena full ({} of {} MiB in use), {} MiB buffer allocated on the heap; raise the arena size", in_use >> 20, capacity >> 20, bytes >> 20));
+        }
+    }
+    return ::operator new(bytes, std::align_val_t(kAlignment));
+}
+
+void SampleArena::Deallocate(void *ptr, size_t bytes) noexcept {
+    auto *p = static_cast<std::byte *>(ptr);
+    if (memory and p >= memory and p < memory + capacity) {
+        std::lock_guard guard(mutex);
+        size_t offset = p - memory;
+        size_t size = AlignUp(std::max<size_t>(bytes, 1), kAlignment);
+        in_use -= size;
+        --live;
+        // Merge with the free neighbours so large buffers fit again once a burst's buffers are all back
+        auto next = free_blocks.lower_bound(offset);
+        if (next != free_blocks.end() and next->first == offset + size) {
+            size += next->second;
+            next = free_blocks.erase(next);
+        }
+        if (next != free_blocks.begin()) {
+            const auto prev = std::prev(next);
+            if (prev->first + prev->second == offset) {
+                prev->second += size;
+                return;
+            }
+        }
+        free_blocks.emplace_hint(next, offset, size);
+        return;
+    }
+    ::operator delete(ptr, bytes, std::align_val_t(kAlignment));
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <new>
+#include <utility>
+
+/**
+ * Process-wide, pre-faulted memory for sample buffers
+ *
+ * Configure reserves one region up front, backed by 1 GiB or 2 MiB huge pages when the
+ * system has them (transparent huge pages otherwise), bound to a NUMA node, faulted in and
+ * optionally locked with mlock, so buffers carved from it never take a page fault or get
+ * zeroed by the kernel while streaming. Allocations are page-aligned and taken first-fit from
+ * a free list whose neighbouring blocks are merged on release, so buffers of pipelined jobs
+ * that overlap in time are still reused. A buffer that does not fit is allocated on the heap
+ * with a warning; every buffer before Configure comes from the heap as well.
+ */
+class SampleArena {
+public:
+    static SampleArena &Instance();
+
+    SampleArena(const SampleArena &) = delete;
+
+    SampleArena &operator=(const SampleArena &) = delete;
+
+    /**
+     * Reserves and pre-faults the arena; call once at startup, before any buffer is allocated
+     *
+     * @param bytes Arena size; rounded up to the huge page size
+     * @param lock mlock the arena so it is never swapped out (needs RLIMIT_MEMLOCK or CAP_IPC_LOCK)
+     * @param numa_node NUMA node to place the arena on; -1 leaves placement to the kernel
+     * @throws std::invalid_argument numa_node is outside [-1, kMaxNumaNodes)
+     */
+    void Configure(size_t bytes, bool lock, int numa_node);
+
+    void *Allocate(size_t bytes);
+
+    void Deallocate(void *ptr, size_t bytes) noexcept;
+
+    [[nodiscard]] size_t Capacity() const { return capacity; }
+
+private:
+    static constexpr size_t kAlignment = 4096; // Page-aligned, e.g. for O_DIRECT writes of whole buffers
+
+    SampleArena() = default;
+
+    ~SampleArena();
+
+    std::mutex mutex;
+    std::byte *memory{nullptr};
+    size_t capacity{0};
+    size_t mapped_bytes{0};
+    std::map<size_t, size_t> free_blocks; // Offset to size of each free block, never adjacent
+    size_t in_use{0}; // Bytes handed out
+    size_t live{0}; // Allocations not yet freed
+};
+
+/**
+ * Allocator carving its memory from SampleArena
+ *
+ * Elements are default-initialized, so resizing a byte buffer does not write zeros over
+ * memory that is about to be overwritten with samples anyway.
+ */
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    ArenaAllocator() noexcept = default;
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &) noexcept {}
+
+    T *allocate(size_t n) { return static_cast<T *>(SampleArena::Instance().Allocate(n * sizeof(T))); }
+
+    void deallocate(T *ptr, size_t n) noexcept { SampleArena::Instance().Deallocate(ptr, n * sizeof(T)); }
+
+    template <typename U>
+    void construct(U *ptr) noexcept {
+        ::new (static_cast<void *>(ptr)) U;
+    }
+
+    template <typename U, typename... Args>
+    void construct(U *ptr, Args &&...args) {
+        ::new (static_cast<void *>(ptr)) U(std::forward<Args>(args)...);
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &) const noexcept {
+        return true;
+    }
+};
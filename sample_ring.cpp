@@ -0,0 +1,124 @@
+#include "sample_ring.h"
+
+#include <cstring>
+#include <format>
+#include <new>
+#include <thread>
+
+#include <sys/mman.h>
+
+#include "thread_utils.h"
+
+using std::format;
+
+namespace {
+    constexpr size_t kPageSize = 4096;
+    constexpr size_t kHugePageSize = 2 << 20;
+
+    size_t AlignUp(size_t value, size_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+} // namespace
+
+SampleRing::SampleRing(size_t num_channels, size_t sample_size, size_t block_samps, size_t num_blocks, bool hugepages, int numa_node) :
+    num_channels(num_channels), block_samps(block_samps), num_blocks(num_blocks) {
+    if (num_channels == 0 or block_samps == 0 or num_blocks == 0) {
+        throw std::invalid_argument("SampleRing needs at least one channel, sample and block");
+    }
+
+    // Every channel of every block (plus the scratch block) starts on a page boundary
+    const size_t channel_bytes = AlignUp(block_samps * sample_size, kPageSize);
+    const size_t total = channel_bytes * num_channels * (num_blocks + 1);
+
+    void *ptr = MAP_FAILED;
+    if (hugepages) {
+        memory_bytes = AlignUp(total, kHugePageSize);
+        ptr = mmap(nullptr, memory_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr == MAP_FAILED) {
+            UHD_LOG_DEBUG("RING", "No hugetlb pages available, falling back to transparent huge pages");
+        }
+    }
+    if (ptr == MAP_FAILED) {
+        memory_bytes = AlignUp(total, hugepages ? kHugePageSize : kPageSize);
+        ptr = mmap(nullptr, memory_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        if (hugepages) {
+            madvise(ptr, memory_bytes, MADV_HUGEPAGE);
+        }
+    }
+    memory = static_cast<std::byte *>(ptr);
+
+    // Bind before the first touch so no page has to be migrated, then fault everything in
+    // now instead of in the recv loop
+    BindToNumaNode(memory, memory_bytes, numa_node);
+    std::memset(memory, 0, memory_bytes);
+
+    auto make_block = [&](size_t index, size_t slot) {
+        RxBlock block{{}, block_samps, index};
+        for (size_t ch = 0; ch < num_channels; ++ch) {
+            block.buffs.push_back(memory + (slot * num_channels + ch) * channel_bytes);
+        }
+        return block;
+    };
+    for (size_t index = 0; index < num_blocks; ++index) {
+        blocks.push_back(make_block(index, index));
+    }
+    scratch = make_block(kScratchIndex, num_blocks);
+    infos.resize(num_blocks);
+
+    UHD_LOG_DEBUG("RING", format("Sample ring: {} blocks x {} channels x {} samples ({} MiB)", num_blocks, num_channels, block_samps, memory_bytes >> 20));
+}
+
+SampleRing::~SampleRing() { munmap(memory, memory_bytes); }
+
+RxBlock SampleRing::Acquire() {
+    const uint64_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= num_blocks) {
+        return scratch;
+    }
+    return blocks[h % num_blocks];
+}
+
+void SampleRing::Commit(const RxBlock &block, size_t nsamps, const uhd::time_spec_t &time_spec) {
+    const uint64_t seq = commit_seq++;
+    const uint64_t position = commit_position;
+    commit_position += nsamps;
+    if (block.index == kScratchIndex) {
+        overflows.fetch_add(1, std::memory_order_relaxed);
+        dropped_samps.fetch_add(nsamps, std::memory_order_relaxed);
+        return;
+    }
+    const uint64_t h = head.load(std::memory_order_relaxed);
+    infos[h % num_blocks] = {nsamps, time_spec, seq, position};
+    head.store(h + 1, std::memory_order_release);
+}
+
+void SampleRing::Close() { closed.store(true, std::memory_order_release); }
+
+bool SampleRing::Wait(std::chrono::microseconds poll_interval) { return WaitAvailable(1, poll_interval); }
+
+bool SampleRing::WaitAvailable(size_t count, std::chrono::microseconds poll_interval) {
+    while (true) {
+        // Check closed before head so a block committed just before Close is not missed
+        const bool is_closed = closed.load(std::memory_order_acquire);
+        if (head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed) >= count) {
+            return true;
+        }
+        if (is_closed) {
+            return false;
+        }
+        std::this_thread::sleep_for(poll_interval);
+    }
+}
+
+const RxBlock &SampleRing::Front() const { return blocks[tail.load(std::memory_order_relaxed) % num_blocks]; }
+
+const SampleRing::BlockInfo &SampleRing::FrontInfo() const { return infos[tail.load(std::memory_order_relaxed) % num_blocks]; }
+
+size_t SampleRing::Available() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed); }
+
+const RxBlock &SampleRing::At(size_t i) const { return blocks[(tail.load(std::memory_order_relaxed) + i) % num_blocks]; }
+
+const SampleRing::BlockInfo &SampleRing::InfoAt(size_t i) const { return infos[(tail.load(std::memory_order_relaxed) + i) % num_blocks]; }
+
+void SampleRing::Release() { tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
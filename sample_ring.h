@@ -0,0 +1,144 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "usrp_transceiver.h"
+
+/**
+ * Lock-free single-producer/single-consumer ring of RX sample blocks
+ *
+ * Sits between the UHD recv thread (producer) and a consumer such as the disk recorder
+ * or the stream publisher. Each block holds block_samps samples per channel, with every
+ * channel contiguous and page-aligned. The producer never waits: when the ring is full it
+ * receives into a scratch block that is discarded and counted as an overflow, so a slow
+ * consumer cannot stall the radio.
+ */
+class SampleRing {
+public:
+    /**
+     * Metadata of a block published by the producer
+     */
+    struct BlockInfo {
+        size_t nsamps{0}; // Valid samples per channel
+        uhd::time_spec_t time_spec; // Device time of the first sample
+        uint64_t seq{0}; // Commit sequence number, counting dropped blocks too
+        uint64_t position{0}; // Stream sample (per channel) of the first sample, counting dropped blocks too
+    };
+
+    /**
+     * @param num_channels Channels per block
+     * @param sample_size Size of one sample in bytes
+     * @param block_samps Samples per channel in each block
+     * @param num_blocks Number of blocks in the ring
+     * @param hugepages Back the ring with huge pages when available
+     * @param numa_node NUMA node to place the ring on; -1 leaves placement to the kernel
+     */
+    SampleRing(size_t num_channels, size_t sample_size, size_t block_samps, size_t num_blocks, bool hugepages = true, int numa_node = -1);
+
+    ~SampleRing();
+
+    SampleRing(const SampleRing &) = delete;
+
+    SampleRing &operator=(const SampleRing &) = delete;
+
+    /* ---------- Producer side ---------- */
+
+    /**
+     * Returns the next free block, or the scratch block when the ring is full
+     */
+    RxBlock Acquire();
+
+    /**
+     * Publishes a block obtained from Acquire (a scratch block is only counted as dropped)
+     */
+    void Commit(const RxBlock &block, size_t nsamps, const uhd::time_spec_t &time_spec);
+
+    /**
+     * Marks the end of the stream; the consumer drains what is left and then stops
+     */
+    void Close();
+
+    /* ---------- Consumer side ---------- */
+
+    /**
+     * Waits until a block is available or the ring has been closed and drained
+     *
+     * @return false when there is nothing left to consume
+     */
+    bool Wait(std::chrono::microseconds poll_interval = std::chrono::microseconds(100));
+
+    /**
+     * Waits until at least count blocks are available, for a consumer that keeps blocks unreleased as history
+     *
+     * @return false when the ring has been closed with fewer blocks left
+     */
+    bool WaitAvailable(size_t count, std::chrono::microseconds poll_interval = std::chrono::microseconds(100));
+
+    /**
+     * Published blocks not yet released
+     */
+    [[nodiscard]] size_t Available() const;
+
+    /**
+     * The i-th oldest published block (At(0) is Front()); only valid for i < Available()
+     */
+    [[nodiscard]] const RxBlock &At(size_t i) const;
+
+    [[nodiscard]] const BlockInfo &InfoAt(size_t i) const;
+
+    /**
+     * Memory holding every block, e.g. to register it for fixed-buffer I/O
+     */
+    [[nodiscard]] std::span<std::byte> Memory() const { return {memory, memory_bytes}; }
+
+    /**
+     * Oldest published block; only valid when Wait returned true
+     */
+    [[nodiscard]] const RxBlock &Front() const;
+
+    [[nodiscard]] const BlockInfo &FrontInfo() const;
+
+    /**
+     * Returns the oldest block to the producer
+     */
+    void Release();
+
+    /* ---------- Statistics ---------- */
+
+    [[nodiscard]] uint64_t Overflows() const { return overflows.load(std::memory_order_relaxed); }
+
+    [[nodiscard]] uint64_t DroppedSamples() const { return dropped_samps.load(std::memory_order_relaxed); }
+
+    [[nodiscard]] size_t BlockSamples() const { return block_samps; }
+
+    [[nodiscard]] size_t NumChannels() const { return num_channels; }
+
+private:
+    static constexpr size_t kCacheLine = 64;
+    static constexpr size_t kScratchIndex = static_cast<size_t>(-1);
+
+    size_t num_channels;
+    size_t block_samps;
+    size_t num_blocks;
+
+    std::byte *memory{nullptr};
+    size_t memory_bytes{0};
+
+    std::vector<RxBlock> blocks;
+    std::vector<BlockInfo> infos;
+    RxBlock scratch;
+
+    // Producer and consumer indices live on separate cache lines to avoid false sharing
+    alignas(kCacheLine) std::atomic<uint64_t> head{0}; // Written by the producer
+    alignas(kCacheLine) std::atomic<uint64_t> tail{0}; // Written by the consumer
+    alignas(kCacheLine) std::atomic<bool> closed{false};
+    uint64_t commit_seq{0}; // Producer only
+    uint64_t commit_position{0}; // Producer only
+    std::atomic<uint64_t> overflows{0};
+    std::atomic<uint64_t> dropped_samps{0};
+};
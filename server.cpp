@@ -1,15 +1,17 @@
+#include <algorithm>
 #include <atomic>
+#include <cctype>
+#include <chrono>
 #include <csignal>
 #include <format>
+#include <functional>
 #include <future>
+#include <iterator>
+#include <memory>
+#include <optional>
 #include <vector>
 #include <zmq.hpp>
-
-// POSIX headers for Shared Memory
-#include <fcntl.h>
-#include <sys/mman.h>
-#include <sys/stat.h>
-#include <unistd.h>
+#include <zmq_addon.hpp>
 
 #include <boost/program_options.hpp>
 #include <uhd/convert.hpp>
@@ -17,6 +19,13 @@
 #include <uhd/usrp/multi_usrp.hpp>
 #include <uhd/utils/safe_main.hpp>
 
+#include "burst_executor.h"
+#include "rx_publisher.h"
+#include "sample_arena.h"
+#include "shm_segment.h"
+#include "sim_streamer.h"
+#include "stream_metrics.h"
+#include "thread_utils.h"
 #include "usrp_protocol.pb.h"
 #include "usrp_transceiver.h"
 
@@ -30,150 +39,395 @@ void sig_int_handler(int) {
     UHD_LOG_INFO("SIGNAL", "SIGINT received, stopping...")
 }
 
-// 辅助函数：将 Protobuf 配置转换为原生结构体
-UsrpConfig ConvertConfig(const usrp_proto::UsrpConfig &proto_cfg) {
-    UsrpConfig c;
-    c.clock_source = proto_cfg.clock_source();
-    c.time_source = proto_cfg.time_source();
-    c.spb = proto_cfg.spb();
-    c.delay = proto_cfg.delay();
-    c.rx_samps = proto_cfg.rx_samps();
-    c.tx_samps = proto_cfg.tx_samps();
-
-    c.tx_channels.assign(proto_cfg.tx_channels().begin(), proto_cfg.tx_channels().end());
-    c.rx_channels.assign(proto_cfg.rx_channels().begin(), proto_cfg.rx_channels().end());
-    c.tx_rates.assign(proto_cfg.tx_rates().begin(), proto_cfg.tx_rates().end());
-    c.rx_rates.assign(proto_cfg.rx_rates().begin(), proto_cfg.rx_rates().end());
-    c.tx_freqs.assign(proto_cfg.tx_freqs().begin(), proto_cfg.tx_freqs().end());
-    c.rx_freqs.assign(proto_cfg.rx_freqs().begin(), proto_cfg.rx_freqs().end());
-    c.tx_gains.assign(proto_cfg.tx_gains().begin(), proto_cfg.tx_gains().end());
-    c.rx_gains.assign(proto_cfg.rx_gains().begin(), proto_cfg.rx_gains().end());
-    c.tx_ants.assign(proto_cfg.tx_ants().begin(), proto_cfg.tx_ants().end());
-    c.rx_ants.assign(proto_cfg.rx_ants().begin(), proto_cfg.rx_ants().end());
-
-
-    UHD_LOG_DEBUG("CONFIG", std::format("Converted Config - Clock: {}, Time: {}, SPB: {}, Delay: {}, RX Samps: {}, TX Samps: {}", c.clock_source, c.time_source,
-                                        c.spb, c.delay, c.rx_samps, c.tx_samps));
-
-    return c;
+void SendReply(zmq::socket_t &sock, const std::vector<string> &envelope, const usrp_proto::Response &reply_proto) {
+    string serialized_reply;
+    reply_proto.SerializeToString(&serialized_reply);
+    for (const auto &frame: envelope) {
+        sock.send(zmq::buffer(frame), zmq::send_flags::sndmore);
+    }
+    sock.send(zmq::buffer(serialized_reply), zmq::send_flags::none);
+}
+
+// 服务器自动创建的 RX 段池名称都以此开头，客户端命名的段不能使用
+const string kRxShmBase = "/usrp_rx_shm";
+// --sim 的段池使用单独的名称，不会覆盖同一主机上真实服务器的段
+const string kSimRxShmBase = "/usrp_sim_rx_shm";
+
+// 在后台线程中打开一台设备
+using DeviceFactory = std::function<std::unique_ptr<UsrpTransceiver>()>;
+
+// 一台独立的设备（一个 multi_usrp），有各自的 PUB 端口、RX 发布线程、任务队列和 RX 段池，
+// 不同设备的突发并行执行；只在请求循环中使用
+struct Device {
+    string name; // 请求中的 device 字段；空名称访问第一台设备
+    uint16_t pub_port;
+    zmq::socket_t pub_sock;
+    zmq::socket_t done_sock; // 任务完成通知（inproc PAIR）
+    string done_endpoint;
+    string rx_shm_base; // 段池名称前缀，客户端命名的段不能以此开头
+    std::future<std::unique_ptr<UsrpTransceiver>> bring_up;
+    std::unique_ptr<UsrpTransceiver> transceiver;
+    std::unique_ptr<RxPublisher> publisher;
+    std::unique_ptr<BurstExecutor> executor;
+    string bring_up_error;
+    std::shared_ptr<const ShmSegment> tx_shm; // 跨请求缓存的 TX 共享内存映射
+
+    // 端口先绑定，设备在后台打开（多主板时需要十几秒）
+    Device(zmq::context_t &ctx, string name, DeviceFactory open, string rx_shm_base, uint16_t pub_port, size_t index) :
+        name(std::move(name)), pub_port(pub_port), pub_sock(ctx, zmq::socket_type::pub), done_sock(ctx, zmq::socket_type::pair),
+        done_endpoint(std::format("inproc://burst-done-{}", index)), rx_shm_base(std::move(rx_shm_base)) {
+        pub_sock.bind(std::format("tcp://*:{}", pub_port));
+        done_sock.bind(done_endpoint);
+        bring_up = std::async(std::launch::async, std::move(open));
+    }
+
+    [[nodiscard]] bool Ready() const { return static_cast<bool>(executor); }
+
+    [[nodiscard]] string Label() const { return name.empty() ? "default" : name; }
+
+    // 设备打开后创建发布线程和任务队列，并在 PUB 端口上以 "status" 主题通知已就绪（或打开失败）
+    void CheckBringUp(zmq::context_t &ctx, size_t rx_pool_size, double burst_lead) {
+        if (not bring_up.valid() or bring_up.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return;
+        }
+        usrp_proto::Response ready;
+        try {
+            transceiver = bring_up.get();
+            publisher = std::make_unique<RxPublisher>(pub_sock, *transceiver);
+            const string rx_shm_name = name.empty() ? rx_shm_base : std::format("{}.{}", rx_shm_base, name);
+            executor = std::make_unique<BurstExecutor>(*transceiver, ctx, done_endpoint, rx_shm_name, rx_pool_size, burst_lead, stop_signal_called);
+            ready.set_status(usrp_proto::SUCCESS);
+            UHD_LOG_INFO("SERVER", std::format("Device {} ready", Label()));
+        } catch (const std::exception &e) {
+            bring_up_error = std::format("Device {} bring-up failed: {}", Label(), e.what());
+            ready.set_status(usrp_proto::ERROR);
+            ready.set_msg(bring_up_error);
+            UHD_LOG_ERROR("SERVER", bring_up_error);
+        }
+        ready.set_ready(Ready());
+        string serialized;
+        ready.SerializeToString(&serialized);
+        pub_sock.send(zmq::str_buffer("status"), zmq::send_flags::sndmore);
+        pub_sock.send(zmq::buffer(serialized), zmq::send_flags::none);
+    }
+
+    // 转发已完成的任务：在 PUB 端口上以 "job" 主题通知，并回复仍在等待的 EXECUTE 客户端
+    // 只在请求循环中使用 pub_sock；任务和 RX 流互斥，所以不会与发布线程冲突
+    void ForwardDone(zmq::socket_t &sock) {
+        std::vector<zmq::message_t> done;
+        while (zmq::recv_multipart(done_sock, std::back_inserter(done), zmq::recv_flags::dontwait)) {
+            zmq::message_t notification;
+            notification.copy(done.back());
+            pub_sock.send(zmq::str_buffer("job"), zmq::send_flags::sndmore);
+            pub_sock.send(notification, zmq::send_flags::none);
+            if (done.size() > 1) {
+                zmq::send_multipart(sock, done);
+            }
+            done.clear();
+        }
+    }
+};
+
+// 设备启动以来的累计流指标，按设备名称和方向标注
+std::vector<LabeledMetrics> DeviceMetrics(const Device &device) {
+    return {{device.Label(), "tx", device.transceiver->TxMetrics()}, {device.Label(), "rx", device.transceiver->RxMetrics()}};
+}
+
+// --metrics-port：ZMQ_STREAM 套接字上的最简 HTTP 服务，GET /metrics 返回所有已就绪设备的 Prometheus 指标
+// 每个请求回复一次后关闭连接；指标读取不加锁，不影响正在进行的突发
+void ServeMetrics(zmq::socket_t &metrics_sock, const std::vector<std::unique_ptr<Device>> &devices) {
+    std::vector<zmq::message_t> frames;
+    while (zmq::recv_multipart(metrics_sock, std::back_inserter(frames), zmq::recv_flags::dontwait)) {
+        // [连接 ID, 数据]，空数据帧表示连接建立或断开
+        if (frames.size() == 2 and frames[1].size() > 0) {
+            string status = "200 OK";
+            string body;
+            if (frames[1].to_string().starts_with("GET /metrics")) {
+                std::vector<LabeledMetrics> sources;
+                for (const auto &device: devices) {
+                    if (device->Ready()) {
+                        std::ranges::move(DeviceMetrics(*device), std::back_inserter(sources));
+                    }
+                }
+                body = FormatPrometheus(sources);
+            } else {
+                status = "404 Not Found";
+                body = "Not found\n";
+            }
+            const string response = std::format("HTTP/1.0 {}\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: {}\r\nConnection: close\r\n\r\n{}",
+                                                status, body.size(), body);
+            metrics_sock.send(zmq::buffer(frames[0].data(), frames[0].size()), zmq::send_flags::sndmore);
+            metrics_sock.send(zmq::buffer(response), zmq::send_flags::none);
+            // 连接 ID 后跟空帧表示关闭连接
+            metrics_sock.send(zmq::buffer(frames[0].data(), frames[0].size()), zmq::send_flags::sndmore);
+            metrics_sock.send(zmq::message_t(), zmq::send_flags::none);
+        }
+        frames.clear();
+    }
+}
+
+// 设备名称出现在段名中，只允许字母、数字和 -
+bool ValidDeviceName(const string &name) {
+    return not name.empty() and std::ranges::all_of(name, [](char c) { return std::isalnum(static_cast<unsigned char>(c)) or c == '-'; });
 }
 
 int UHD_SAFE_MAIN(int argc, char *argv[]) {
     GOOGLE_PROTOBUF_VERIFY_VERSION;
 
     string args;
-    uint16_t port;
+    std::vector<string> device_specs;
+    uint16_t port, pub_port, metrics_port;
+    size_t default_block_samps, stream_blocks;
+    UsrpConfig host_config{};
+    double burst_lead;
+    size_t rx_pool_size;
+    size_t arena_mb;
+    size_t sim_channels, sim_packet_samps;
+    double sim_rate;
 
     po::options_description desc("Command line options");
     desc.add_options()("help,h", "Show help")("port", po::value<uint16_t>(&port)->default_value(5555))(
-            "args", po::value<string>(&args)->default_value("addr=192.168.10.101"));
+            "args", po::value<string>(&args)->default_value("addr=192.168.10.101"), "Address of the default device")(
+            "device", po::value<std::vector<string>>(&device_specs)->multitoken(),
+            "Additional independent devices as name=args (e.g. lab=addr=192.168.20.2); without an explicit --args the first one is the default")(
+            "pub-port", po::value<uint16_t>(&pub_port)->default_value(5556), "PUB port for continuous RX streaming (STREAM_START); further devices use the following ports")(
+            "block-samps", po::value<size_t>(&default_block_samps)->default_value(65536), "Default samples per channel in each published RX block")(
+            "stream-blocks", po::value<size_t>(&stream_blocks)->default_value(64), "RX blocks buffered between reception and publishing")(
+            "tx-cpus", po::value<std::vector<size_t>>(&host_config.tx_cpus)->multitoken(), "CPUs for the TX streaming thread")(
+            "rx-cpus", po::value<std::vector<size_t>>(&host_config.rx_cpus)->multitoken(), "CPUs for the RX streaming thread")(
+            "thread-priority", po::value<float>(&host_config.thread_priority)->default_value(0), "SCHED_FIFO priority of the streaming threads in (0, 1]; 0 = normal")(
+            "numa-node", po::value<int>(&host_config.numa_node)->default_value(-1), "NUMA node of the NIC for streaming threads and buffers (-1 = any)")(
+            "burst-lead", po::value<double>(&burst_lead)->default_value(0.05), "Minimum scheduling lead (s) for a queued burst that follows the previous one")(
+            "rx-pool", po::value<size_t>(&rx_pool_size)->default_value(2), "Number of shared RX result segments (/usrp_rx_shm, /usrp_rx_shm_1, ...)")(
+            "arena-mb", po::value<size_t>(&arena_mb)->default_value(0), "Huge-page sample arena (MiB) reserved and pre-faulted at startup for staged TX buffers (0 = heap)")(
+            "arena-lock", "mlock the sample arena")(
+            "metrics-port", po::value<uint16_t>(&metrics_port)->default_value(0), "HTTP port serving Prometheus stream metrics at /metrics (0 = off)")(
+            "sim", "Simulate every device instead of opening it (no radio needed, e.g. for txrx_bench and client tests); RX pool /usrp_sim_rx_shm")(
+            "sim-channels", po::value<size_t>(&sim_channels)->default_value(4), "TX and RX channels of each simulated device")(
+            "sim-rate", po::value<double>(&sim_rate)->default_value(10e6), "Sample rate of the simulated streamers (timestamps, and pacing with --sim-paced)")(
+            "sim-packet-samps", po::value<size_t>(&sim_packet_samps)->default_value(1996), "Samples per simulated packet (the streamers' max_num_samps)")(
+            "sim-paced", "Pace the simulated streamers at --sim-rate instead of running as fast as the host allows");
 
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, desc), vm);
     po::notify(vm);
 
     std::signal(SIGINT, &sig_int_handler);
-    UsrpTransceiver transceiver(args);
+
+    // 在打开设备之前预留并预先缺页，突发期间的缓冲区不再触发缺页；NUMA 节点先检查，越界的节点号无法放进节点掩码
+    if (host_config.numa_node < -1 or host_config.numa_node >= kMaxNumaNodes) {
+        UHD_LOG_ERROR("SERVER", std::format("Invalid --numa-node {}", host_config.numa_node));
+        return EXIT_FAILURE;
+    }
+    SampleArena::Instance().Configure(arena_mb << 20, vm.contains("arena-lock"), host_config.numa_node);
 
     zmq::context_t ctx{1};
-    zmq::socket_t sock{ctx, zmq::socket_type::rep};
+    // ROUTER：多个请求可以同时排队，回复按路由帧送回对应的客户端（兼容 REQ 客户端）
+    zmq::socket_t sock{ctx, zmq::socket_type::router};
     sock.bind(std::format("tcp://*:{}", port));
 
-    UHD_LOG_INFO("SERVER", std::format("ZMQ Server live on port {} (POSIX SHM Mode)", port));
+    // 每台设备一个 PUB 端口（--pub-port 起依次递增），按 --args、--device 的顺序
+    std::vector<std::pair<string, string>> named_args;
+    if (device_specs.empty() or not vm["args"].defaulted()) {
+        named_args.emplace_back("", args);
+    }
+    for (const auto &spec: device_specs) {
+        const auto separator = spec.find('=');
+        string name = spec.substr(0, separator);
+        if (separator == string::npos or not ValidDeviceName(name) or
+            std::ranges::find(named_args, name, &std::pair<string, string>::first) != named_args.end()) {
+            UHD_LOG_ERROR("SERVER", std::format("Invalid or duplicate --device {}, expected name=args with a unique name of letters, digits and -", spec));
+            return EXIT_FAILURE;
+        }
+        named_args.emplace_back(std::move(name), spec.substr(separator + 1));
+    }
+    // --sim：设备由模拟流对象代替（sim_streamer.h），设备参数只用于命名
+    const bool sim = vm.contains("sim");
+    const bool sim_paced = vm.contains("sim-paced");
+    if (sim and (sim_channels == 0 or sim_packet_samps == 0 or sim_rate <= 0)) {
+        UHD_LOG_ERROR("SERVER", "--sim needs channels, a packet size and a rate");
+        return EXIT_FAILURE;
+    }
+    auto device_factory = [&](const string &device_args) -> DeviceFactory {
+        if (not sim) {
+            return [device_args] { return std::make_unique<UsrpTransceiver>(device_args); };
+        }
+        return [=] {
+            return std::make_unique<UsrpTransceiver>(
+                    sim_channels, sim_channels,
+                    [=](const uhd::stream_args_t &stream_args) {
+                        return std::make_shared<SimTxStreamer>(stream_args.channels.size(), stream_args.cpu_format, sim_rate, sim_packet_samps, sim_paced);
+                    },
+                    [=](const uhd::stream_args_t &stream_args) {
+                        return std::make_shared<SimRxStreamer>(stream_args.channels.size(), stream_args.cpu_format, sim_rate, sim_packet_samps, sim_paced);
+                    });
+        };
+    };
+    std::vector<std::unique_ptr<Device>> devices;
+    for (const auto &[name, device_args]: named_args) {
+        const auto device_pub_port = static_cast<uint16_t>(pub_port + devices.size());
+        devices.push_back(std::make_unique<Device>(ctx, name, device_factory(device_args), sim ? kSimRxShmBase : kRxShmBase, device_pub_port, devices.size()));
+        UHD_LOG_INFO("SERVER", std::format("Opening {}device {} ({}), RX stream on port {}", sim ? "simulated " : "", devices.back()->Label(), device_args,
+                                           device_pub_port));
+    }
+    auto find_device = [&](const string &name) -> Device & {
+        if (name.empty()) {
+            return *devices.front();
+        }
+        auto it = std::ranges::find(devices, name, &Device::name);
+        if (it == devices.end()) {
+            throw std::runtime_error(std::format("Unknown device {}", name));
+        }
+        return **it;
+    };
+
+    UHD_LOG_INFO("SERVER", std::format("ZMQ Server live on port {} (POSIX SHM Mode), {} devices", port, devices.size()));
 
+    std::vector<zmq::pollitem_t> items = {{sock.handle(), 0, ZMQ_POLLIN, 0}};
+    for (const auto &device: devices) {
+        items.push_back({device->done_sock.handle(), 0, ZMQ_POLLIN, 0});
+    }
+    // 指标端口（可选）放在最后
+    std::optional<zmq::socket_t> metrics_sock;
+    if (metrics_port > 0) {
+        metrics_sock.emplace(ctx, zmq::socket_type::stream);
+        metrics_sock->bind(std::format("tcp://*:{}", metrics_port));
+        items.push_back({metrics_sock->handle(), 0, ZMQ_POLLIN, 0});
+        UHD_LOG_INFO("SERVER", std::format("Prometheus metrics on http://*:{}/metrics", metrics_port));
+    }
     while (not stop_signal_called) {
-        zmq::message_t request_msg;
-        if (auto res = sock.recv(request_msg, zmq::recv_flags::none); !res || request_msg.size() == 0)
+        // 定时返回以检查 SIGINT
+        zmq::poll(items, std::chrono::milliseconds(200));
+
+        for (size_t i = 0; i < devices.size(); ++i) {
+            devices[i]->CheckBringUp(ctx, rx_pool_size, burst_lead);
+            if (items[i + 1].revents & ZMQ_POLLIN) {
+                devices[i]->ForwardDone(sock);
+            }
+        }
+        if (metrics_sock and (items.back().revents & ZMQ_POLLIN)) {
+            ServeMetrics(*metrics_sock, devices);
+        }
+
+        if (not(items[0].revents & ZMQ_POLLIN))
             continue;
 
+        // 最后一帧是请求，前面是路由帧（REQ 客户端还带一个空分隔帧）
+        std::vector<zmq::message_t> frames;
+        if (auto res = zmq::recv_multipart(sock, std::back_inserter(frames)); !res || frames.size() < 2)
+            continue;
+        std::vector<string> envelope;
+        for (size_t i = 0; i + 1 < frames.size(); ++i)
+            envelope.push_back(frames[i].to_string());
+        const zmq::message_t &request_msg = frames.back();
+
         usrp_proto::Request req_proto;
         usrp_proto::Response reply_proto;
         reply_proto.set_status(usrp_proto::STATUS_UNKNOWN);
 
-        if (!req_proto.ParseFromArray(request_msg.data(), request_msg.size())) {
-            UHD_LOG_ERROR("SERVER", "Protobuf parse error");
-            continue;
-        }
-
         try {
-            if (req_proto.cmd() == usrp_proto::EXECUTE) {
-                UsrpConfig config = ConvertConfig(req_proto.config());
-                string tx_shm_name = req_proto.tx_shm_name();
-
-                if (!transceiver.ValidateConfiguration(config, false)) {
-                    throw std::runtime_error("Configuration validation failed");
-                }
-                transceiver.ApplyConfiguration(config, stop_signal_called);
+            if (!req_proto.ParseFromArray(request_msg.data(), request_msg.size())) {
+                throw std::runtime_error("Protobuf parse error");
+            }
 
-                // --- 1. 使用 POSIX 接口打开 TX 共享内存 ---
-                UHD_LOG_INFO("SERVER", std::format("Opening TX SHM: {}", tx_shm_name));
-                int tx_fd = shm_open(tx_shm_name.c_str(), O_RDONLY, 0666);
-                if (tx_fd == -1)
-                    throw std::runtime_error(std::format("shm_open TX failed: {}", strerror(errno)));
+            Device &device = find_device(req_proto.device());
+            if (req_proto.cmd() == usrp_proto::PING) {
+                reply_proto.set_status(usrp_proto::SUCCESS);
+                reply_proto.set_ready(device.Ready());
+                reply_proto.set_msg(device.bring_up_error);
 
-                struct stat tx_st;
-                fstat(tx_fd, &tx_st);
+            } else if (not device.Ready()) {
+                reply_proto.set_status(usrp_proto::NOT_READY);
+                reply_proto.set_msg(device.bring_up_error.empty() ? "Device is starting up" : device.bring_up_error);
 
-                void *tx_ptr = mmap(nullptr, tx_st.st_size, PROT_READ, MAP_SHARED, tx_fd, 0);
-                if (tx_ptr == MAP_FAILED) {
-                    close(tx_fd);
-                    throw std::runtime_error("mmap TX failed");
+            } else if (req_proto.cmd() == usrp_proto::EXECUTE or req_proto.cmd() == usrp_proto::SUBMIT) {
+                if (device.publisher->Running()) {
+                    throw std::runtime_error("RX stream is running, send STREAM_STOP first");
                 }
-
-                // 拆分通道数据
-                size_t num_tx_ch = config.tx_channels.size();
-                // size_t samps_per_ch = tx_st.st_size / (num_tx_ch * sizeof(complexf));
-                std::vector<std::vector<complexf>> tx_buffs(num_tx_ch, std::vector<complexf>(config.tx_samps));
-                complexf *raw_tx_ptr = static_cast<complexf *>(tx_ptr);
-
-                for (size_t i = 0; i < num_tx_ch; ++i) {
-                    std::copy(raw_tx_ptr + (i * config.tx_samps), raw_tx_ptr + ((i + 1) * config.tx_samps), tx_buffs[i].data());
+                if (not req_proto.rx_shm_name().empty() and
+                    (req_proto.rx_shm_name().starts_with(device.rx_shm_base) or not device.executor->ValidRxName(req_proto.rx_shm_name()))) {
+                    throw std::runtime_error(std::format("Invalid RX segment name: {}", req_proto.rx_shm_name()));
                 }
+                BurstJob job = StageBurst(req_proto, host_config, *device.transceiver, device.tx_shm);
+                job.client = envelope.front();
+                job.rx_shm_name = req_proto.rx_shm_name();
+                if (req_proto.cmd() == usrp_proto::EXECUTE) {
+                    // 回复在突发完成后由工作线程发出
+                    job.envelope = std::move(envelope);
+                    device.executor->Submit(std::move(job));
+                    continue;
+                }
+                // SUBMIT：立即返回 job_id，完成时通过 PUB 通知或 STATUS 查询
+                reply_proto = device.executor->Status(device.executor->Submit(std::move(job)));
 
-                // 拷贝完后即可解除映射
-                munmap(tx_ptr, tx_st.st_size);
-                close(tx_fd);
-
-                // --- 2. 执行收发 ---
-
-                transceiver.CalculateTransmissionTime(); // 计算收发流的传输开始时间
-                auto tx_thread =
-                        std::async(std::launch::async, &UsrpTransceiver::TransmitFromBuffer, &transceiver, std::ref(tx_buffs), std::ref(stop_signal_called));
-                auto rx_future = std::async(std::launch::async, &UsrpTransceiver::ReceiveToBuffer, &transceiver, std::ref(stop_signal_called));
-
-                tx_thread.wait();
-                auto rx_buffs = rx_future.get();
-
-                // --- 3. 使用 POSIX 接口创建 RX 共享内存 ---
-                string rx_shm_name = "/usrp_rx_shm";
-                shm_unlink(rx_shm_name.c_str()); // 确保干净
-
-                size_t num_rx_ch = rx_buffs.size();
-                size_t rx_samps_per_ch = rx_buffs[0].size();
-                size_t total_rx_bytes = num_rx_ch * rx_samps_per_ch * sizeof(complexf);
+            } else if (req_proto.cmd() == usrp_proto::STATUS) {
+                reply_proto = device.executor->Status(req_proto.job_id());
 
-                int rx_fd = shm_open(rx_shm_name.c_str(), O_CREAT | O_RDWR, 0666);
-                if (rx_fd == -1)
-                    throw std::runtime_error("shm_open RX failed");
-                ftruncate(rx_fd, total_rx_bytes);
+            } else if (req_proto.cmd() == usrp_proto::STATS) {
+                // 累计指标只读原子计数，不需要等设备空闲
+                SetStreamMetrics(*reply_proto.mutable_tx_metrics(), device.transceiver->TxMetrics());
+                SetStreamMetrics(*reply_proto.mutable_rx_metrics(), device.transceiver->RxMetrics());
+                reply_proto.set_prometheus(FormatPrometheus(DeviceMetrics(device)));
+                reply_proto.set_status(usrp_proto::SUCCESS);
 
-                void *rx_ptr = mmap(nullptr, total_rx_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, rx_fd, 0);
-                complexf *raw_rx_ptr = static_cast<complexf *>(rx_ptr);
+            } else if (req_proto.cmd() == usrp_proto::CANCEL) {
+                std::vector<string> waiting;
+                auto state = device.executor->Cancel(req_proto.job_id(), waiting);
+                if (state == usrp_proto::JOB_UNKNOWN) {
+                    throw std::runtime_error(std::format("Unknown job {}", req_proto.job_id()));
+                }
+                if (state == usrp_proto::JOB_CANCELLED) {
+                    // 被取消任务的结果也要通知，并回复仍在等待的 EXECUTE 客户端
+                    usrp_proto::Response cancelled = device.executor->Status(req_proto.job_id());
+                    string serialized;
+                    cancelled.SerializeToString(&serialized);
+                    device.pub_sock.send(zmq::str_buffer("job"), zmq::send_flags::sndmore);
+                    device.pub_sock.send(zmq::buffer(serialized), zmq::send_flags::none);
+                    if (not waiting.empty()) {
+                        SendReply(sock, waiting, cancelled);
+                    }
+                }
+                reply_proto.set_status(state == usrp_proto::JOB_CANCELLED or state == usrp_proto::JOB_RUNNING ? usrp_proto::SUCCESS : usrp_proto::FAILED);
+                reply_proto.set_job_id(req_proto.job_id());
+                reply_proto.set_job_state(state);
 
-                for (size_t i = 0; i < num_rx_ch; ++i) {
-                    std::copy(rx_buffs[i].begin(), rx_buffs[i].end(), raw_rx_ptr + i * rx_samps_per_ch);
+            } else if (req_proto.cmd() == usrp_proto::STREAM_START) {
+                if (device.publisher->Running()) {
+                    throw std::runtime_error("RX stream already running");
                 }
+                if (not device.executor->Idle()) {
+                    throw std::runtime_error("Bursts are queued or running");
+                }
+                // 空闲时所有完成通知都已在 PAIR 中，先发完再把 pub_sock 交给发布线程
+                device.ForwardDone(sock);
+                // rx_samps = 0 表示一直接收直到 STREAM_STOP
+                UsrpConfig config = ConvertConfig(req_proto.config(), host_config);
+                if (!device.transceiver->ValidateConfiguration(config, false) or config.rx_channels.empty()) {
+                    throw std::runtime_error("Configuration validation failed");
+                }
+                const auto config_start = std::chrono::steady_clock::now();
+                device.transceiver->ApplyConfiguration(config, stop_signal_called);
+                const std::chrono::duration<double> config_time = std::chrono::steady_clock::now() - config_start;
+                device.transceiver->CalculateTransmissionTime();
 
-                munmap(rx_ptr, total_rx_bytes);
-                close(rx_fd);
+                size_t block_samps = req_proto.block_samps() > 0 ? req_proto.block_samps() : default_block_samps;
+                device.publisher->Start(config.rx_channels.size(), config.cpu_format, block_samps, stream_blocks, config.numa_node);
 
                 reply_proto.set_status(usrp_proto::SUCCESS);
-                reply_proto.set_rx_shm_name(rx_shm_name);
-                reply_proto.set_rx_nsamps_per_ch(rx_samps_per_ch);
-                reply_proto.set_num_rx_ch(num_rx_ch);
+                reply_proto.set_pub_port(device.pub_port);
+                reply_proto.set_config_time(config_time.count());
+                reply_proto.set_num_rx_ch(config.rx_channels.size());
+                reply_proto.set_cpu_format(config.cpu_format);
+
+            } else if (req_proto.cmd() == usrp_proto::STREAM_STOP) {
+                reply_proto.set_stream_blocks(device.publisher->Stop());
+                reply_proto.set_stream_overflows(device.publisher->Overflows());
+                SetStreamStats(reply_proto, device.transceiver->Stats());
+                reply_proto.set_status(usrp_proto::SUCCESS);
 
             } else if (req_proto.cmd() == usrp_proto::RELEASE) {
-                shm_unlink("/usrp_rx_shm");
+                // 段池中的段变为空闲，可供下一次接收复用；客户端命名的段被删除
+                reply_proto.set_released(device.executor->Release(req_proto.rx_shm_name(), envelope.front()));
                 reply_proto.set_status(usrp_proto::RELEASED);
             }
         } catch (const std::exception &e) {
@@ -182,11 +436,11 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
             UHD_LOG_ERROR("SERVER", std::format("Exception: {}", e.what()));
         }
 
-        string serialized_reply;
-        reply_proto.SerializeToString(&serialized_reply);
-        sock.send(zmq::buffer(serialized_reply), zmq::send_flags::none);
+        SendReply(sock, envelope, reply_proto);
     }
 
+    // 先销毁设备：等待执行线程和发布线程结束，它们还会构造 protobuf 消息
+    devices.clear();
     google::protobuf::ShutdownProtobufLibrary();
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,137 @@
+#include "shm_segment.h"
+
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <uhd/utils/log.hpp>
+
+#include "thread_utils.h"
+
+using std::format;
+using std::string;
+
+ShmSegment::~ShmSegment() { Reset(); }
+
+ShmSegment::ShmSegment(ShmSegment &&other) noexcept :
+    shm_name(std::move(other.shm_name)), fd(std::exchange(other.fd, -1)), ptr(std::exchange(other.ptr, nullptr)), bytes(std::exchange(other.bytes, 0)),
+    dev(other.dev), ino(other.ino), owner(std::exchange(other.owner, false)), numa_node(other.numa_node) {}
+
+ShmSegment &ShmSegment::operator=(ShmSegment &&other) noexcept {
+    if (this != &other) {
+        Reset();
+        shm_name = std::move(other.shm_name);
+        fd = std::exchange(other.fd, -1);
+        ptr = std::exchange(other.ptr, nullptr);
+        bytes = std::exchange(other.bytes, 0);
+        dev = other.dev;
+        ino = other.ino;
+        owner = std::exchange(other.owner, false);
+        numa_node = other.numa_node;
+    }
+    return *this;
+}
+
+ShmSegment ShmSegment::Open(const string &name) {
+    ShmSegment seg;
+    seg.shm_name = name;
+    seg.fd = shm_open(name.c_str(), O_RDONLY, 0666);
+    if (seg.fd == -1)
+        throw std::runtime_error(format("shm_open {} failed: {}", name, strerror(errno)));
+
+    struct stat st;
+    if (fstat(seg.fd, &st) == -1)
+        throw std::runtime_error(format("fstat {} failed: {}", name, strerror(errno)));
+    seg.bytes = st.st_size;
+    seg.dev = st.st_dev;
+    seg.ino = st.st_ino;
+    seg.Map();
+
+    UHD_LOG_DEBUG("SHM", format("Mapped {} ({} bytes, read-only)", name, seg.bytes));
+    return seg;
+}
+
+ShmSegment ShmSegment::Create(const string &name, const size_t size, const int numa_node) {
+    shm_unlink(name.c_str());
+
+    ShmSegment seg;
+    seg.shm_name = name;
+    seg.owner = true;
+    seg.numa_node = numa_node;
+    seg.fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0666);
+    if (seg.fd == -1)
+        throw std::runtime_error(format("shm_open {} failed: {}", name, strerror(errno)));
+
+    struct stat st;
+    if (fstat(seg.fd, &st) == -1)
+        throw std::runtime_error(format("fstat {} failed: {}", name, strerror(errno)));
+    seg.dev = st.st_dev;
+    seg.ino = st.st_ino;
+    seg.Resize(size);
+
+    UHD_LOG_DEBUG("SHM", format("Created {} ({} bytes)", name, seg.bytes));
+    return seg;
+}
+
+bool ShmSegment::IsCurrent(const string &name) const {
+    if (not valid() or name != shm_name)
+        return false;
+
+    int probe = shm_open(name.c_str(), O_RDONLY, 0666);
+    if (probe == -1)
+        return false;
+    struct stat st;
+    bool same = fstat(probe, &st) == 0 and st.st_dev == dev and st.st_ino == ino and static_cast<size_t>(st.st_size) == bytes;
+    close(probe);
+    return same;
+}
+
+void ShmSegment::Resize(const size_t size) {
+    if (not owner)
+        throw std::runtime_error(format("Cannot resize {}: not owned by this process", shm_name));
+
+    if (ptr) {
+        munmap(ptr, bytes);
+        ptr = nullptr;
+    }
+    if (ftruncate(fd, size) == -1)
+        throw std::runtime_error(format("ftruncate {} failed: {}", shm_name, strerror(errno)));
+    bytes = size;
+    Map();
+}
+
+void ShmSegment::Map() {
+    if (bytes == 0)
+        return;
+
+    int prot = owner ? PROT_READ | PROT_WRITE : PROT_READ;
+    // MAP_POPULATE: fault the pages in now (while staging) rather than inside the streaming loop
+    void *p = mmap(nullptr, bytes, prot, MAP_SHARED | MAP_POPULATE, fd, 0);
+    if (p == MAP_FAILED)
+        throw std::runtime_error(format("mmap {} failed: {}", shm_name, strerror(errno)));
+    ptr = p;
+    if (owner) {
+        // Pages of a resized segment already hold samples, so they are migrated rather than dropped
+        BindToNumaNode(ptr, bytes, numa_node);
+    }
+}
+
+void ShmSegment::Reset() noexcept {
+    if (ptr)
+        munmap(ptr, bytes);
+    if (fd != -1)
+        close(fd);
+    if (owner)
+        shm_unlink(shm_name.c_str());
+    ptr = nullptr;
+    fd = -1;
+    bytes = 0;
+    owner = false;
+}
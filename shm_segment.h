@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <sys/types.h>
+
+/**
+ * A POSIX shared memory segment mapped into this process
+ *
+ * Segments opened with Open() belong to the client and are mapped read-only; segments
+ * created with Create() belong to the server, are mapped read-write and are unlinked
+ * when the object is destroyed. The mapping stays valid for the lifetime of the object
+ * so it can be reused across requests.
+ */
+class ShmSegment {
+public:
+    ShmSegment() = default;
+
+    ~ShmSegment();
+
+    ShmSegment(const ShmSegment &) = delete;
+
+    ShmSegment &operator=(const ShmSegment &) = delete;
+
+    ShmSegment(ShmSegment &&other) noexcept;
+
+    ShmSegment &operator=(ShmSegment &&other) noexcept;
+
+    /**
+     * Opens and maps an existing segment read-only
+     *
+     * The mapping is pre-faulted, so TX never takes a page fault on it.
+     *
+     * @param name POSIX shared memory name (with leading '/')
+     */
+    static ShmSegment Open(const std::string &name);
+
+    /**
+     * Creates (or replaces) a segment owned by this process and maps it read-write
+     *
+     * The mapping is pre-faulted so no page faults happen while streaming into it.
+     *
+     * @param name POSIX shared memory name (with leading '/')
+     * @param size Segment size in bytes
+     * @param numa_node NUMA node to place the segment on; -1 leaves placement to the kernel
+     */
+    static ShmSegment Create(const std::string &name, size_t size, int numa_node = -1);
+
+    /**
+     * Checks whether name still refers to the object that is mapped here, with the same size
+     *
+     * Clients usually unlink and recreate their segment for every request, so comparing
+     * the name alone is not enough.
+     */
+    [[nodiscard]] bool IsCurrent(const std::string &name) const;
+
+    /**
+     * Changes the size of an owned segment and remaps it
+     */
+    void Resize(size_t size);
+
+    [[nodiscard]] void *data() const { return ptr; }
+
+    [[nodiscard]] size_t size() const { return bytes; }
+
+    [[nodiscard]] const std::string &name() const { return shm_name; }
+
+    [[nodiscard]] bool valid() const { return fd != -1; }
+
+private:
+    std::string shm_name;
+    int fd{-1};
+    void *ptr{nullptr};
+    size_t bytes{0};
+    dev_t dev{0};
+    ino_t ino{0};
+    bool owner{false};
+    int numa_node{-1};
+
+    void Map();
+
+    void Reset() noexcept;
+};
@@ -0,0 +1,194 @@
+#include "sigmf_meta.h"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using std::format;
+using std::string;
+using std::vector;
+
+namespace {
+    static_assert(std::endian::native == std::endian::little, "The index records are written in host byte order");
+
+    // SigMF name of a CPU format
+    string SigmfDatatype(const string &cpu_format) {
+        if (cpu_format == "fc32")
+            return "cf32_le";
+        if (cpu_format == "sc16")
+            return "ci16_le";
+        if (cpu_format == "sc8")
+            return "ci8";
+        throw std::invalid_argument(format("No SigMF datatype for CPU format {}", cpu_format));
+    }
+
+    string JsonString(const string &value) {
+        string quoted = "\"";
+        for (char c: value) {
+            switch (c) {
+                case '"':
+                    quoted += "\\\"";
+                    break;
+                case '\\':
+                    quoted += "\\\\";
+                    break;
+                case '\n':
+                    quoted += "\\n";
+                    break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        quoted += format("\\u{:04x}", c);
+                    } else {
+                        quoted += c;
+                    }
+            }
+        }
+        return quoted + "\"";
+    }
+
+    string FileName(const string &path) { return std::filesystem::path(path).filename().string(); }
+
+    // Value for channel i of a per-channel setting, repeating the last one
+    template <typename T>
+    T ChannelValue(const vector<T> &values, size_t i, T fallback) {
+        if (values.empty())
+            return fallback;
+        return values[std::min(i, values.size() - 1)];
+    }
+
+    void WriteAll(int fd, const char *data, size_t bytes, const string &name) {
+        while (bytes > 0) {
+            ssize_t written = write(fd, data, bytes);
+            if (written < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw std::runtime_error(format("Write to {} failed: {}", name, strerror(errno)));
+            }
+            data += written;
+            bytes -= written;
+        }
+    }
+} // namespace
+
+vector<SigmfChannel> SigmfChannels(const UsrpConfig &config) {
+    vector<SigmfChannel> channels;
+    const size_t decimation = std::max<size_t>(config.rx_decimation, 1);
+    for (size_t i = 0; i < config.rx_files.size(); ++i) {
+        SigmfChannel channel;
+        channel.data_file = config.rx_files[i];
+        channel.cpu_format = config.cpu_format;
+        channel.sample_rate = ChannelValue(config.rx_rates, i, 0.0) / decimation;
+        channel.frequency = ChannelValue(config.rx_freqs, i, 0.0);
+        if (decimation > 1) {
+            // The host mixer moves the band at rx_mix_freqs to DC
+            channel.frequency += ChannelValue(config.rx_mix_freqs, i, 0.0);
+        }
+        channel.gain = ChannelValue(config.rx_gains, i, 0.0);
+        channel.antenna = ChannelValue(config.rx_ants, i, string());
+        channel.channel = ChannelValue(config.rx_channels, i, size_t{0});
+        channels.push_back(std::move(channel));
+    }
+    return channels;
+}
+
+vector<SigmfAnnotation> GapAnnotations(const vector<RxGap> &gaps, bool zero_filled) {
+    vector<SigmfAnnotation> annotations;
+    for (const auto &gap: gaps) {
+        annotations.push_back({gap.offset, zero_filled ? gap.nsamps : 0, zero_filled ? 0 : gap.nsamps, "overflow"});
+    }
+    return annotations;
+}
+
+void WriteSigmfMeta(const SigmfChannel &channel, const vector<SigmfCapture> &captures, vector<SigmfAnnotation> annotations, const string &index_file) {
+    const string meta_file = channel.data_file + ".sigmf-meta";
+    const string temp_file = meta_file + ".tmp";
+
+    std::ofstream out(temp_file);
+    if (not out.is_open()) {
+        throw std::runtime_error(format("Cannot open metadata file: {}", temp_file));
+    }
+
+    out << "{\n  \"global\": {\n";
+    out << format("    \"core:datatype\": \"{}\",\n", SigmfDatatype(channel.cpu_format));
+    out << format("    \"core:sample_rate\": {},\n", channel.sample_rate);
+    out << "    \"core:version\": \"1.0.0\",\n";
+    out << "    \"core:num_channels\": 1,\n";
+    out << format("    \"core:dataset\": {},\n", JsonString(FileName(channel.data_file)));
+    out << "    \"core:recorder\": \"txrx\",\n";
+    out << "    \"core:extensions\": [{\"name\": \"txrx\", \"version\": \"1.0.0\", \"optional\": true}],\n";
+    if (not index_file.empty()) {
+        out << format("    \"txrx:index\": {},\n", JsonString(FileName(index_file)));
+    }
+    out << format("    \"txrx:channel\": {},\n", channel.channel);
+    out << format("    \"txrx:antenna\": {},\n", JsonString(channel.antenna));
+    out << format("    \"txrx:gain\": {}\n", channel.gain);
+    out << "  },\n";
+
+    out << "  \"captures\": [";
+    for (size_t i = 0; i < captures.size(); ++i) {
+        const auto &capture = captures[i];
+        out << format("{}\n    {{\"core:sample_start\": {}, \"core:frequency\": {}, \"txrx:time_full\": {}, \"txrx:time_frac\": {}}}", i > 0 ? "," : "",
+                      capture.sample_start, channel.frequency, capture.time_spec.get_full_secs(), capture.time_spec.get_frac_secs());
+    }
+    out << "\n  ],\n";
+
+    // SigMF wants annotations ordered by sample_start
+    std::ranges::stable_sort(annotations, {}, &SigmfAnnotation::sample_start);
+    out << "  \"annotations\": [";
+    for (size_t i = 0; i < annotations.size(); ++i) {
+        const auto &annotation = annotations[i];
+        out << format("{}\n    {{\"core:sample_start\": {}, \"core:sample_count\": {}, \"core:label\": {}, \"txrx:lost_samples\": {}}}", i > 0 ? "," : "",
+                      annotation.sample_start, annotation.sample_count, JsonString(annotation.label), annotation.lost_samples);
+    }
+    out << "\n  ]\n}\n";
+
+    out.close();
+    if (out.fail()) {
+        throw std::runtime_error(format("Write to {} failed", temp_file));
+    }
+    if (std::rename(temp_file.c_str(), meta_file.c_str()) != 0) {
+        throw std::runtime_error(format("Cannot replace {}: {}", meta_file, strerror(errno)));
+    }
+}
+
+SigmfIndex::SigmfIndex(const string &file, double sample_rate, size_t block_samps) : file_name(file) {
+    fd = open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        throw std::runtime_error(format("Cannot open index file {}: {}", file_name, strerror(errno)));
+    }
+
+    char header[kHeaderSize] = "TXRXIDX1";
+    const uint64_t fields[] = {std::bit_cast<uint64_t>(sample_rate), block_samps, kRecordSize};
+    std::memcpy(header + 8, fields, sizeof(fields));
+    try {
+        WriteAll(fd, header, sizeof(header), file_name);
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+}
+
+SigmfIndex::~SigmfIndex() {
+    if (fd != -1) {
+        close(fd);
+    }
+}
+
+void SigmfIndex::Append(uint64_t sample_offset, uint64_t nsamps, const uhd::time_spec_t &time_spec) {
+    char record[kRecordSize];
+    const int64_t full_secs = time_spec.get_full_secs();
+    const double frac_secs = time_spec.get_frac_secs();
+    std::memcpy(record, &sample_offset, 8);
+    std::memcpy(record + 8, &nsamps, 8);
+    std::memcpy(record + 16, &full_secs, 8);
+    std::memcpy(record + 24, &frac_secs, 8);
+    WriteAll(fd, record, sizeof(record), file_name);
+}
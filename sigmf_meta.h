@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <uhd/types/time_spec.hpp>
+#include <vector>
+
+#include "usrp_transceiver.h"
+
+/**
+ * What the SigMF metadata of one RX file says about its channel
+ */
+struct SigmfChannel {
+    std::string data_file;
+    std::string cpu_format; // Sample format of the file (fc32, sc16 or sc8)
+    double sample_rate{0}; // Rate of the samples in the file, after host decimation
+    double frequency{0}; // Center frequency of the samples in the file, after the host mixer
+    double gain{0}; // RX gain in dB
+    std::string antenna;
+    size_t channel{0}; // Device channel
+};
+
+/**
+ * A run of samples recorded without a break in device time
+ */
+struct SigmfCapture {
+    uint64_t sample_start{0}; // First sample of the run in the file
+    uhd::time_spec_t time_spec; // Device time of that sample
+};
+
+/**
+ * A stretch of the file where samples were lost
+ */
+struct SigmfAnnotation {
+    uint64_t sample_start{0}; // File sample at which the loss is
+    uint64_t sample_count{0}; // Zeros in the file standing in for the lost samples (0 when the data was packed)
+    uint64_t lost_samples{0}; // Samples per channel that never reached the file
+    std::string label; // "overflow" (device) or "dropped" (recorder fell behind)
+};
+
+/**
+ * Describes the RX channels of a configuration, one entry per rx_files entry
+ *
+ * Uses the requested rates, frequencies and gains; per-channel vectors shorter than
+ * rx_files repeat their last value.
+ */
+std::vector<SigmfChannel> SigmfChannels(const UsrpConfig &config);
+
+/**
+ * Maps gaps in stream positions (RxGap) to annotations of the file
+ *
+ * @param zero_filled The lost samples were zero-filled in the file (UsrpConfig::rx_fill_gaps)
+ */
+std::vector<SigmfAnnotation> GapAnnotations(const std::vector<RxGap> &gaps, bool zero_filled);
+
+/**
+ * Writes <data_file>.sigmf-meta, replacing the previous one atomically
+ *
+ * The metadata follows SigMF 1.0 (core:dataset names the data file, whose name does not
+ * follow the .sigmf-data convention); the fields SigMF has no core name for are in the
+ * "txrx" extension namespace, including device times as txrx:time_full / txrx:time_frac.
+ *
+ * @param index_file Block index written next to the data file (SigmfIndex); empty for none
+ */
+void WriteSigmfMeta(const SigmfChannel &channel, const std::vector<SigmfCapture> &captures, std::vector<SigmfAnnotation> annotations,
+                    const std::string &index_file = "");
+
+/**
+ * Append-only block index of a recording, for seeking by device time without reading the samples
+ *
+ * The file starts with a 32-byte header ("TXRXIDX1", sample rate as a double, samples per
+ * block, record size), followed by one 32-byte little-endian record per block written:
+ * file sample offset, samples, and the device time of the first sample as full seconds
+ * (int64) and fractional seconds (double). Every block but the last holds block_samps
+ * samples, so the record for a time t is found directly at (t - t0) * rate / block_samps,
+ * exact unless blocks were dropped before t (then the file holds fewer samples and the
+ * record is at or a few before that index).
+ */
+class SigmfIndex {
+public:
+    static constexpr size_t kHeaderSize = 32;
+    static constexpr size_t kRecordSize = 32;
+
+    SigmfIndex(const std::string &file, double sample_rate, size_t block_samps);
+
+    ~SigmfIndex();
+
+    SigmfIndex(const SigmfIndex &) = delete;
+
+    SigmfIndex &operator=(const SigmfIndex &) = delete;
+
+    void Append(uint64_t sample_offset, uint64_t nsamps, const uhd::time_spec_t &time_spec);
+
+    [[nodiscard]] const std::string &FileName() const { return file_name; }
+
+private:
+    std::string file_name;
+    int fd{-1};
+};
@@ -0,0 +1,117 @@
+#include "sim_streamer.h"
+
+#include <algorithm>
+#include <complex>
+#include <cstring>
+#include <numbers>
+#include <thread>
+
+#include "dsp_kernels.h"
+#include "usrp_transceiver.h"
+
+namespace {
+    constexpr size_t kTonePeriod = 100; // Samples per cycle of the simulated tone
+
+    // Blocks until the host's steady clock, which is the simulated device time, reaches tick
+    void WaitForTick(long long tick, double rate) {
+        const std::chrono::duration<double> device_time(static_cast<double>(tick) / rate);
+        std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(device_time)));
+    }
+
+    long long HostTicks(double rate) {
+        return uhd::time_spec_t(std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count()).to_ticks(rate);
+    }
+} // namespace
+
+SimRxStreamer::SimRxStreamer(size_t num_channels, const std::string &cpu_format, double rate, size_t max_num_samps, bool paced) :
+    num_channels(num_channels), sample_size(SampleSize(cpu_format)), rate(rate), max_num_samps(max_num_samps), paced(paced) {
+    // One packet plus a tone period, so a packet starting at any phase is a single contiguous copy
+    std::vector<std::complex<float>> tone(max_num_samps + kTonePeriod);
+    for (size_t i = 0; i < tone.size(); ++i) {
+        tone[i] = std::polar(0.7f, static_cast<float>(2 * std::numbers::pi * static_cast<double>(i % kTonePeriod) / kTonePeriod));
+    }
+    packet.resize(tone.size() * sample_size);
+    ProcessSamples(reinterpret_cast<const std::byte *>(tone.data()), "fc32", packet.data(), cpu_format, tone.size());
+}
+
+void SimRxStreamer::issue_stream_cmd(const uhd::stream_cmd_t &stream_cmd) {
+    if (stream_cmd.stream_mode == uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS) {
+        streaming = false;
+        return;
+    }
+    streaming = true;
+    continuous = stream_cmd.stream_mode == uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS;
+    remaining = stream_cmd.num_samps;
+    next_tick = stream_cmd.stream_now ? HostTicks(rate) : stream_cmd.time_spec.to_ticks(rate);
+}
+
+size_t SimRxStreamer::recv(const buffs_type &buffs, size_t nsamps_per_buff, uhd::rx_metadata_t &metadata, double, bool) {
+    metadata.has_time_spec = false;
+    metadata.more_fragments = false;
+    metadata.start_of_burst = metadata.end_of_burst = false;
+    // A real streamer would block for the timeout; returning at once keeps drains out of the measurements
+    if (not streaming) {
+        metadata.error_code = uhd::rx_metadata_t::ERROR_CODE_TIMEOUT;
+        return 0;
+    }
+
+    size_t nsamps = std::min(nsamps_per_buff, max_num_samps);
+    if (not continuous) {
+        nsamps = std::min(nsamps, remaining);
+    }
+    if (paced) {
+        WaitForTick(next_tick + static_cast<long long>(nsamps), rate);
+    }
+    const std::byte *source = packet.data() + static_cast<size_t>(next_tick % static_cast<long long>(kTonePeriod)) * sample_size;
+    for (size_t ch = 0; ch < num_channels; ++ch) {
+        std::memcpy(buffs[ch], source, nsamps * sample_size);
+    }
+
+    metadata.error_code = uhd::rx_metadata_t::ERROR_CODE_NONE;
+    metadata.has_time_spec = true;
+    metadata.time_spec = uhd::time_spec_t::from_ticks(next_tick, rate);
+    next_tick += static_cast<long long>(nsamps);
+    if (not continuous) {
+        remaining -= nsamps;
+        metadata.end_of_burst = remaining == 0;
+        streaming = remaining > 0;
+    }
+    return nsamps;
+}
+
+SimTxStreamer::SimTxStreamer(size_t num_channels, const std::string &cpu_format, double rate, size_t max_num_samps, bool paced) :
+    num_channels(num_channels), sample_size(SampleSize(cpu_format)), rate(rate), max_num_samps(max_num_samps), paced(paced),
+    scratch(max_num_samps * sample_size) {}
+
+size_t SimTxStreamer::send(const buffs_type &buffs, size_t nsamps_per_buff, const uhd::tx_metadata_t &metadata, double) {
+    if (metadata.has_time_spec) {
+        next_tick = metadata.time_spec.to_ticks(rate);
+    }
+    // Packetize like the device transport: every packet of every channel passes through the scratch buffer
+    for (size_t done = 0; done < nsamps_per_buff; done += max_num_samps) {
+        const size_t nsamps = std::min(max_num_samps, nsamps_per_buff - done);
+        for (size_t ch = 0; ch < num_channels; ++ch) {
+            std::memcpy(scratch.data(), static_cast<const std::byte *>(buffs[ch]) + done * sample_size, nsamps * sample_size);
+        }
+    }
+    next_tick += static_cast<long long>(nsamps_per_buff);
+    if (paced) {
+        WaitForTick(next_tick, rate);
+    }
+    if (metadata.end_of_burst) {
+        ack_pending = true;
+    }
+    return nsamps_per_buff;
+}
+
+bool SimTxStreamer::recv_async_msg(uhd::async_metadata_t &async_metadata, double) {
+    if (not ack_pending) {
+        return false;
+    }
+    ack_pending = false;
+    async_metadata.channel = 0;
+    async_metadata.has_time_spec = true;
+    async_metadata.time_spec = uhd::time_spec_t::from_ticks(next_tick, rate);
+    async_metadata.event_code = uhd::async_metadata_t::EVENT_CODE_BURST_ACK;
+    return true;
+}
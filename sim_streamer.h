@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <uhd/stream.hpp>
+#include <vector>
+
+/**
+ * RX streamer without a device, producing a full-scale tone for benchmarks
+ *
+ * Follows the calls UsrpTransceiver makes on a real streamer: stream commands start a
+ * continuous or finite stream at their time_spec, every recv() returns at most
+ * max_num_samps samples per channel, timestamped on the device timeline at the given
+ * rate, and a stream that has ended (or was never started) times out. The samples are
+ * copied from a precomputed packet, which stands in for UHD's converter. Unpaced,
+ * recv() returns as fast as the host copies, which isolates the host-side overhead;
+ * paced, it waits until the host's steady clock (the simulated device time) reaches
+ * the end of each packet.
+ */
+class SimRxStreamer : public uhd::rx_streamer {
+public:
+    SimRxStreamer(size_t num_channels, const std::string &cpu_format, double rate, size_t max_num_samps, bool paced);
+
+    size_t get_num_channels() const override { return num_channels; }
+
+    size_t get_max_num_samps() const override { return max_num_samps; }
+
+    size_t recv(const buffs_type &buffs, size_t nsamps_per_buff, uhd::rx_metadata_t &metadata, double timeout, bool one_packet) override;
+
+    void issue_stream_cmd(const uhd::stream_cmd_t &stream_cmd) override;
+
+private:
+    size_t num_channels;
+    size_t sample_size;
+    double rate;
+    size_t max_num_samps;
+    bool paced;
+    std::vector<std::byte> packet; // One packet of the tone in the CPU format
+
+    bool streaming{false};
+    bool continuous{false};
+    size_t remaining{0}; // Samples left in a finite stream
+    long long next_tick{0}; // Device time of the next sample, in ticks of rate
+    size_t phase{0}; // Position in the tone packet
+};
+
+/**
+ * TX streamer without a device for benchmarks
+ *
+ * send() copies each channel's samples into a packet-sized scratch buffer, as UHD's
+ * converter would, and acknowledges every burst once its end_of_burst arrives. Paced,
+ * send() waits until the host's steady clock reaches the end of the samples.
+ */
+class SimTxStreamer : public uhd::tx_streamer {
+public:
+    SimTxStreamer(size_t num_channels, const std::string &cpu_format, double rate, size_t max_num_samps, bool paced);
+
+    size_t get_num_channels() const override { return num_channels; }
+
+    size_t get_max_num_samps() const override { return max_num_samps; }
+
+    size_t send(const buffs_type &buffs, size_t nsamps_per_buff, const uhd::tx_metadata_t &metadata, double timeout) override;
+
+    bool recv_async_msg(uhd::async_metadata_t &async_metadata, double timeout) override;
+
+private:
+    size_t num_channels;
+    size_t sample_size;
+    double rate;
+    size_t max_num_samps;
+    bool paced;
+    std::vector<std::byte> scratch;
+
+    long long next_tick{0}; // Device time of the next sample, in ticks of rate
+    bool ack_pending{false};
+};
@@ -0,0 +1,107 @@
+#include "stream_metrics.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <format>
+#include <iterator>
+
+StreamMetricsSnapshot StreamMetricsSnapshot::Since(const StreamMetricsSnapshot &earlier) const {
+    StreamMetricsSnapshot delta = *this;
+    delta.samples -= earlier.samples;
+    delta.calls -= earlier.calls;
+    delta.timeouts -= earlier.timeouts;
+    delta.overflows -= earlier.overflows;
+    delta.underflows -= earlier.underflows;
+    delta.late_packets -= earlier.late_packets;
+    delta.seq_errors -= earlier.seq_errors;
+    delta.latency_ns -= earlier.latency_ns;
+    for (size_t i = 0; i < kLatencyBuckets; ++i) {
+        delta.latency_buckets[i] -= earlier.latency_buckets[i];
+    }
+    return delta;
+}
+
+double StreamMetricsSnapshot::BucketBound(size_t i) { return i + 1 < kLatencyBuckets ? std::ldexp(1e-6, static_cast<int>(i)) : INFINITY; }
+
+void StreamMetrics::RecordCall(Clock::duration latency, size_t nsamps) {
+    const auto ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count());
+    // Bucket i holds [2^(i-1), 2^i) us
+    const size_t bucket = std::min<size_t>(std::bit_width(ns / 1000), StreamMetricsSnapshot::kLatencyBuckets - 1);
+    latency_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    latency_ns.fetch_add(ns, std::memory_order_relaxed);
+    calls.fetch_add(1, std::memory_order_relaxed);
+    samples.fetch_add(nsamps, std::memory_order_relaxed);
+}
+
+void StreamMetrics::BeginBurst(Clock::time_point start) {
+    stream_start.store(start.time_since_epoch().count(), std::memory_order_relaxed);
+    first_pending.store(true, std::memory_order_release);
+}
+
+void StreamMetrics::RecordFirstSample(double offset) {
+    if (not first_pending.load(std::memory_order_relaxed) or not first_pending.exchange(false, std::memory_order_acq_rel)) {
+        return;
+    }
+    const Clock::time_point start{Clock::duration(stream_start.load(std::memory_order_relaxed))};
+    first_sample_wait.store(std::chrono::duration<double>(Clock::now() - start).count(), std::memory_order_relaxed);
+    first_sample_offset.store(offset, std::memory_order_relaxed);
+}
+
+StreamMetricsSnapshot StreamMetrics::Snapshot() const {
+    StreamMetricsSnapshot snapshot;
+    snapshot.samples = samples.load(std::memory_order_relaxed);
+    snapshot.calls = calls.load(std::memory_order_relaxed);
+    snapshot.timeouts = timeouts.load(std::memory_order_relaxed);
+    snapshot.overflows = overflows.load(std::memory_order_relaxed);
+    snapshot.underflows = underflows.load(std::memory_order_relaxed);
+    snapshot.late_packets = late_packets.load(std::memory_order_relaxed);
+    snapshot.seq_errors = seq_errors.load(std::memory_order_relaxed);
+    snapshot.latency_ns = latency_ns.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < StreamMetricsSnapshot::kLatencyBuckets; ++i) {
+        snapshot.latency_buckets[i] = latency_buckets[i].load(std::memory_order_relaxed);
+    }
+    snapshot.first_sample_offset = first_sample_offset.load(std::memory_order_relaxed);
+    snapshot.first_sample_wait = first_sample_wait.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+std::string FormatPrometheus(const std::vector<LabeledMetrics> &sources) {
+    std::string out;
+    auto labels = [](const LabeledMetrics &source) { return std::format("device=\"{}\",stream=\"{}\"", source.device, source.stream); };
+    auto counter = [&](const char *name, const char *help, uint64_t StreamMetricsSnapshot::*field) {
+        std::format_to(std::back_inserter(out), "# HELP txrx_stream_{0} {1}\n# TYPE txrx_stream_{0} counter\n", name, help);
+        for (const auto &source: sources) {
+            std::format_to(std::back_inserter(out), "txrx_stream_{}{{{}}} {}\n", name, labels(source), source.metrics.*field);
+        }
+    };
+    auto gauge = [&](const char *name, const char *help, double StreamMetricsSnapshot::*field) {
+        std::format_to(std::back_inserter(out), "# HELP txrx_stream_{0} {1}\n# TYPE txrx_stream_{0} gauge\n", name, help);
+        for (const auto &source: sources) {
+            std::format_to(std::back_inserter(out), "txrx_stream_{}{{{}}} {}\n", name, labels(source), source.metrics.*field);
+        }
+    };
+
+    counter("samples_total", "Samples moved by send/recv, summed over channels", &StreamMetricsSnapshot::samples);
+    counter("timeouts_total", "send/recv calls that timed out", &StreamMetricsSnapshot::timeouts);
+    counter("overflows_total", "RX overflows reported by the device", &StreamMetricsSnapshot::overflows);
+    counter("underflows_total", "TX underflows reported by the device", &StreamMetricsSnapshot::underflows);
+    counter("late_packets_total", "TX packets that arrived after their time_spec", &StreamMetricsSnapshot::late_packets);
+    counter("seq_errors_total", "TX sequence errors", &StreamMetricsSnapshot::seq_errors);
+    gauge("first_sample_offset_seconds", "Device time of the last burst's first RX sample relative to start_time", &StreamMetricsSnapshot::first_sample_offset);
+    gauge("first_sample_wait_seconds", "Host time from the start of the last burst's RX stream to its first sample", &StreamMetricsSnapshot::first_sample_wait);
+
+    out += "# HELP txrx_stream_call_seconds Duration of send/recv calls\n# TYPE txrx_stream_call_seconds histogram\n";
+    for (const auto &source: sources) {
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < StreamMetricsSnapshot::kLatencyBuckets; ++i) {
+            cumulative += source.metrics.latency_buckets[i];
+            const double bound = StreamMetricsSnapshot::BucketBound(i);
+            std::format_to(std::back_inserter(out), "txrx_stream_call_seconds_bucket{{{},le=\"{}\"}} {}\n", labels(source),
+                           std::isinf(bound) ? std::string("+Inf") : std::format("{:g}", bound), cumulative);
+        }
+        std::format_to(std::back_inserter(out), "txrx_stream_call_seconds_sum{{{}}} {:.9f}\ntxrx_stream_call_seconds_count{{{}}} {}\n", labels(source),
+                       static_cast<double>(source.metrics.latency_ns) * 1e-9, labels(source), source.metrics.calls);
+    }
+    return out;
+}
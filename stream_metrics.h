@@ -0,0 +1,100 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Plain copy of a stream's counters, see StreamMetrics
+ */
+struct StreamMetricsSnapshot {
+    static constexpr size_t kLatencyBuckets = 21; // Bucket i counts calls shorter than 2^i us; the last one everything slower
+
+    uint64_t samples{0}; // Summed over channels
+    uint64_t calls{0}; // send / recv calls
+    uint64_t timeouts{0};
+    uint64_t overflows{0};
+    uint64_t underflows{0};
+    uint64_t late_packets{0}; // TX packets that reached the device after their time_spec
+    uint64_t seq_errors{0};
+    uint64_t latency_ns{0}; // Total time spent inside send / recv
+    std::array<uint64_t, kLatencyBuckets> latency_buckets{};
+    double first_sample_offset{0}; // Device time of the last burst's first sample minus start_time, in seconds
+    double first_sample_wait{0}; // Host time from the start of the last burst's stream to its first sample, in seconds
+
+    /**
+     * Counter increase from earlier to this snapshot; the first-sample values are this snapshot's
+     */
+    [[nodiscard]] StreamMetricsSnapshot Since(const StreamMetricsSnapshot &earlier) const;
+
+    /**
+     * Upper bound of latency bucket i in seconds (2^i us); the last bucket is unbounded
+     */
+    static double BucketBound(size_t i);
+};
+
+/**
+ * Lock-free counters of one stream direction, updated from the streaming threads
+ *
+ * Every update is a relaxed atomic add, so several receive threads can share one instance
+ * and the request loop can read it at any time without stalling the radio. The counters
+ * only grow; per-burst figures are the difference of two snapshots.
+ */
+class StreamMetrics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Records one send / recv call that took latency and moved nsamps samples (summed over channels)
+     */
+    void RecordCall(Clock::duration latency, size_t nsamps);
+
+    void RecordTimeout() { timeouts.fetch_add(1, std::memory_order_relaxed); }
+
+    void RecordOverflow() { overflows.fetch_add(1, std::memory_order_relaxed); }
+
+    void RecordUnderflow() { underflows.fetch_add(1, std::memory_order_relaxed); }
+
+    void RecordLatePacket() { late_packets.fetch_add(1, std::memory_order_relaxed); }
+
+    void RecordSeqError() { seq_errors.fetch_add(1, std::memory_order_relaxed); }
+
+    /**
+     * Starts a burst: the next RecordFirstSample sets the first-sample figures
+     */
+    void BeginBurst(Clock::time_point stream_start);
+
+    /**
+     * Records the first samples of the burst (later calls until the next BeginBurst are ignored)
+     *
+     * @param offset Device time of the first sample minus the scheduled start_time, in seconds
+     */
+    void RecordFirstSample(double offset);
+
+    [[nodiscard]] StreamMetricsSnapshot Snapshot() const;
+
+private:
+    std::atomic<uint64_t> samples{0}, calls{0}, timeouts{0}, overflows{0}, underflows{0}, late_packets{0}, seq_errors{0}, latency_ns{0};
+    std::array<std::atomic<uint64_t>, StreamMetricsSnapshot::kLatencyBuckets> latency_buckets{};
+    std::atomic<Clock::rep> stream_start{0};
+    std::atomic<bool> first_pending{false};
+    std::atomic<double> first_sample_offset{0}, first_sample_wait{0};
+};
+
+/**
+ * A snapshot with the labels it is exported under
+ */
+struct LabeledMetrics {
+    std::string device; // Device name ("default" for the unnamed one)
+    std::string stream; // "tx" or "rx"
+    StreamMetricsSnapshot metrics;
+};
+
+/**
+ * Renders snapshots in the Prometheus text exposition format (txrx_stream_* metrics)
+ */
+std::string FormatPrometheus(const std::vector<LabeledMetrics> &sources);
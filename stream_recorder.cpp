@@ -0,0 +1,215 @@
+#include "stream_recorder.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <format>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using std::format;
+using std::string;
+using std::vector;
+
+namespace {
+    // O_DIRECT needs buffers, sizes and offsets aligned to the logical block size
+    constexpr size_t kIoAlignment = 4096;
+
+    // Blocks whose writes are queued at once: enough to keep the disks busy, few enough to leave the receiver free blocks
+    constexpr size_t kBlocksInFlight = 4;
+
+    size_t AlignUp(size_t value, size_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+} // namespace
+
+StreamRecorder::StreamRecorder(const vector<string> &files, size_t sample_size, size_t block_samps, size_t num_blocks, bool direct_io, int numa_node,
+                               vector<SigmfChannel> sigmf) :
+    file_names(files), direct_io(direct_io), sample_size(sample_size),
+    ring(files.size(), sample_size, AlignUp(block_samps, kIoAlignment / sample_size), num_blocks, true, numa_node),
+    blocks_in_flight(std::min(kBlocksInFlight, num_blocks)), sigmf_channels(std::move(sigmf)) {
+    if (not sigmf_channels.empty()) {
+        if (sigmf_channels.size() != files.size() or sigmf_channels.front().sample_rate <= 0) {
+            throw std::invalid_argument(format("SigMF needs one description with a sample rate per file, got {} for {} files", sigmf_channels.size(), files.size()));
+        }
+        for (const auto &channel: sigmf_channels) {
+            indexes.push_back(std::make_unique<SigmfIndex>(channel.data_file + ".sigmf-index", channel.sample_rate, ring.BlockSamples()));
+        }
+    }
+
+    for (const auto &file: file_names) {
+        int flags = O_WRONLY | O_CREAT | O_TRUNC | (direct_io ? O_DIRECT : 0);
+        int fd = open(file.c_str(), flags, 0644);
+        if (fd == -1) {
+            for (int opened: fds)
+                close(opened);
+            UHD_LOG_ERROR("RECORDER", format("Cannot open receive file: {}", file));
+            throw std::runtime_error(format("Cannot open receive file {}: {}", file, strerror(errno)));
+        }
+        fds.push_back(fd);
+        UHD_LOG_INFO("RECORDER", format("Rx channel streaming to file: {}", file));
+    }
+
+    io = std::make_unique<AsyncFileIo>(fds, file_names, blocks_in_flight * fds.size());
+    io->RegisterBuffers(ring.Memory());
+
+    UHD_LOG_INFO("RECORDER", format("Block ring: {} blocks x {} channels x {} samples{}, {} writes in flight ({})", num_blocks, ring.NumChannels(),
+                                    ring.BlockSamples(), direct_io ? " (O_DIRECT)" : "", io->QueueDepth(), io->Backend()));
+    writer = std::thread(&StreamRecorder::WriterLoop, this);
+}
+
+StreamRecorder::~StreamRecorder() {
+    try {
+        Finish();
+    } catch (const std::exception &e) {
+        UHD_LOG_ERROR("RECORDER", format("Error while finishing recording: {}", e.what()));
+    }
+}
+
+RxBlock StreamRecorder::Acquire() {
+    // A failed writer ends the reception
+    if (writer_failed.load(std::memory_order_acquire)) {
+        return {};
+    }
+    return ring.Acquire();
+}
+
+void StreamRecorder::Commit(const RxBlock &block, size_t nsamps, const uhd::time_spec_t &time_spec) { ring.Commit(block, nsamps, time_spec); }
+
+void StreamRecorder::Finish(vector<SigmfAnnotation> gaps) {
+    if (not writer.joinable()) {
+        return;
+    }
+    ring.Close();
+    writer.join();
+    io.reset();
+
+    for (size_t ch = 0; ch < fds.size(); ++ch) {
+        // O_DIRECT writes are padded to the alignment; cut the files back to the real length
+        if (direct_io and ftruncate(fds[ch], samps_written * sample_size) == -1) {
+            UHD_LOG_WARNING("RECORDER", format("Cannot truncate {}: {}", file_names[ch], strerror(errno)));
+        }
+        close(fds[ch]);
+    }
+    fds.clear();
+
+    if (not sigmf_channels.empty()) {
+        indexes.clear();
+        // A gap at stream position p is at file position p minus what was dropped before it
+        vector<SigmfAnnotation> file_gaps;
+        for (auto &gap: gaps) {
+            auto resumed = std::ranges::upper_bound(resume_positions, std::pair{gap.sample_start, UINT64_MAX});
+            const uint64_t dropped = resumed == resume_positions.begin() ? 0 : std::prev(resumed)->second;
+            const bool in_drop = resumed != resume_positions.end() and gap.sample_start + (resumed->second - dropped) >= resumed->first;
+            if (not in_drop) {
+                gap.sample_start -= dropped;
+                file_gaps.push_back(std::move(gap));
+            }
+        }
+        WriteMetadata(file_gaps);
+    }
+
+    if (ring.Overflows() > 0) {
+        UHD_LOG_WARNING("RECORDER", format("Writer fell behind: dropped {} blocks ({} samples per channel)", ring.Overflows(), ring.DroppedSamples()));
+    }
+    UHD_LOG_INFO("RECORDER", format("Recording finished: {} samples per channel, {} files", samps_written, file_names.size()));
+    if (writer_error) {
+        std::rethrow_exception(writer_error);
+    }
+}
+
+void StreamRecorder::WriterLoop() {
+    // Blocks from the front of the ring whose writes are queued, oldest first
+    struct PendingBlock {
+        uint64_t tag;
+        uint64_t file_offset; // Samples per channel
+        size_t writes; // Channel writes not yet complete
+    };
+    std::deque<PendingBlock> pending;
+    uint64_t next_tag = 0;
+    uint64_t queued_samps = 0;
+
+    try {
+        while (true) {
+            // Queue every block that has arrived, up to the in-flight limit
+            while (pending.size() < blocks_in_flight and ring.Available() > pending.size()) {
+                const size_t index = pending.size();
+                const size_t nsamps = ring.InfoAt(index).nsamps;
+                SubmitBlock(ring.At(index), nsamps, queued_samps, next_tag);
+                pending.push_back({next_tag++, queued_samps, fds.size()});
+                queued_samps += nsamps;
+            }
+            if (pending.empty()) {
+                if (not ring.Wait()) {
+                    break;
+                }
+                continue;
+            }
+
+            for (uint64_t tag: io->Reap()) {
+                --pending[tag - pending.front().tag].writes;
+            }
+            // Blocks go back to the ring in order, once all their channels are on disk
+            while (not pending.empty() and pending.front().writes == 0) {
+                const auto &info = ring.FrontInfo();
+                samps_written += info.nsamps;
+                if (not sigmf_channels.empty()) {
+                    IndexBlock(info, pending.front().file_offset);
+                }
+                ring.Release();
+                pending.pop_front();
+            }
+        }
+    } catch (...) {
+        writer_error = std::current_exception();
+        writer_failed.store(true, std::memory_order_release);
+        // The files are closed once the writer has stopped; nothing may still be writing to them
+        try {
+            io->Drain();
+        } catch (...) {
+        }
+    }
+}
+
+void StreamRecorder::SubmitBlock(const RxBlock &block, size_t nsamps, uint64_t file_offset, uint64_t tag) {
+    size_t bytes = nsamps * sample_size;
+    if (direct_io) {
+        bytes = AlignUp(bytes, kIoAlignment);
+    }
+    for (size_t ch = 0; ch < block.buffs.size(); ++ch) {
+        io->Write(ch, block.buffs[ch], bytes, file_offset * sample_size, tag);
+    }
+}
+
+void StreamRecorder::IndexBlock(const SampleRing::BlockInfo &info, uint64_t file_offset) {
+    const double rate = sigmf_channels.front().sample_rate;
+    const long long tick = info.time_spec.to_ticks(rate);
+
+    if (info.position != next_position) {
+        const uint64_t lost = info.position - next_position;
+        drops.push_back({file_offset, 0, lost, "dropped"});
+        resume_positions.emplace_back(info.position, (resume_positions.empty() ? 0 : resume_positions.back().second) + lost);
+    }
+    // A new capture segment wherever the device time does not continue from the previous block
+    const bool new_capture = captures.empty() or tick != next_tick;
+    if (new_capture) {
+        captures.push_back({file_offset, info.time_spec});
+    }
+    next_position = info.position + info.nsamps;
+    next_tick = tick + static_cast<long long>(info.nsamps);
+
+    for (auto &index: indexes) {
+        index->Append(file_offset, info.nsamps, info.time_spec);
+    }
+    if (new_capture) {
+        WriteMetadata({});
+    }
+}
+
+void StreamRecorder::WriteMetadata(const vector<SigmfAnnotation> &gaps) const {
+    vector<SigmfAnnotation> annotations = drops;
+    annotations.insert(annotations.end(), gaps.begin(), gaps.end());
+    for (const auto &channel: sigmf_channels) {
+        WriteSigmfMeta(channel, captures, annotations, channel.data_file + ".sigmf-index");
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "async_file_io.h"
+#include "sample_ring.h"
+#include "sigmf_meta.h"
+#include "usrp_transceiver.h"
+
+/**
+ * Records an RX stream of unbounded length to per-channel files
+ *
+ * The receive thread fills blocks of a SampleRing (Acquire) and hands them back (Commit);
+ * a writer thread drains the filled blocks to disk with large, page-aligned writes, so disk
+ * I/O overlaps reception and memory use is bounded by the ring size. The writes of several
+ * blocks, for every channel file at once, are queued through AsyncFileIo (io_uring with the
+ * ring registered as fixed buffers, or a thread per file), and blocks are released in order
+ * as their writes complete. If the disk falls
+ * behind, blocks are dropped rather than stalling the receive thread; the drops are
+ * reported when the recording finishes.
+ *
+ * With SigMF channel descriptions, every file gets a <file>.sigmf-index block index,
+ * appended as each block is written, and a <file>.sigmf-meta sidecar, rewritten whenever
+ * the device time jumps (a new capture segment) and completed with the gaps by Finish.
+ * A recording cut short therefore still describes everything written up to that point.
+ */
+class StreamRecorder {
+public:
+    /**
+     * Opens the output files and starts the writer thread
+     *
+     * @param files Output file, one per RX channel
+     * @param sample_size Size of one sample in the CPU format, in bytes
+     * @param block_samps Samples per channel in each block (rounded up to a page multiple)
+     * @param num_blocks Number of blocks in the pool
+     * @param direct_io Open the files with O_DIRECT to bypass the page cache
+     * @param numa_node NUMA node for the block buffers (-1 = any)
+     * @param sigmf SigMF description of each file (see SigmfChannels); empty writes the raw files only
+     */
+    StreamRecorder(const std::vector<std::string> &files, size_t sample_size, size_t block_samps, size_t num_blocks, bool direct_io, int numa_node = -1,
+                   std::vector<SigmfChannel> sigmf = {});
+
+    ~StreamRecorder();
+
+    StreamRecorder(const StreamRecorder &) = delete;
+
+    StreamRecorder &operator=(const StreamRecorder &) = delete;
+
+    /**
+     * Returns a free block (never waits; see SampleRing::Acquire)
+     */
+    RxBlock Acquire();
+
+    /**
+     * Queues a filled block for writing
+     */
+    void Commit(const RxBlock &block, size_t nsamps, const uhd::time_spec_t &time_spec);
+
+    /**
+     * Writes all queued blocks, stops the writer and closes the files
+     *
+     * Rethrows any error raised by the writer thread.
+     *
+     * @param gaps Device gaps to annotate in the SigMF metadata (GapAnnotations), at stream
+     *             positions; they are moved to file positions past the dropped blocks
+     */
+    void Finish(std::vector<SigmfAnnotation> gaps = {});
+
+    [[nodiscard]] size_t SamplesWritten() const { return samps_written; }
+
+    /**
+     * @return Number of blocks dropped because the writer fell behind
+     */
+    [[nodiscard]] uint64_t Overflows() const { return ring.Overflows(); }
+
+private:
+    std::vector<std::string> file_names;
+    std::vector<int> fds;
+    bool direct_io;
+    size_t sample_size;
+
+    SampleRing ring;
+    std::unique_ptr<AsyncFileIo> io;
+    size_t blocks_in_flight; // Blocks whose writes may be queued at once
+
+    std::atomic<bool> writer_failed{false};
+    std::exception_ptr writer_error;
+
+    size_t samps_written{0};
+    std::thread writer;
+
+    // SigMF state, owned by the writer thread until Finish joins it
+    std::vector<SigmfChannel> sigmf_channels;
+    std::vector<std::unique_ptr<SigmfIndex>> indexes;
+    std::vector<SigmfCapture> captures;
+    std::vector<SigmfAnnotation> drops; // Blocks dropped before reaching the file
+    std::vector<std::pair<uint64_t, uint64_t>> resume_positions; // Stream position after each drop, samples dropped up to it
+    uint64_t next_position{0}; // Stream position the next block continues at
+    long long next_tick{0}; // Device time the next block continues at, in ticks of the file rate
+
+    void WriterLoop();
+
+    void SubmitBlock(const RxBlock &block, size_t nsamps, uint64_t file_offset, uint64_t tag);
+
+    void IndexBlock(const SampleRing::BlockInfo &info, uint64_t file_offset);
+
+    void WriteMetadata(const std::vector<SigmfAnnotation> &gaps) const;
+};
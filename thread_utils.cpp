@@ -0,0 +1,53 @@
+#include "thread_utils.h"
+
+#include <cerrno>
+#include <cstring>
+#include <format>
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <uhd/utils/log.hpp>
+#include <uhd/utils/thread.hpp>
+
+using std::format;
+using std::string;
+
+namespace {
+    // libnuma is not required for this: the two memory policy syscalls are called directly
+    // The syscalls read maxnode - 1 bits of the nodemask
+    constexpr unsigned long kMaxNode = kMaxNumaNodes + 1;
+
+    unsigned long NodeMask(int numa_node) { return 1UL << numa_node; }
+} // namespace
+
+void SetupStreamingThread(const string &name, const std::vector<size_t> &cpus, float priority, int numa_node) {
+    pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+
+    if (not cpus.empty()) {
+        uhd::set_thread_affinity(cpus);
+    }
+    if (priority > 0 and not uhd::set_thread_priority_safe(priority, true)) {
+        UHD_LOG_WARNING("THREAD", format("{}: could not enable real-time priority (needs CAP_SYS_NICE or rtprio limits)", name));
+    }
+    if (numa_node >= 0) {
+        unsigned long mask = NodeMask(numa_node);
+        if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, kMaxNode) == -1) {
+            UHD_LOG_WARNING("THREAD", format("{}: set_mempolicy(node {}) failed: {}", name, numa_node, strerror(errno)));
+        }
+    }
+
+    UHD_LOG_DEBUG("THREAD", format("{}: {} CPUs, priority {}, NUMA node {}", name, cpus.size(), priority, numa_node));
+}
+
+void BindToNumaNode(void *addr, size_t len, int numa_node) {
+    if (numa_node < 0 or len == 0) {
+        return;
+    }
+    unsigned long mask = NodeMask(numa_node);
+    if (syscall(SYS_mbind, addr, len, MPOL_BIND, &mask, kMaxNode, MPOL_MF_MOVE) == -1) {
+        UHD_LOG_WARNING("THREAD", format("mbind to NUMA node {} failed: {}", numa_node, strerror(errno)));
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/** NUMA nodes a numa_node setting can select: the nodemask passed to the kernel is one unsigned long */
+inline constexpr int kMaxNumaNodes = 64;
+
+/**
+ * Prepares the calling thread for streaming
+ *
+ * Pins the thread to the given CPUs, switches it to SCHED_FIFO when priority > 0 and
+ * prefers numa_node for the memory it allocates. Settings that cannot be applied (e.g.
+ * missing CAP_SYS_NICE) are logged and otherwise ignored.
+ *
+ * @param name Thread name shown by top/ps (at most 15 characters are kept)
+ * @param cpus CPUs to run on; empty leaves the affinity unchanged
+ * @param priority Real-time priority in (0, 1]; 0 keeps the default scheduler
+ * @param numa_node Preferred NUMA node for allocations; -1 leaves placement to the kernel
+ */
+void SetupStreamingThread(const std::string &name, const std::vector<size_t> &cpus, float priority, int numa_node);
+
+/**
+ * Binds a page-aligned memory range to a NUMA node, migrating pages that are already present
+ *
+ * Does nothing when numa_node is -1.
+ */
+void BindToNumaNode(void *addr, size_t len, int numa_node);
@@ -0,0 +1,431 @@
+#include <algorithm>
+#include <atomic>
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <uhd/utils/log.hpp>
+#include <uhd/utils/safe_main.hpp>
+#include <vector>
+#include <zmq.hpp>
+
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "burst_executor.h"
+#include "shm_segment.h"
+#include "sim_streamer.h"
+#include "usrp_protocol.pb.h"
+#include "usrp_transceiver.h"
+#include "utils.h"
+
+namespace fs = std::filesystem;
+namespace po = boost::program_options;
+
+using std::format;
+using std::string;
+using std::vector;
+
+namespace {
+    const string kTxShmName = "/txrx_bench_tx";
+
+    struct BenchOptions {
+        vector<size_t> channels;
+        vector<size_t> samps;
+        string cpu_format;
+        double rate{0};
+        size_t packet_samps{0};
+        size_t spb{0};
+        size_t iterations{0};
+        bool paced{false};
+        string dir;
+        uint16_t port{0};
+        string server; // txrx_server binary for the EXECUTE benchmark
+        bool verbose{false};
+    };
+
+    double Median(vector<double> values) {
+        std::ranges::nth_element(values, values.begin() + static_cast<std::ptrdiff_t>(values.size() / 2));
+        return values[values.size() / 2];
+    }
+
+    /**
+     * Median wall time of fn in seconds over iterations runs, after one warm-up run
+     */
+    template <typename Fn>
+    double MedianSeconds(size_t iterations, Fn &&fn) {
+        fn();
+        vector<double> times;
+        for (size_t i = 0; i < std::max<size_t>(iterations, 1); ++i) {
+            const auto start = std::chrono::steady_clock::now();
+            fn();
+            times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        return Median(std::move(times));
+    }
+
+    double GigabytesPerSecond(size_t bytes, double seconds) { return static_cast<double>(bytes) / seconds / 1e9; }
+
+    void PrintHeader(const string &title, const string &columns) { std::cout << format("\n== {}\n{:>4} {:>10} {}\n", title, "ch", "samps", columns); }
+
+    /**
+     * Transceiver whose streamers are simulated, with enough channels for every case
+     */
+    std::unique_ptr<UsrpTransceiver> MakeSimTransceiver(const BenchOptions &options) {
+        const size_t max_channels = std::ranges::max(options.channels);
+        return std::make_unique<UsrpTransceiver>(
+                max_channels, max_channels,
+                [options](const uhd::stream_args_t &args) {
+                    return std::make_shared<SimTxStreamer>(args.channels.size(), args.cpu_format, options.rate, options.packet_samps, options.paced);
+                },
+                [options](const uhd::stream_args_t &args) {
+                    return std::make_shared<SimRxStreamer>(args.channels.size(), args.cpu_format, options.rate, options.packet_samps, options.paced);
+                });
+    }
+
+    /**
+     * EXECUTE request for a TX and RX burst of nsamps samples on channels 0 .. num_ch - 1
+     */
+    usrp_proto::Request MakeExecuteRequest(const BenchOptions &options, size_t num_ch, size_t nsamps) {
+        usrp_proto::Request request;
+        request.set_cmd(usrp_proto::EXECUTE);
+        request.set_tx_shm_name(kTxShmName);
+        auto *config = request.mutable_config();
+        config->set_cpu_format(options.cpu_format);
+        config->set_otw_format("sc16");
+        config->set_spb(options.spb);
+        config->set_tx_samps(nsamps);
+        config->set_rx_samps(nsamps);
+        for (size_t ch = 0; ch < num_ch; ++ch) {
+            config->add_tx_channels(ch);
+            config->add_rx_channels(ch);
+            config->add_tx_rates(options.rate);
+            config->add_rx_rates(options.rate);
+            config->add_tx_freqs(1e9);
+            config->add_rx_freqs(1e9);
+            config->add_tx_gains(0);
+            config->add_rx_gains(0);
+            config->add_tx_ants("TX/RX");
+            config->add_rx_ants("RX2");
+        }
+        return request;
+    }
+
+    /**
+     * Client-side TX segment of num_ch channels of nsamps samples, filled so its pages are resident
+     */
+    ShmSegment MakeTxSegment(const BenchOptions &options, size_t num_ch, size_t nsamps) {
+        ShmSegment segment = ShmSegment::Create(kTxShmName, num_ch * nsamps * SampleSize(options.cpu_format));
+        std::memset(segment.data(), 0x11, segment.size());
+        return segment;
+    }
+
+    // StageBurst as the request loop runs it, with the TX mapping already cached: planar SHM is
+    // only viewed, interleaved SHM is de-interleaved and a different stream format is converted
+    void BenchStaging(const BenchOptions &options) {
+        auto transceiver = MakeSimTransceiver(options);
+        const string convert_format = options.cpu_format == "fc32" ? "sc16" : "fc32";
+        PrintHeader("SHM staging (StageBurst)", format("{:>14} {:>14} {:>24}", "planar us", "interleaved", format("convert to {} GB/s", convert_format)));
+        for (size_t num_ch: options.channels) {
+            for (size_t nsamps: options.samps) {
+                const ShmSegment tx_segment = MakeTxSegment(options, num_ch, nsamps);
+                std::shared_ptr<const ShmSegment> tx_shm;
+                usrp_proto::Request request = MakeExecuteRequest(options, num_ch, nsamps);
+                auto stage = [&] { BurstJob job = StageBurst(request, UsrpConfig{}, *transceiver, tx_shm); };
+
+                const double planar = MedianSeconds(options.iterations, stage);
+                request.set_tx_interleaved(true);
+                const double interleaved = MedianSeconds(options.iterations, stage);
+                request.set_tx_interleaved(false);
+                request.mutable_config()->set_tx_stream_format(convert_format);
+                const double converted = MedianSeconds(options.iterations, stage);
+
+                std::cout << format("{:>4} {:>10} {:>14.1f} {:>9.2f} GB/s {:>24.2f}\n", num_ch, nsamps, planar * 1e6,
+                                    GigabytesPerSecond(tx_segment.size(), interleaved), GigabytesPerSecond(tx_segment.size(), converted));
+            }
+        }
+    }
+
+    // Whole-file reads and writes of every channel; reads are served from the page cache the writes just filled
+    void BenchFiles(const BenchOptions &options) {
+        PrintHeader(format("File I/O in {}", options.dir), format("{:>18} {:>18}", "WriteBufferToFile", "LoadFileToBuffer"));
+        const size_t sample_size = SampleSize(options.cpu_format);
+        for (size_t num_ch: options.channels) {
+            for (size_t nsamps: options.samps) {
+                UsrpConfig config;
+                config.cpu_format = options.cpu_format;
+                for (size_t ch = 0; ch < num_ch; ++ch) {
+                    config.tx_channels.push_back(ch);
+                    config.rx_files.push_back((fs::path(options.dir) / format("txrx_bench_{}.bin", ch)).string());
+                }
+                config.tx_files = config.rx_files;
+                vector<SampleBuffer> buffs(num_ch);
+                for (auto &buff: buffs) {
+                    buff.resize(nsamps * sample_size, std::byte{0x11});
+                }
+                const size_t total_bytes = num_ch * nsamps * sample_size;
+
+                const double write = MedianSeconds(options.iterations, [&] { WriteBufferToFile(config, buffs); });
+                const double read = MedianSeconds(options.iterations, [&] { auto loaded = LoadFileToBuffer(config); });
+                for (const auto &file: config.rx_files) {
+                    fs::remove(file);
+                }
+                std::cout << format("{:>4} {:>10} {:>13.2f} GB/s {:>13.2f} GB/s\n", num_ch, nsamps, GigabytesPerSecond(total_bytes, write),
+                                    GigabytesPerSecond(total_bytes, read));
+            }
+        }
+    }
+
+    // The send/recv loops of UsrpTransceiver against simulated streamers: what each call costs on top of the streamer's copy
+    void BenchLoops(const BenchOptions &options) {
+        auto transceiver = MakeSimTransceiver(options);
+        std::atomic<bool> stop{false};
+        const size_t sample_size = SampleSize(options.cpu_format);
+        PrintHeader(format("Streaming loops ({} samples per packet{})", options.packet_samps, options.paced ? ", paced" : ""),
+                    format("{:>14} {:>14} {:>14} {:>14}", "TX Msps/ch", "TX ns/call", "RX Msps/ch", "RX ns/call"));
+        for (size_t num_ch: options.channels) {
+            for (size_t nsamps: options.samps) {
+                UsrpConfig config = ConvertConfig(MakeExecuteRequest(options, num_ch, nsamps).config(), UsrpConfig{});
+                if (not transceiver->ValidateConfiguration(config, false)) {
+                    throw std::runtime_error("Configuration validation failed");
+                }
+                transceiver->ApplyConfiguration(config, stop);
+
+                vector<SampleBuffer> tx_buffs(num_ch);
+                for (auto &buff: tx_buffs) {
+                    buff.resize(nsamps * sample_size, std::byte{0x11});
+                }
+                const vector<TxChannelView> tx_views(tx_buffs.begin(), tx_buffs.end());
+                vector<SampleBuffer> rx_buffs(num_ch);
+                vector<std::byte *> rx_ptrs;
+                for (auto &buff: rx_buffs) {
+                    buff.resize(nsamps * sample_size);
+                    rx_ptrs.push_back(buff.data());
+                }
+
+                const StreamMetricsSnapshot tx_before = transceiver->TxMetrics();
+                const double tx = MedianSeconds(options.iterations, [&] {
+                    transceiver->CalculateTransmissionTime();
+                    transceiver->TransmitFromBuffer(tx_views, stop);
+                });
+                const StreamMetricsSnapshot tx_delta = transceiver->TxMetrics().Since(tx_before);
+
+                const StreamMetricsSnapshot rx_before = transceiver->RxMetrics();
+                const double rx = MedianSeconds(options.iterations, [&] {
+                    transceiver->CalculateTransmissionTime();
+                    transceiver->ReceiveToMemory(rx_ptrs, stop);
+                });
+                const StreamMetricsSnapshot rx_delta = transceiver->RxMetrics().Since(rx_before);
+
+                auto per_call_ns = [](const StreamMetricsSnapshot &delta) { return delta.calls == 0 ? 0.0 : static_cast<double>(delta.latency_ns) / delta.calls; };
+                std::cout << format("{:>4} {:>10} {:>14.1f} {:>14.0f} {:>14.1f} {:>14.0f}\n", num_ch, nsamps, nsamps / tx / 1e6, per_call_ns(tx_delta),
+                                    nsamps / rx / 1e6, per_call_ns(rx_delta));
+            }
+        }
+    }
+
+    /**
+     * txrx_server with simulated devices in a child process, on the bench's port
+     *
+     * Stopped with SIGINT like from a terminal. Unless --verbose, its console log is limited
+     * to warnings so per-burst messages do not end up in the timings.
+     */
+    class SimServer {
+    public:
+        explicit SimServer(const BenchOptions &options) {
+            vector<string> args = {options.server,
+                                   "--sim",
+                                   "--sim-channels",
+                                   std::to_string(std::ranges::max(options.channels)),
+                                   "--sim-rate",
+                                   format("{}", options.rate),
+                                   "--sim-packet-samps",
+                                   std::to_string(options.packet_samps),
+                                   "--port",
+                                   std::to_string(options.port),
+                                   "--pub-port",
+                                   std::to_string(options.port + 1),
+                                   "--burst-lead",
+                                   "0.001"};
+            if (options.paced) {
+                args.emplace_back("--sim-paced");
+            }
+            vector<string> env;
+            for (char **var = environ; *var; ++var) {
+                if (not string(*var).starts_with("UHD_LOG_CONSOLE_LEVEL=")) {
+                    env.emplace_back(*var);
+                }
+            }
+            if (not options.verbose) {
+                env.emplace_back("UHD_LOG_CONSOLE_LEVEL=warning");
+            }
+            auto pointers = [](vector<string> &strings) {
+                vector<char *> result;
+                for (auto &str: strings) {
+                    result.push_back(str.data());
+                }
+                result.push_back(nullptr);
+                return result;
+            };
+            if (const int error = posix_spawn(&pid, options.server.c_str(), nullptr, nullptr, pointers(args).data(), pointers(env).data()); error != 0) {
+                throw std::runtime_error(format("Cannot start {}: {}", options.server, strerror(error)));
+            }
+        }
+
+        SimServer(const SimServer &) = delete;
+
+        SimServer &operator=(const SimServer &) = delete;
+
+        ~SimServer() {
+            if (pid > 0) {
+                kill(pid, SIGINT);
+                waitpid(pid, nullptr, 0);
+            }
+        }
+
+        /**
+         * Throws once the server has exited, e.g. because one of its ports is taken
+         */
+        void CheckRunning() {
+            int status = 0;
+            if (pid > 0 and waitpid(pid, &status, WNOHANG) == pid) {
+                pid = -1;
+                throw std::runtime_error(WIFEXITED(status) ? format("txrx_server exited with status {}", WEXITSTATUS(status))
+                                                           : format("txrx_server was killed by signal {}", WTERMSIG(status)));
+            }
+        }
+
+    private:
+        pid_t pid{-1};
+    };
+
+    // A REQ client timing EXECUTE until its reply, mapping the RX result like a real client, then RELEASE, against txrx_server --sim
+    void BenchExecute(const BenchOptions &options) {
+        SimServer server(options);
+        zmq::context_t ctx{1};
+        zmq::socket_t client{ctx, zmq::socket_type::req};
+        client.connect(format("tcp://127.0.0.1:{}", options.port));
+        // Waits for the reply as long as the server runs; a burst has no fixed time limit
+        auto call = [&](const usrp_proto::Request &request) {
+            string serialized;
+            request.SerializeToString(&serialized);
+            client.send(zmq::buffer(serialized), zmq::send_flags::none);
+            std::vector<zmq::pollitem_t> items = {{client.handle(), 0, ZMQ_POLLIN, 0}};
+            while (zmq::poll(items, std::chrono::milliseconds(100)) == 0) {
+                server.CheckRunning();
+            }
+            zmq::message_t message;
+            if (not client.recv(message)) {
+                throw std::runtime_error("No reply");
+            }
+            usrp_proto::Response reply;
+            reply.ParseFromArray(message.data(), static_cast<int>(message.size()));
+            if (reply.status() != usrp_proto::SUCCESS and reply.status() != usrp_proto::RELEASED) {
+                throw std::runtime_error(format("Request failed: {}", reply.msg()));
+            }
+            return reply;
+        };
+
+        usrp_proto::Request ping;
+        ping.set_cmd(usrp_proto::PING);
+        while (not call(ping).ready()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        PrintHeader(format("EXECUTE round trip to txrx_server --sim over tcp://127.0.0.1:{}", options.port), format("{:>14} {:>14} {:>14}", "round trip ms", "release ms", "burst Msps/ch"));
+        for (size_t num_ch: options.channels) {
+            for (size_t nsamps: options.samps) {
+                const ShmSegment tx_segment = MakeTxSegment(options, num_ch, nsamps);
+                const usrp_proto::Request request = MakeExecuteRequest(options, num_ch, nsamps);
+                usrp_proto::Request release;
+                release.set_cmd(usrp_proto::RELEASE);
+
+                vector<double> execute_times, release_times;
+                for (size_t i = 0; i <= std::max<size_t>(options.iterations, 1); ++i) {
+                    const auto start = std::chrono::steady_clock::now();
+                    const usrp_proto::Response reply = call(request);
+                    {
+                        const ShmSegment result = ShmSegment::Open(reply.rx_shm_name());
+                    }
+                    const auto executed = std::chrono::steady_clock::now();
+                    call(release);
+                    // The first run is a warm-up (streamer creation, first SHM mappings)
+                    if (i > 0) {
+                        execute_times.push_back(std::chrono::duration<double>(executed - start).count());
+                        release_times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - executed).count());
+                    }
+                }
+                const double execute = Median(execute_times);
+                std::cout << format("{:>4} {:>10} {:>14.3f} {:>14.3f} {:>14.1f}\n", num_ch, nsamps, execute * 1e3, Median(release_times) * 1e3,
+                                    nsamps / execute / 1e6);
+            }
+        }
+    }
+} // namespace
+
+int UHD_SAFE_MAIN(int argc, char *argv[]) {
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+    BenchOptions options;
+    vector<string> benches;
+
+    po::options_description desc("Host-side benchmarks of the TX/RX pipeline against simulated streamers");
+    desc.add_options()("help,h", "Show help")(
+            "bench", po::value<vector<string>>(&benches)->multitoken()->default_value({"staging", "files", "loops", "execute"}, "staging files loops execute"),
+            "Benchmarks to run: staging, files, loops, execute")(
+            "channels", po::value<vector<size_t>>(&options.channels)->multitoken()->default_value({1, 2, 4}, "1 2 4"), "Channel counts")(
+            "samps", po::value<vector<size_t>>(&options.samps)->multitoken()->default_value({10000, 1000000}, "10000 1000000"), "Samples per channel")(
+            "cpu-format", po::value<string>(&options.cpu_format)->default_value("fc32"), "Host sample format: fc32, sc16, sc8")(
+            "rate", po::value<double>(&options.rate)->default_value(10e6), "Simulated sample rate (timestamps, and pacing with --paced)")(
+            "packet-samps", po::value<size_t>(&options.packet_samps)->default_value(1996), "Samples per simulated packet (the streamers' max_num_samps)")(
+            "spb", po::value<size_t>(&options.spb)->default_value(0), "Samples per send/recv call (0 = one packet)")(
+            "iterations", po::value<size_t>(&options.iterations)->default_value(10), "Timed runs per case; the median is reported")(
+            "paced", "Pace the simulated streamers at --rate instead of running as fast as the host allows")(
+            "dir", po::value<string>(&options.dir)->default_value(fs::temp_directory_path().string()), "Directory for the file benchmark")(
+            "port", po::value<uint16_t>(&options.port)->default_value(5599), "Local TCP port of txrx_server in the EXECUTE benchmark (+1 for its PUB port)")(
+            "server", po::value<string>(&options.server)->default_value((fs::path(argv[0]).parent_path() / "txrx_server").string()),
+            "txrx_server binary the EXECUTE benchmark starts with --sim")(
+            "verbose", "Keep UHD's info messages");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+    if (vm.contains("help")) {
+        std::cout << desc << std::endl;
+        return EXIT_SUCCESS;
+    }
+    options.paced = vm.contains("paced");
+    options.verbose = vm.contains("verbose");
+    if (options.channels.empty() or options.samps.empty() or options.packet_samps == 0 or options.rate <= 0) {
+        std::cerr << "Need channel counts, sample counts, a packet size and a rate" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (not options.verbose) {
+        // Every burst logs at info level, which would dominate the timings
+        uhd::log::set_console_level(uhd::log::warning);
+    }
+
+    for (const auto &bench: benches) {
+        if (bench == "staging") {
+            BenchStaging(options);
+        } else if (bench == "files") {
+            BenchFiles(options);
+        } else if (bench == "loops") {
+            BenchLoops(options);
+        } else if (bench == "execute") {
+            BenchExecute(options);
+        } else {
+            std::cerr << format("Unknown benchmark: {}", bench) << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    google::protobuf::ShutdownProtobufLibrary();
+    return EXIT_SUCCESS;
+}
@@ -1,20 +1,27 @@
 #include <atomic>
 #include <boost/algorithm/string.hpp>
 #include <boost/program_options.hpp>
+#include <chrono>
 #include <csignal>
+#include <cstring>
 #include <format>
 #include <future>
+#include <ranges>
 #include <uhd/convert.hpp>
 #include <uhd/exception.hpp>
 #include <uhd/usrp/multi_usrp.hpp>
 #include <uhd/utils/safe_main.hpp>
 #include <vector>
 
+#include "sample_arena.h"
+#include "sigmf_meta.h"
+#include "stream_recorder.h"
 #include "usrp_transceiver.h"
 #include "utils.h"
 
 namespace po = boost::program_options;
 namespace stdr = std::ranges;
+namespace stdv = std::views;
 
 using std::format;
 using std::string;
@@ -37,6 +44,10 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
     UsrpConfig config{};
     string args;
     double rate, freq;
+    size_t block_samps, num_blocks, arena_mb;
+    vector<double> tx_dgains, rx_dgains;
+    float tx_clip;
+    string trigger_ref;
     // Program description
     const string program_doc = "Simultaneous TX/RX samples from/to file.\nDesigned specifically for "
                                "multi-channel "
@@ -48,14 +59,14 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
     option("help,h", "Show this help message");
     option("args", po::value<string>(&args)->default_value("addr=192.168.180.2"), "USRP device address string");
     option("tx-files", po::value<vector<string>>(&config.tx_files)->multitoken()->default_value({"tx_data_fc32.bin"}, "tx_data_fc32.bin"),
-           "TX data files (fc32 format)");
+           "TX data files (--cpu-format)");
     option("rx-files", po::value<vector<string>>(&config.rx_files)->multitoken()->default_value({"rx_data_fc32.bin"}, "rx_data_fc32.bin"),
-           "RX data files (fc32 format)");
+           "RX data files (--cpu-format)");
     option("tx-ants", po::value<vector<string>>(&config.tx_ants)->multitoken()->default_value({"TX/RX"}, "TX/RX"), "TX antenna selection");
     option("rx-ants", po::value<vector<string>>(&config.rx_ants)->multitoken()->default_value({"RX2"}, "RX2"), "RX antenna selection");
     option("tx-channels", po::value<vector<size_t>>(&config.tx_channels)->multitoken()->default_value({0}, "0"), "TX channels (space separated)");
     option("rx-channels", po::value<vector<size_t>>(&config.rx_channels)->multitoken()->default_value({1}, "1"), "RX channels (space separated)");
-    option("spb", po::value<size_t>(&config.spb)->default_value(2500), "Samples per buffer");
+    option("spb", po::value<size_t>(&config.spb)->default_value(0), "Samples per send/recv call (0 = one full packet, the streamer's maximum)");
     option("rate", po::value<double>(&rate), "Sample rate (Hz)");
     option("tx-rates", po::value<vector<double>>(&config.tx_rates)->multitoken()->default_value({1e6}, "1e6"),
            "Tx Sample rate (Hz)")("rx-rates", po::value<vector<double>>(&config.rx_rates)->multitoken()->default_value({1e6}, "1e6"), "Rx Sample rate (Hz)");
@@ -69,7 +80,44 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
     //("rx-bw", po::value<double>(&config.rx_bw),
     //                      "RX Bandwidth (Hz)")("tx-bw", po::value<double>(&config.tx_bw), "TX Bandwidth (Hz)");
     option("delay", po::value<double>(&config.delay)->default_value(1), "Delay before start (seconds)");
+    option("tx-repeat", po::value<size_t>(&config.tx_repeat)->default_value(1), "Times the TX files are sent back-to-back in one burst (0 = loop until RX is done)");
     option("rx_samps", po::value<size_t>(&config.rx_samps)->default_value(5e6), "Number of samples to receive");
+    option("stream-rx", "Stream RX to the files while receiving instead of buffering the capture in memory (--rx_samps 0 records until Ctrl-C)");
+    option("block-samps", po::value<size_t>(&block_samps)->default_value(1 << 20), "Samples per channel in each recorder block (--stream-rx)");
+    option("num-blocks", po::value<size_t>(&num_blocks)->default_value(16), "Number of recorder blocks (--stream-rx)");
+    option("direct-io", "Write RX files with O_DIRECT, bypassing the page cache (--stream-rx)");
+    option("tx-preload", "Read the TX files into memory before the start, all channels concurrently, instead of mapping them");
+    option("sigmf", "Write a SigMF metadata sidecar (.sigmf-meta) next to each RX file, and a block index (.sigmf-index) with --stream-rx");
+    option("cpu-format", po::value<string>(&config.cpu_format)->default_value("fc32"), "Host sample format of the TX/RX files: fc32, sc16 or sc8");
+    option("otw-format", po::value<string>(&config.otw_format)->default_value("sc16"), "Over-the-wire sample format: sc16 or sc8");
+    option("tx-cpus", po::value<vector<size_t>>(&config.tx_cpus)->multitoken(), "CPUs the TX streaming thread is pinned to (space separated)");
+    option("rx-cpus", po::value<vector<size_t>>(&config.rx_cpus)->multitoken(), "CPUs the RX streaming thread is pinned to (space separated)");
+    option("thread-priority", po::value<float>(&config.thread_priority)->default_value(0), "SCHED_FIFO priority of the streaming threads in (0, 1]; 0 keeps the normal scheduler");
+    option("numa-node", po::value<int>(&config.numa_node)->default_value(-1), "NUMA node of the NIC: streaming threads allocate and RX buffers are placed there (-1 = any)");
+    option("rx-stream-channels", po::value<size_t>(&config.rx_channels_per_stream)->default_value(0),
+           "RX channels per streamer, each received on its own thread (0 = one streamer for all channels)");
+    option("no-fill-gaps", "Pack the samples received after an overflow instead of zero-filling the lost ones (keeps time alignment)");
+    option("sweep-freqs", po::value<vector<double>>(&config.sweep_freqs)->multitoken(), "Hop all channels over these frequencies (Hz) instead of one --rx_samps capture");
+    option("dwell", po::value<vector<double>>(&config.sweep_dwells)->multitoken()->default_value({1e-3}, "1e-3"), "Capture time per hop (s): one value for all hops or one per frequency");
+    option("settle-time", po::value<double>(&config.settle_time)->default_value(-1), "LO settling time after a retune (s); negative polls lo_locked, or leaves 1 ms per hop when sweeping");
+    option("dsp-tune", "Hop within the front-end bandwidth by moving only the DSP, without retuning the LO (--sweep-freqs)");
+    option("tx-stream-format", po::value<string>(&config.tx_stream_format), "Convert the TX files to this format on the host before streaming (e.g. sc16 for fc32 files)");
+    option("tx-dgains", po::value<vector<double>>(&tx_dgains)->multitoken(), "Digital gain (dB) applied on the host to each TX channel");
+    option("rx-dgains", po::value<vector<double>>(&rx_dgains)->multitoken(), "Digital gain (dB) applied on the host to each RX channel while receiving");
+    option("tx-clip", po::value<float>(&tx_clip)->default_value(0), "Clip TX I/Q to this level after the digital gain (full scale 1.0, 0 = no clipping)");
+    option("rx-decim", po::value<size_t>(&config.rx_decimation)->default_value(1), "Decimate RX on the host by this factor; --rx_samps counts decimated samples");
+    option("rx-mix-freqs", po::value<vector<double>>(&config.rx_mix_freqs)->multitoken(), "Offset (Hz) of the band each RX channel keeps, mixed to DC before decimating (--rx-decim)");
+    option("trigger", po::value<string>(&config.trigger_mode), "Keep only windows around detected bursts: power or correlation (--rx_samps is the room for all windows)");
+    option("trigger-threshold", po::value<double>(&config.trigger_threshold)->default_value(-30), "Trigger level: mean power in dBFS, or normalized correlation in (0, 1]");
+    option("trigger-window", po::value<size_t>(&config.trigger_window)->default_value(64), "Samples the power trigger averages over");
+    option("trigger-ref", po::value<string>(&trigger_ref), "fc32 file with the preamble the correlation trigger looks for");
+    option("trigger-pre", po::value<size_t>(&config.trigger_pre)->default_value(0), "Samples kept before each trigger");
+    option("trigger-post", po::value<size_t>(&config.trigger_post)->default_value(10000), "Samples kept from each trigger on");
+    option("trigger-max", po::value<size_t>(&config.trigger_max)->default_value(0), "Stop after this many triggers (0 = when --rx_samps is full)");
+    option("trigger-channel", po::value<size_t>(&config.trigger_channel)->default_value(0), "RX channel (index into --rx-channels) the trigger watches");
+    option("trigger-timeout", po::value<double>(&config.trigger_timeout)->default_value(0), "Stop a triggered capture after this many seconds (0 = no limit)");
+    option("arena-mb", po::value<size_t>(&arena_mb)->default_value(0), "Huge-page arena (MiB) the sample buffers are taken from, pre-faulted at startup (0 = heap)");
+    option("arena-lock", "mlock the sample arena (--arena-mb)");
     option("clock-source", po::value<string>(&config.clock_source)->default_value("internal"), "Reference: internal, external, gpsdo");
     option("time-source", po::value<string>(&config.time_source)->default_value("internal"), "Time Source");
 
@@ -110,6 +158,23 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
         UHD_LOG_INFO("CONFIG", format("Set Tx and Rx freq to {:.3f} Mhz", rate / 1e6))
     }
 
+    config.sweep_dsp_tune = vm.contains("dsp-tune");
+    config.rx_fill_gaps = not vm.contains("no-fill-gaps");
+    if (not tx_dgains.empty() or tx_clip > 0) {
+        tx_dgains.resize(config.tx_channels.size(), tx_dgains.empty() ? 0 : tx_dgains.back());
+        config.tx_corrections = stdr::to<vector>(tx_dgains | stdv::transform([&](double gain_db) { return MakeCorrection(gain_db, 0, {0, 0}, tx_clip); }));
+    }
+    config.rx_corrections = stdr::to<vector>(rx_dgains | stdv::transform([](double gain_db) { return MakeCorrection(gain_db); }));
+    if (config.sweep_freqs.empty()) {
+        config.sweep_dwells.clear();
+    }
+    if (not trigger_ref.empty()) {
+        MappedFile reference(trigger_ref, sizeof(complexf));
+        const auto samples = reference.view();
+        config.trigger_reference.resize(samples.size() / sizeof(complexf));
+        std::memcpy(config.trigger_reference.data(), samples.data(), config.trigger_reference.size() * sizeof(complexf));
+    }
+
     // Create UsrpTransceiver instance
     UsrpTransceiver transceiver(args);
 
@@ -117,29 +182,138 @@ int UHD_SAFE_MAIN(int argc, char *argv[]) {
         UHD_LOG_ERROR("SYSTEM", "Invalid configuration provided");
         return EXIT_FAILURE;
     }
+
+    // Fault the buffer memory in now rather than right before streaming; the NUMA node is validated by now
+    SampleArena::Instance().Configure(arena_mb << 20, vm.contains("arena-lock"), config.numa_node);
     // for (int i = 0; i < 2; i++)
     {
         transceiver.ApplyConfiguration(config, stop_signal_called);
         // Start transmission thread
-        auto TxBuffer = LoadFileToBuffer(config);
+        // TX files are mapped rather than read, so transmission starts without loading them first,
+        // unless --tx-preload reads them all (concurrently) up front for disks page faults cannot keep up with
+        std::vector<MappedFile> TxFiles;
+        std::vector<SampleBuffer> TxLoaded;
+        std::vector<TxChannelView> TxViews;
+        if (vm.contains("tx-preload")) {
+            TxLoaded = LoadFileToBuffer(config);
+            TxViews.assign(TxLoaded.begin(), TxLoaded.end());
+        } else {
+            TxFiles = MapFilesToBuffer(config);
+            for (const auto &file: TxFiles) {
+                TxViews.push_back(file.view());
+            }
+        }
+        // Converted / corrected copies are made before the start time is set, so they do not eat into the delay
+        std::vector<SampleBuffer> TxStaged;
+        if (NeedsTxStaging(config)) {
+            TxStaged = StageTxSamples(TxViews, config);
+            TxViews.assign(TxStaged.begin(), TxStaged.end());
+        }
+        transceiver.CalculateTransmissionTime();
 
         UHD_LOG_INFO("SYSTEM", "Starting transmission thread...");
-        auto transmit_thread =
-                std::async(std::launch::async, &UsrpTransceiver::TransmitFromBuffer, &transceiver, std::ref(TxBuffer), std::ref(stop_signal_called));
+        // TX stops once reception is done (a looping transmission would otherwise never end)
+        std::atomic<bool> tx_stop{false};
+        auto transmit_thread = std::async(std::launch::async, &UsrpTransceiver::TransmitFromBuffer, &transceiver, std::cref(TxViews), std::ref(tx_stop));
+        // A finite replay that outlasts reception still stops on Ctrl-C
+        auto finish_transmission = [&] {
+            if (config.tx_repeat == 0) {
+                tx_stop = true;
+            }
+            while (transmit_thread.wait_for(std::chrono::milliseconds(10)) != std::future_status::ready) {
+                if (stop_signal_called) {
+                    tx_stop = true;
+                }
+            }
+        };
+
+        try {
+            if (not config.trigger_mode.empty()) {
+                // Windows are kept back-to-back in one buffer per channel; the window table locates them
+                const size_t sample_size = SampleSize(config.cpu_format);
+                std::vector<SampleBuffer> RxBuffer(config.rx_channels.size());
+                std::vector<std::byte *> rx_ptrs;
+                for (auto &buff: RxBuffer) {
+                    buff.resize(config.rx_samps * sample_size);
+                    rx_ptrs.push_back(buff.data());
+                }
+                auto receive_future = std::async(std::launch::async, &UsrpTransceiver::ReceiveTriggered, &transceiver, std::cref(rx_ptrs), std::ref(stop_signal_called));
+                auto windows = receive_future.get();
 
-        // Launch receive operation to get buffer via future
-        auto receive_future = std::async(std::launch::async, &UsrpTransceiver::ReceiveToBuffer, &transceiver, std::ref(stop_signal_called));
+                finish_transmission();
 
-        // Wait for transmission to complete
-        transmit_thread.wait();
+                const size_t kept = windows.empty() ? 0 : windows.back().offset + windows.back().nsamps;
+                for (auto &buff: RxBuffer) {
+                    buff.resize(kept * sample_size);
+                }
+                WriteBufferToFile(config, RxBuffer);
+                WriteTriggerTable(config.rx_files.front() + ".trigger.csv", windows);
+            } else if (not config.sweep_freqs.empty()) {
+                // Hops are captured back-to-back into one buffer per channel; the segment table locates them
+                const size_t sweep_bytes = SweepSamples(config) * SampleSize(config.cpu_format);
+                std::vector<SampleBuffer> RxBuffer(config.rx_channels.size());
+                std::vector<std::byte *> rx_ptrs;
+                for (auto &buff: RxBuffer) {
+                    buff.resize(sweep_bytes);
+                    rx_ptrs.push_back(buff.data());
+                }
+                auto receive_future = std::async(std::launch::async, &UsrpTransceiver::ReceiveSweep, &transceiver, std::cref(rx_ptrs), std::ref(stop_signal_called));
+                auto segments = receive_future.get();
 
-        // Get the received buffer from the future
-        auto RxBuffer = receive_future.get();
+                finish_transmission();
 
-        // Write the received buffer to files
-        WriteBufferToFile(config, RxBuffer);
+                WriteBufferToFile(config, RxBuffer);
+                WriteSweepTable(config.rx_files.front() + ".sweep.csv", segments);
+            } else if (vm.contains("stream-rx")) {
+                // Received blocks are written to the files by the recorder while the radio is still running
+                StreamRecorder recorder(config.rx_files, SampleSize(config.cpu_format), block_samps, num_blocks, vm.contains("direct-io"), config.numa_node,
+                                        vm.contains("sigmf") ? SigmfChannels(config) : std::vector<SigmfChannel>{});
+                auto receive_future = std::async(std::launch::async, &UsrpTransceiver::ReceiveToBlocks, &transceiver,
+                                                 RxBlockAcquire([&] { return recorder.Acquire(); }),
+                                                 RxBlockCommit([&](const RxBlock &block, size_t nsamps, const uhd::time_spec_t &time_spec) {
+                                                     recorder.Commit(block, nsamps, time_spec);
+                                                 }),
+                                                 std::ref(stop_signal_called));
+
+                receive_future.get();
+                recorder.Finish(GapAnnotations(transceiver.Stats().rx_gaps, config.rx_fill_gaps));
+
+                // Wait for transmission to complete
+                finish_transmission();
+            } else {
+                // Launch receive operation to get buffer via future
+                auto receive_future = std::async(std::launch::async, &UsrpTransceiver::ReceiveToBuffer, &transceiver, std::ref(stop_signal_called));
+
+                // Get the received buffer from the future
+                auto RxBuffer = receive_future.get();
+
+                // Wait for transmission to complete
+                finish_transmission();
+
+                // Write the received buffer to files
+                WriteBufferToFile(config, RxBuffer);
+                if (vm.contains("sigmf")) {
+                    // One capture from the first sample the device delivered
+                    const uhd::time_spec_t first_sample = transceiver.start_time + uhd::time_spec_t(transceiver.RxMetrics().first_sample_offset);
+                    const auto gaps = GapAnnotations(transceiver.Stats().rx_gaps, config.rx_fill_gaps);
+                    for (const auto &channel: SigmfChannels(config)) {
+                        WriteSigmfMeta(channel, {{0, first_sample}}, gaps);
+                    }
+                }
+            }
+        } catch (...) {
+            tx_stop = true;
+            throw;
+        }
     }
     stop_signal_called = true;
+    if (auto stats = transceiver.Stats(); stats.rx_overflows > 0 or stats.tx_underflows > 0) {
+        UHD_LOG_WARNING("SYSTEM", format("RX: {} overflows, {} samples lost in {} gaps; TX: {} underflows", stats.rx_overflows, stats.rx_dropped,
+                                         stats.rx_gaps.size(), stats.tx_underflows));
+        for (const auto &gap: stats.rx_gaps) {
+            UHD_LOG_INFO("SYSTEM", format("RX gap at sample {}: {} samples", gap.offset, gap.nsamps));
+        }
+    }
     UHD_LOG_INFO("SYSTEM", "TX-RX operation finished!")
 
     return EXIT_SUCCESS;
@@ -1,8 +1,19 @@
 #include "usrp_transceiver.h"
+#include "rx_decimator.h"
+#include "rx_trigger.h"
+#include "sample_ring.h"
+#include "thread_utils.h"
 
+#include <barrier>
 #include <chrono>
+#include <cstring>
+#include <uhd/convert.hpp>
 #include <filesystem>
+#include <future>
+#include <thread>
+#include <numeric>
 #include <ranges>
+#include <utility>
 
 
 namespace fs = std::filesystem;
@@ -16,16 +27,104 @@ using std::vector;
 using namespace std::chrono_literals;
 
 
+namespace {
+    constexpr double kSweepSettle = 1e-3; // Guard between a hop's retune and its capture when settle_time is negative
+    constexpr size_t kSweepLookahead = 4; // Hops kept queued on the device ahead of the one being received
+    constexpr auto kLockTimeout = 1s; // Upper bound for polling lo_locked after a retune
+    constexpr double kRxResumeLead = 0.05; // Lead (s) for the stream command reissued after an overflow
+
+    double SweepDwell(const UsrpConfig &config, size_t hop) { return config.sweep_dwells.size() == 1 ? config.sweep_dwells[0] : config.sweep_dwells[hop]; }
+
+    size_t DwellSamples(const UsrpConfig &config, size_t hop) { return static_cast<size_t>(std::llround(SweepDwell(config, hop) * config.rx_rates[0])); }
+} // namespace
+
+double SweepSettle(const UsrpConfig &config) { return config.settle_time >= 0 ? config.settle_time : kSweepSettle; }
+
+size_t SweepSamples(const UsrpConfig &config) {
+    size_t total = 0;
+    for (size_t hop = 0; hop < config.sweep_freqs.size(); ++hop) {
+        total += DwellSamples(config, hop);
+    }
+    return total;
+}
+
+size_t SampleSize(const std::string &cpu_format) {
+    if (cpu_format != "fc32" and cpu_format != "sc16" and cpu_format != "sc8") {
+        throw std::invalid_argument(format("Unsupported CPU format: {}", cpu_format));
+    }
+    return uhd::convert::get_bytes_per_item(cpu_format);
+}
+
+const string &TxStreamFormat(const UsrpConfig &config) { return config.tx_stream_format.empty() ? config.cpu_format : config.tx_stream_format; }
+
+bool NeedsTxStaging(const UsrpConfig &config) {
+    return TxStreamFormat(config) != config.cpu_format or stdr::any_of(config.tx_corrections, [](const auto &correction) { return not correction.Identity(); });
+}
+
+std::vector<SampleBuffer> StageTxSamples(const std::vector<TxChannelView> &views, const UsrpConfig &config, bool interleaved) {
+    const size_t num_ch = config.tx_channels.size();
+    const size_t in_size = SampleSize(config.cpu_format);
+    const string &out_format = TxStreamFormat(config);
+    const size_t nsamps = views.empty() ? 0 : views[0].size() / (in_size * (interleaved ? num_ch : 1));
+
+    std::vector<SampleBuffer> staged(num_ch);
+    for (auto &buff: staged) {
+        buff.resize(nsamps * SampleSize(out_format));
+    }
+    std::vector<SampleBuffer> split;
+    std::vector<TxChannelView> sources = views;
+    if (interleaved) {
+        if (not NeedsTxStaging(config)) {
+            DeinterleaveChannels(views[0].data(), in_size, nsamps, stdr::to<vector>(staged | stdv::transform([](auto &buff) { return buff.data(); })));
+            return staged;
+        }
+        split.resize(num_ch);
+        for (auto &buff: split) {
+            buff.resize(nsamps * in_size);
+        }
+        DeinterleaveChannels(views[0].data(), in_size, nsamps, stdr::to<vector>(split | stdv::transform([](auto &buff) { return buff.data(); })));
+        sources.assign(split.begin(), split.end());
+    }
+    for (size_t ch = 0; ch < num_ch; ++ch) {
+        const SampleCorrection correction = ch < config.tx_corrections.size() ? config.tx_corrections[ch] : SampleCorrection{};
+        ProcessSamples(sources[ch].data(), config.cpu_format, staged[ch].data(), out_format, nsamps, correction);
+    }
+    return staged;
+}
+
 UsrpTransceiver::UsrpTransceiver(const std::string &args) {
     usrp = uhd::usrp::multi_usrp::make(args);
     UHD_LOG_INFO("UsrpTransceiver", format("Creating USRP device with args: {}", args));
+
+    // Channels are numbered across motherboards in order, as many per motherboard as its subdev spec has
+    for (size_t mboard = 0; mboard < usrp->get_num_mboards(); ++mboard) {
+        tx_mboards.insert(tx_mboards.end(), usrp->get_tx_subdev_spec(mboard).size(), mboard);
+        rx_mboards.insert(rx_mboards.end(), usrp->get_rx_subdev_spec(mboard).size(), mboard);
+    }
+    UHD_LOG_DEBUG("UsrpTransceiver", format("Host sample kernels: {}", KernelIsa()));
+}
+
+UsrpTransceiver::UsrpTransceiver(size_t num_tx_channels, size_t num_rx_channels, TxStreamFactory make_tx_stream, RxStreamFactory make_rx_stream) :
+    tx_mboards(num_tx_channels, 0), rx_mboards(num_rx_channels, 0), make_tx_stream(std::move(make_tx_stream)), make_rx_stream(std::move(make_rx_stream)) {
+    UHD_LOG_INFO("UsrpTransceiver", format("Simulated streamers with {} TX and {} RX channels", num_tx_channels, num_rx_channels));
+}
+
+uhd::time_spec_t UsrpTransceiver::DeviceTime() const {
+    if (usrp) {
+        return usrp->get_time_now();
+    }
+    return {std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count()};
 }
 
+double UsrpTransceiver::RxRate() const { return usrp ? usrp->get_rx_rate(usrp_config.rx_channels.front()) : usrp_config.rx_rates.front(); }
+
+double UsrpTransceiver::TxRate() const { return usrp ? usrp->get_tx_rate(usrp_config.tx_channels.front()) : usrp_config.tx_rates.front(); }
+
 
 bool UsrpTransceiver::ValidateConfiguration(const UsrpConfig &config, const bool require_file) {
     // Check channel validity
-    size_t total_tx_channels = usrp->get_tx_num_channels();
-    size_t total_rx_channels = usrp->get_rx_num_channels();
+    size_t total_tx_channels = tx_mboards.size();
+    size_t total_rx_channels = rx_mboards.size();
 
     {
         std::ostringstream oss;
@@ -50,7 +149,79 @@ bool UsrpTransceiver::ValidateConfiguration(const UsrpConfig &config, const bool
 
     if (stdr::any_of(config.rx_channels, [&](const auto &ch) { return ch >= total_rx_channels; })) {
         UHD_LOG_ERROR("CHECK", "RX channels are not supported");
+        return false;
+    }
+    if (config.cpu_format != "fc32" and config.cpu_format != "sc16" and config.cpu_format != "sc8") {
+        UHD_LOG_ERROR("CHECK", format("Unsupported CPU format: {}", config.cpu_format));
+        return false;
+    }
+    if (config.otw_format != "sc16" and config.otw_format != "sc8") {
+        UHD_LOG_ERROR("CHECK", format("Unsupported OTW format: {}", config.otw_format));
+        return false;
+    }
+    if (not config.tx_stream_format.empty() and config.tx_stream_format != "fc32" and config.tx_stream_format != "sc16" and config.tx_stream_format != "sc8") {
+        UHD_LOG_ERROR("CHECK", format("Unsupported TX stream format: {}", config.tx_stream_format));
+        return false;
+    }
+    if ((not config.tx_corrections.empty() and config.tx_corrections.size() != config.tx_channels.size()) or
+        (not config.rx_corrections.empty() and config.rx_corrections.size() != config.rx_channels.size())) {
+        UHD_LOG_ERROR("CHECK", "Sample corrections need one entry per channel");
+        return false;
+    }
+    if (config.rx_decimation == 0 or (config.rx_decimation > 1 and not config.sweep_freqs.empty())) {
+        UHD_LOG_ERROR("CHECK", "RX decimation must be at least 1 and cannot be combined with a sweep");
+        return false;
+    }
+    if (not config.rx_mix_freqs.empty() and config.rx_mix_freqs.size() != config.rx_channels.size()) {
+        UHD_LOG_ERROR("CHECK", "RX mixer frequencies need one entry per channel");
+        return false;
+    }
+    auto negative_clip = [](const SampleCorrection &correction) { return correction.clip < 0; };
+    if (stdr::any_of(config.tx_corrections, negative_clip) or stdr::any_of(config.rx_corrections, negative_clip)) {
+        UHD_LOG_ERROR("CHECK", "Clip levels must not be negative");
+        return false;
+    }
+    if (config.thread_priority < 0 or config.thread_priority > 1) {
+        UHD_LOG_ERROR("CHECK", format("Thread priority must be in [0, 1], got {}", config.thread_priority));
+        return false;
+    }
+    if (config.numa_node < -1 or config.numa_node >= kMaxNumaNodes) {
+        UHD_LOG_ERROR("CHECK", format("Invalid NUMA node: {}", config.numa_node));
+        return false;
+    }
+    if (not config.trigger_mode.empty()) {
+        if (config.trigger_mode != "power" and config.trigger_mode != "correlation") {
+            UHD_LOG_ERROR("CHECK", format("Unknown trigger mode: {}", config.trigger_mode));
+            return false;
+        }
+        if (config.trigger_mode == "correlation" ? config.trigger_reference.empty() : config.trigger_window == 0) {
+            UHD_LOG_ERROR("CHECK", "Power trigger needs a window, correlation trigger a reference");
+            return false;
+        }
+        if (config.trigger_pre + config.trigger_post == 0 or config.trigger_pre + config.trigger_post > config.rx_samps) {
+            UHD_LOG_ERROR("CHECK", "Trigger windows must be non-empty and fit into rx_samps");
+            return false;
+        }
+        if (config.trigger_channel >= config.rx_channels.size() or not config.sweep_freqs.empty() or config.trigger_timeout < 0) {
+            UHD_LOG_ERROR("CHECK", "Trigger needs a valid RX channel and a non-negative timeout, and cannot be combined with a sweep");
+            return false;
+        }
+    }
+    if (not config.sweep_freqs.empty()) {
+        if (config.sweep_dwells.size() != 1 and config.sweep_dwells.size() != config.sweep_freqs.size()) {
+            UHD_LOG_ERROR("CHECK", "Sweep needs one dwell time, or one per frequency");
+            return false;
+        }
+        if (stdr::any_of(config.sweep_dwells, [](double dwell) { return dwell <= 0; }) or config.rx_channels.empty() or config.rx_rates.empty()) {
+            UHD_LOG_ERROR("CHECK", "Sweep needs positive dwell times and at least one RX channel");
+            return false;
+        }
+        if (not usrp) {
+            UHD_LOG_ERROR("CHECK", "Sweeps retune the device and cannot run on simulated streamers");
+            return false;
+        }
     }
+
     std::vector<size_t> tx_sizes = {config.tx_channels.size(), config.tx_ants.size(), config.tx_gains.size(), config.tx_freqs.size()};
     if (stdr::adjacent_find(tx_sizes, std::not_equal_to{}) != tx_sizes.end()) {
         UHD_LOG_ERROR("CHECK", "Tx configurations mismatch!");
@@ -93,139 +264,373 @@ bool UsrpTransceiver::ValidateConfiguration(const UsrpConfig &config, const bool
 }
 
 void UsrpTransceiver::ApplyConfiguration(const UsrpConfig &config, std::atomic<bool> &stop_signal) {
-    UHD_LOG_INFO("CONFIG", format("====== Configuring Tx ======"))
-    // Configure TX channels
-    for (auto index = 0; index < config.tx_channels.size(); ++index) {
-        auto ch = config.tx_channels[index];
-
-
-        UHD_LOG_INFO("CONFIG", format("====== Tx Channel {}", ch))
-
-        // gain
-        usrp->set_tx_gain(config.tx_gains[index], ch);
-        UHD_LOG_INFO("CONFIG", format("Gain: {:.2f} dB", usrp->get_tx_gain(ch)))
-
-        // ant
-        usrp->set_tx_antenna(config.tx_ants[index], ch);
-        UHD_LOG_INFO("CONFIG", format("Ant : {}", usrp->get_tx_antenna(ch)));
-
-        // rate
-        usrp->set_tx_rate(config.tx_rates[index], ch);
-        UHD_LOG_INFO("CONFIG", std::format("Rate: {:.3f} Msps", usrp->get_tx_rate(ch) / 1e6));
+    // Streamers only depend on the channels and formats (their cache key) and on the sample rates
+    if (config.tx_rates != this->usrp_config.tx_rates or config.rx_rates != this->usrp_config.rx_rates) {
+        std::lock_guard lock(stream_mutex);
+        tx_streamers.clear();
+        rx_streamers.clear();
+    }
+    // Simulated streamers: there is no device to set up
+    if (not usrp) {
+        this->usrp_config = config;
+        return;
     }
-    UHD_LOG_INFO("CONFIG", format("============================"))
 
-    // Configure RX channels
-    UHD_LOG_INFO("CONFIG", format("====== Configuring Rx ======"))
+    // Timed retunes of a schedule that failed before their locks were checked are tuned again
+    for (size_t ch: std::exchange(retuned_tx, {})) {
+        tx_settings[ch].freq.reset();
+    }
+    for (size_t ch: std::exchange(retuned_rx, {})) {
+        rx_settings[ch].freq.reset();
+    }
 
+    // Channels are configured per motherboard in parallel. Cache entries are created up front,
+    // so every task only touches the entries of its own channels
+    const size_t num_mboards = usrp->get_num_mboards();
+    std::vector<std::vector<size_t>> tx_indices(num_mboards), rx_indices(num_mboards);
+    for (auto index = 0; index < config.tx_channels.size(); ++index) {
+        tx_settings[config.tx_channels[index]];
+        tx_indices[tx_mboards.at(config.tx_channels[index])].push_back(index);
+    }
     for (auto index = 0; index < config.rx_channels.size(); ++index) {
-        auto ch = config.rx_channels[index];
+        rx_settings[config.rx_channels[index]];
+        rx_indices[rx_mboards.at(config.rx_channels[index])].push_back(index);
+    }
+    std::vector<size_t> mboards;
+    for (size_t mboard = 0; mboard < num_mboards; ++mboard) {
+        if (not tx_indices[mboard].empty() or not rx_indices[mboard].empty()) {
+            mboards.push_back(mboard);
+        }
+    }
 
+    std::vector<size_t> mboard_changes(num_mboards, 0);
+    ForEachMboard(mboards, [&](size_t mboard) {
+        size_t &changes = mboard_changes[mboard];
+
+        // Configure TX channels
+        for (auto index: tx_indices[mboard]) {
+            auto ch = config.tx_channels[index];
+            auto &applied = tx_settings.at(ch);
+
+            // gain
+            if (applied.gain != config.tx_gains[index]) {
+                usrp->set_tx_gain(config.tx_gains[index], ch);
+                applied.gain = config.tx_gains[index];
+                UHD_LOG_INFO("CONFIG", format("Tx Channel {} Gain: {:.2f} dB", ch, usrp->get_tx_gain(ch)))
+                ++changes;
+            }
 
-        UHD_LOG_INFO("CONFIG", format("====== Rx Channel {}", ch))
+            // ant
+            if (applied.ant != config.tx_ants[index]) {
+                usrp->set_tx_antenna(config.tx_ants[index], ch);
+                applied.ant = config.tx_ants[index];
+                UHD_LOG_INFO("CONFIG", format("Tx Channel {} Ant : {}", ch, usrp->get_tx_antenna(ch)));
+                ++changes;
+            }
 
-        usrp->set_rx_gain(config.rx_gains[index], ch);
-        UHD_LOG_INFO("CONFIG", format("Gain: {:.1f} dB", usrp->get_rx_gain(ch)))
+            // rate
+            if (applied.rate != config.tx_rates[index]) {
+                usrp->set_tx_rate(config.tx_rates[index], ch);
+                applied.rate = config.tx_rates[index];
+                UHD_LOG_INFO("CONFIG", std::format("Tx Channel {} Rate: {:.3f} Msps", ch, usrp->get_tx_rate(ch) / 1e6));
+                ++changes;
+            }
+        }
 
+        // Configure RX channels
+        for (auto index: rx_indices[mboard]) {
+            auto ch = config.rx_channels[index];
+            auto &applied = rx_settings.at(ch);
 
-        usrp->set_rx_antenna(config.rx_ants[index], ch);
-        UHD_LOG_INFO("CONFIG", format("Ant : {}", usrp->get_rx_antenna(ch)))
+            if (applied.gain != config.rx_gains[index]) {
+                usrp->set_rx_gain(config.rx_gains[index], ch);
+                applied.gain = config.rx_gains[index];
+                UHD_LOG_INFO("CONFIG", format("Rx Channel {} Gain: {:.1f} dB", ch, usrp->get_rx_gain(ch)))
+                ++changes;
+            }
 
-        // rate
-        usrp->set_rx_rate(config.rx_rates[index], ch);
-        UHD_LOG_INFO("CONFIG", std::format("Rate: {:.3f} Msps", usrp->get_rx_rate(ch) / 1e6));
-    }
-    UHD_LOG_INFO("CONFIG", format("============================"))
+            if (applied.ant != config.rx_ants[index]) {
+                usrp->set_rx_antenna(config.rx_ants[index], ch);
+                applied.ant = config.rx_ants[index];
+                UHD_LOG_INFO("CONFIG", format("Rx Channel {} Ant : {}", ch, usrp->get_rx_antenna(ch)))
+                ++changes;
+            }
+
+            // rate
+            if (applied.rate != config.rx_rates[index]) {
+                usrp->set_rx_rate(config.rx_rates[index], ch);
+                applied.rate = config.rx_rates[index];
+                UHD_LOG_INFO("CONFIG", std::format("Rx Channel {} Rate: {:.3f} Msps", ch, usrp->get_rx_rate(ch) / 1e6));
+                ++changes;
+            }
+        }
+    });
+    size_t changes = std::reduce(mboard_changes.begin(), mboard_changes.end());
 
     if (not(this->usrp_config.clock_source == config.clock_source and this->usrp_config.time_source == config.time_source)) {
         ApplyTimeSync(config, stop_signal);
+        ++changes;
     }
 
-    if (not(this->usrp_config.tx_freqs == config.tx_freqs and this->usrp_config.rx_freqs == config.rx_freqs)) {
-        ApplyTuneRequest(config);
-    }
+    changes += ApplyTuneRequest(config);
     this->usrp_config = config;
+
+    UHD_LOG_INFO("CONFIG", (changes == 0 ? string("Configuration unchanged") : format("Configuration applied, {} settings changed", changes)))
 }
 
 void UsrpTransceiver::CalculateTransmissionTime() {
-    auto now = usrp->get_time_now();
+    auto now = DeviceTime();
     start_time = now + uhd::time_spec_t(this->usrp_config.delay);
     UHD_LOG_INFO("SYSTEM", std::format("Current time: {:.3f} s", now.get_real_secs()));
     UHD_LOG_INFO("SYSTEM", std::format("Start time: {:.3f} s", start_time.get_real_secs()));
 }
 
+void UsrpTransceiver::ScheduleAfter(const uhd::time_spec_t &previous_end, double lead) {
+    auto earliest = DeviceTime() + uhd::time_spec_t(lead);
+    start_time = previous_end > earliest ? previous_end : earliest;
+    UHD_LOG_INFO("SYSTEM", std::format("Back-to-back start time: {:.6f} s (previous burst ended at {:.6f} s)", start_time.get_real_secs(),
+                                       previous_end.get_real_secs()));
+}
 
-void UsrpTransceiver::ApplyTuneRequest(const UsrpConfig &config) {
-    auto now = usrp->get_time_now();
-    UHD_LOG_INFO("CONFIG", "Start Sync tune Request for Tx and Rx")
-    usrp->set_command_time(uhd::time_spec_t(0.1) + now, uhd::usrp::multi_usrp::ALL_MBOARDS);
+uhd::time_spec_t UsrpTransceiver::BurstEndTime() const {
+    double duration = 0;
+    if (not usrp_config.sweep_freqs.empty()) {
+        for (size_t hop = 0; hop < usrp_config.sweep_freqs.size(); ++hop) {
+            duration += SweepSettle(usrp_config) + SweepDwell(usrp_config, hop);
+        }
+    } else if (not usrp_config.trigger_mode.empty()) {
+        duration = usrp_config.trigger_timeout;
+    } else if (not usrp_config.rx_channels.empty()) {
+        duration = DeviceRxSamples() / RxRate();
+    }
+    if (not usrp_config.tx_channels.empty() and usrp_config.tx_repeat > 0) {
+        duration = std::max(duration, usrp_config.tx_samps * usrp_config.tx_repeat / TxRate());
+    }
+    return start_time + uhd::time_spec_t(duration);
+}
+
+
+size_t UsrpTransceiver::ApplyTuneRequest(const UsrpConfig &config) {
+    std::vector<std::pair<size_t, double>> tx_tunes, rx_tunes;
     for (const auto &[ch, freq_]: stdv::zip(config.tx_channels, config.tx_freqs)) {
-        uhd::tune_request_t tune_req(freq_);
-        tune_req.args = uhd::device_addr_t("mode_n=integer");
-        usrp->set_tx_freq(tune_req, ch);
+        if (tx_settings[ch].freq != freq_) {
+            tx_tunes.emplace_back(ch, freq_);
+        }
     }
     for (const auto &[ch, freq_]: stdv::zip(config.rx_channels, config.rx_freqs)) {
-        uhd::tune_request_t tune_req(freq_);
-        tune_req.args = uhd::device_addr_t("mode_n=integer");
-        usrp->set_rx_freq(tune_req, ch);
+        if (rx_settings[ch].freq != freq_) {
+            rx_tunes.emplace_back(ch, freq_);
+        }
+    }
+    if (tx_tunes.empty() and rx_tunes.empty()) {
+        return 0;
     }
 
-    usrp->clear_command_time(uhd::usrp::multi_usrp::ALL_MBOARDS);
+    // Every motherboard queues the tune for the same device time; the calls themselves run in parallel
+    const size_t num_mboards = usrp->get_num_mboards();
+    std::vector<std::vector<std::pair<size_t, double>>> tx_mboard_tunes(num_mboards), rx_mboard_tunes(num_mboards);
+    for (const auto &tune: tx_tunes) {
+        tx_mboard_tunes[tx_mboards.at(tune.first)].push_back(tune);
+    }
+    for (const auto &tune: rx_tunes) {
+        rx_mboard_tunes[rx_mboards.at(tune.first)].push_back(tune);
+    }
+    std::vector<size_t> mboards;
+    for (size_t mboard = 0; mboard < num_mboards; ++mboard) {
+        if (not tx_mboard_tunes[mboard].empty() or not rx_mboard_tunes[mboard].empty()) {
+            mboards.push_back(mboard);
+        }
+    }
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    const auto tune_time = usrp->get_time_now() + uhd::time_spec_t(0.1);
+    UHD_LOG_INFO("CONFIG", "Start Sync tune Request for Tx and Rx")
+    ForEachMboard(mboards, [&](size_t mboard) {
+        usrp->set_command_time(tune_time, mboard);
+        for (const auto &[ch, freq_]: tx_mboard_tunes[mboard]) {
+            uhd::tune_request_t tune_req(freq_);
+            tune_req.args = uhd::device_addr_t("mode_n=integer");
+            usrp->set_tx_freq(tune_req, ch);
+        }
+        for (const auto &[ch, freq_]: rx_mboard_tunes[mboard]) {
+            uhd::tune_request_t tune_req(freq_);
+            tune_req.args = uhd::device_addr_t("mode_n=integer");
+            usrp->set_rx_freq(tune_req, ch);
+        }
+        usrp->clear_command_time(mboard);
+    });
+    for (const auto &[ch, freq_]: tx_tunes) {
+        tx_settings[ch].lo = freq_;
+    }
+    for (const auto &[ch, freq_]: rx_tunes) {
+        rx_settings[ch].lo = freq_;
+    }
+
+    // Wait for the timed tune to execute, plus settle_time if given; otherwise CheckLocks polls until the LOs lock
+    auto until_tune = std::chrono::duration<double>((tune_time - usrp->get_time_now()).get_real_secs() + std::max(config.settle_time, 0.0));
+    if (until_tune.count() > 0) {
+        std::this_thread::sleep_for(until_tune);
+    }
 
-    for (const size_t ch: config.tx_channels) {
+    for (const auto &[ch, freq_]: tx_tunes) {
         UHD_LOG_INFO("CONFIG", std::format("Tx channel {} freq set to {:.3f} MHz", ch, usrp->get_tx_freq(ch) / 1e6));
     }
-    for (const size_t ch: config.rx_channels) {
+    for (const auto &[ch, freq_]: rx_tunes) {
         UHD_LOG_INFO("CONFIG", std::format("Rx channel {} freq set to {:.3f} MHz", ch, usrp->get_rx_freq(ch) / 1e6));
     }
 
+    // Check LO and Ref lock status
+    UHD_LOG_INFO("SYSTEM", "Checking LO and REF lock status...");
+    const auto channels = [](const auto &tunes) { return stdr::to<vector>(tunes | stdv::keys); };
+    const auto now = std::chrono::steady_clock::now();
+    CheckLocks(channels(tx_tunes), channels(rx_tunes), config.clock_source, config.settle_time < 0 ? now + kLockTimeout : now);
 
-    // Check LO lock status
-    UHD_LOG_INFO("SYSTEM", "Checking LO lock status...");
+    // Only remembered once locked, so a failed tune is retried next time
+    for (const auto &[ch, freq_]: tx_tunes) {
+        tx_settings[ch].freq = freq_;
+    }
+    for (const auto &[ch, freq_]: rx_tunes) {
+        rx_settings[ch].freq = freq_;
+    }
+    return tx_tunes.size() + rx_tunes.size();
+}
 
-    // Check TX LO lock
-    for (size_t ch: config.tx_channels) {
-        if (auto sensor_names = usrp->get_tx_sensor_names(ch); std::ranges::find(sensor_names, "lo_locked") != sensor_names.end()) {
-            auto lo_locked = usrp->get_tx_sensor("lo_locked", ch);
-            UHD_LOG_INFO("SYSTEM", format("Checking Tx(ch={}): {}", ch, lo_locked.to_pp_string()));
-            UHD_ASSERT_THROW(lo_locked.to_bool());
+void UsrpTransceiver::ForEachMboard(const vector<size_t> &mboards, const std::function<void(size_t)> &task) {
+    if (mboards.size() <= 1) {
+        for (auto mboard: mboards) {
+            task(mboard);
+        }
+        return;
+    }
+
+    std::vector<std::future<void>> tasks;
+    for (auto mboard: mboards | stdv::drop(1)) {
+        tasks.push_back(std::async(std::launch::async, task, mboard));
+    }
+    std::exception_ptr error;
+    try {
+        task(mboards.front());
+    } catch (...) {
+        error = std::current_exception();
+    }
+    for (auto &pending: tasks) {
+        try {
+            pending.get();
+        } catch (...) {
+            if (not error) {
+                error = std::current_exception();
+            }
         }
     }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void UsrpTransceiver::CheckLocks(const vector<size_t> &tx_chs, const vector<size_t> &rx_chs, const string &clock_source,
+                                 std::chrono::steady_clock::time_point deadline) {
+    struct Reading {
+        string sensor; // "Tx(ch=0)", "mboard(=1)", ...
+        uhd::sensor_value_t value;
+    };
+    const size_t num_mboards = usrp->get_num_mboards();
+    std::vector<std::vector<size_t>> tx_per_mboard(num_mboards), rx_per_mboard(num_mboards);
+    for (auto ch: tx_chs) {
+        tx_per_mboard[tx_mboards.at(ch)].push_back(ch);
+    }
+    for (auto ch: rx_chs) {
+        rx_per_mboard[rx_mboards.at(ch)].push_back(ch);
+    }
+    const string ref_sensor = clock_source == "external" ? "ref_locked" : clock_source == "mimo" ? "mimo_locked" : "";
 
-    // Check RX LO lock
-    for (size_t ch: config.rx_channels) {
-        if (auto sensor_names = usrp->get_rx_sensor_names(ch); std::ranges::find(sensor_names, "lo_locked") != sensor_names.end()) {
-            auto lo_locked = usrp->get_rx_sensor("lo_locked", ch);
-            UHD_LOG_INFO("SYSTEM", format("Checking Rx(ch={}): {}", ch, lo_locked.to_pp_string()));
-            UHD_ASSERT_THROW(lo_locked.to_bool());
+    std::vector<size_t> mboards;
+    for (size_t mboard = 0; mboard < num_mboards; ++mboard) {
+        if (not ref_sensor.empty() or not tx_per_mboard[mboard].empty() or not rx_per_mboard[mboard].empty()) {
+            mboards.push_back(mboard);
         }
     }
-    // Check Ref lock
-    UHD_LOG_INFO("SYSTEM", "Checking REF lock status...");
-    size_t num_mboards = usrp->get_num_mboards();
-    if (config.clock_source == "external") {
-        for (auto mboard: stdv::iota(static_cast<size_t>(0), num_mboards)) {
-            if (auto sensor_names = usrp->get_mboard_sensor_names(mboard); std::ranges::find(sensor_names, "ref_locked") != sensor_names.end()) {
-                auto ref_locked = usrp->get_mboard_sensor("ref_locked", mboard);
-                UHD_LOG_INFO("SYSTEM", format("Checking mboard(={}): {}", mboard, ref_locked.to_pp_string()));
-                UHD_ASSERT_THROW(ref_locked.to_bool());
+
+    std::vector<std::vector<Reading>> readings(num_mboards);
+    ForEachMboard(mboards, [&](size_t mboard) {
+        // Only the sensors this motherboard provides are checked
+        std::vector<std::pair<string, std::function<uhd::sensor_value_t()>>> sensors;
+        for (auto ch: tx_per_mboard[mboard]) {
+            if (auto names = usrp->get_tx_sensor_names(ch); stdr::find(names, "lo_locked") != names.end()) {
+                sensors.emplace_back(format("Tx(ch={})", ch), [this, ch] { return usrp->get_tx_sensor("lo_locked", ch); });
+            }
+        }
+        for (auto ch: rx_per_mboard[mboard]) {
+            if (auto names = usrp->get_rx_sensor_names(ch); stdr::find(names, "lo_locked") != names.end()) {
+                sensors.emplace_back(format("Rx(ch={})", ch), [this, ch] { return usrp->get_rx_sensor("lo_locked", ch); });
             }
         }
+        if (not ref_sensor.empty()) {
+            if (auto names = usrp->get_mboard_sensor_names(mboard); stdr::find(names, ref_sensor) != names.end()) {
+                sensors.emplace_back(format("mboard(={})", mboard), [this, &ref_sensor, mboard] { return usrp->get_mboard_sensor(ref_sensor, mboard); });
+            }
+        }
+
+        auto &mboard_readings = readings[mboard];
+        while (true) {
+            mboard_readings.clear();
+            for (const auto &[name, read]: sensors) {
+                mboard_readings.push_back({name, read()});
+            }
+            if (stdr::all_of(mboard_readings, [](const Reading &reading) { return reading.value.to_bool(); }) or std::chrono::steady_clock::now() >= deadline) {
+                break;
+            }
+            std::this_thread::sleep_for(1ms);
+        }
+    });
+
+    vector<string> unlocked;
+    for (const auto &reading: readings | stdv::join) {
+        UHD_LOG_INFO("SYSTEM", format("Checking {}: {}", reading.sensor, reading.value.to_pp_string()));
+        if (not reading.value.to_bool()) {
+            unlocked.push_back(reading.sensor);
+        }
     }
-    if (config.clock_source == "mimo") {
-        for (auto mboard: stdv::iota(static_cast<size_t>(0), num_mboards)) {
-            if (auto sensor_names = usrp->get_mboard_sensor_names(mboard); std::ranges::find(sensor_names, "mimo_locked") != sensor_names.end()) {
-                auto ref_locked = usrp->get_mboard_sensor("mimo_locked", mboard);
-                UHD_LOG_INFO("SYSTEM", format("Checking mboard(={}): {}", mboard, ref_locked.to_pp_string()));
-                UHD_ASSERT_THROW(ref_locked.to_bool());
+    if (not unlocked.empty()) {
+        string names;
+        for (const auto &name: unlocked) {
+            names += (names.empty() ? "" : ", ") + name;
+        }
+        UHD_LOG_ERROR("SYSTEM", format("Not locked: {}", names));
+        throw std::runtime_error(format("Not locked: {}", names));
+    }
+}
+
+bool UsrpTransceiver::TimeSynchronized(const UsrpConfig &config) {
+    const string time_source = config.clock_source == "external" || config.clock_source == "gpsdo" ? "external" : "internal";
+    for (size_t mboard = 0; mboard < usrp->get_num_mboards(); ++mboard) {
+        if (usrp->get_clock_source(mboard) != config.clock_source or usrp->get_time_source(mboard) != time_source) {
+            return false;
+        }
+        if (config.clock_source != "internal") {
+            if (auto names = usrp->get_mboard_sensor_names(mboard); stdr::find(names, "ref_locked") != names.end() and
+                                                                      not usrp->get_mboard_sensor("ref_locked", mboard).to_bool()) {
+                return false;
+            }
+        }
+        // The PPS must still be arriving: the last edge was latched less than a second ago
+        if (time_source == "external") {
+            const double since_pps = (usrp->get_time_now(mboard) - usrp->get_time_last_pps(mboard)).get_real_secs();
+            if (since_pps < 0 or since_pps > 1.1) {
+                return false;
             }
         }
     }
+    return usrp->get_time_synchronized();
 }
 
 void UsrpTransceiver::ApplyTimeSync(const UsrpConfig &config, std::atomic<bool> &stop_signal) {
+    // A device that already runs from these references with a common time (e.g. synchronized by a
+    // previous run) keeps it, which saves the PPS wait and re-locking the reference
+    if (TimeSynchronized(config)) {
+        UHD_LOG_INFO("CONFIG", format("Clock reference {} already locked and time synchronized ({:.6f} s), skipping PPS sync", config.clock_source,
+                                      usrp->get_time_now().get_real_secs()));
+        return;
+    }
+
     // Configure clock reference
     UHD_LOG_INFO("CONFIG", format("Setting clock reference to: {}", config.clock_source));
     usrp->set_clock_source(config.clock_source);
@@ -253,12 +658,33 @@ void UsrpTransceiver::ApplyTimeSync(const UsrpConfig &config, std::atomic<bool>
     UHD_LOG_INFO("CONFIG", std::format("Current USRP time: {:.6f} seconds", usrp->get_time_now().get_real_secs()));
 }
 
-void UsrpTransceiver::TransmitFromBuffer(std::vector<std::vector<complexf>> &buffs, std::atomic<bool> &stop_signal) {
-    // Create TX stream
-    UHD_LOG_TRACE("STREAM", "Creating TX stream");
-    uhd::stream_args_t tx_stream_args("fc32", "sc16");
+uhd::tx_streamer::sptr UsrpTransceiver::GetTxStream(const uhd::stream_args_t &stream_args) {
+    std::lock_guard lock(stream_mutex);
+    auto &stream = tx_streamers[{stream_args.channels, stream_args.cpu_format, stream_args.otw_format}];
+    if (not stream) {
+        UHD_LOG_TRACE("STREAM", "Creating TX stream");
+        stream = usrp ? usrp->get_tx_stream(stream_args) : make_tx_stream(stream_args);
+    }
+    return stream;
+}
+
+uhd::rx_streamer::sptr UsrpTransceiver::GetRxStream(const uhd::stream_args_t &stream_args) {
+    std::lock_guard lock(stream_mutex);
+    auto &stream = rx_streamers[{stream_args.channels, stream_args.cpu_format, stream_args.otw_format}];
+    if (not stream) {
+        UHD_LOG_TRACE("STREAM", "Creating RX stream");
+        stream = usrp ? usrp->get_rx_stream(stream_args) : make_rx_stream(stream_args);
+    }
+    return stream;
+}
+
+void UsrpTransceiver::TransmitFromBuffer(const std::vector<TxChannelView> &buffs, std::atomic<bool> &stop_signal) {
+    SetupStreamingThread("txrx_tx", usrp_config.tx_cpus, usrp_config.thread_priority, usrp_config.numa_node);
+
+    // Get (cached) TX stream
+    uhd::stream_args_t tx_stream_args(TxStreamFormat(usrp_config), usrp_config.otw_format);
     tx_stream_args.channels = usrp_config.tx_channels;
-    uhd::tx_streamer::sptr tx_stream = usrp->get_tx_stream(tx_stream_args);
+    uhd::tx_streamer::sptr tx_stream = GetTxStream(tx_stream_args);
 
     // Initialize TX metadata
     uhd::tx_metadata_t md;
@@ -267,91 +693,304 @@ void UsrpTransceiver::TransmitFromBuffer(std::vector<std::vector<complexf>> &buf
     md.has_time_spec = true;
     md.time_spec = start_time;
     double timeout = 5;
-
-    // Create buffer pointers for transmission
-    std::vector<complexf *> buff_ptrs;
-    for (auto &buff: buffs) {
-        buff_ptrs.push_back(buff.data());
-    }
+    const size_t spb = SamplesPerBuffer(tx_stream->get_max_num_samps());
 
     size_t num_samps_transmitted = 0;
 
-    // Track buffer state
+    // Track buffer state (the buffers are in the streamer's format, see StageTxSamples)
+    const size_t sample_size = SampleSize(TxStreamFormat(usrp_config));
     size_t current_sample_idx = 0; // Current position in the buffer
-    size_t total_samples = buffs.empty() ? 0 : buffs[0].size(); // Total samples to transmit
+    size_t total_samples = buffs.empty() ? 0 : buffs[0].size() / sample_size; // Samples in one pass over the buffer
+    const bool loop_forever = usrp_config.tx_repeat == 0;
+    size_t samples_remaining = total_samples * usrp_config.tx_repeat; // Total samples to transmit (unused when looping forever)
+
+    // A waveform shorter than spb would be sent as tiny packets when repeated; replicate it
+    // into a staging buffer of at least spb samples so every send() stays full-sized.
+    std::vector<SampleBuffer> staging;
+    std::vector<TxChannelView> looped;
+    const std::vector<TxChannelView> *views = &buffs;
+    if (total_samples > 0 and total_samples < spb and usrp_config.tx_repeat != 1) {
+        const size_t periods = (spb + total_samples - 1) / total_samples;
+        for (const auto &buff: buffs) {
+            auto &copy = staging.emplace_back();
+            copy.reserve(periods * buff.size());
+            for (size_t i = 0; i < periods; ++i) {
+                copy.insert(copy.end(), buff.begin(), buff.end());
+            }
+            looped.emplace_back(copy);
+        }
+        views = &looped;
+        total_samples *= periods;
+    }
 
     UHD_LOG_INFO("TX-BUFFER", format("Starting transmission from buffer with {} samples per channel", total_samples))
+    if (usrp_config.tx_repeat != 1) {
+        UHD_LOG_INFO("TX-BUFFER", loop_forever ? string("Repeating buffer until stopped") : format("Repeating buffer {} times", usrp_config.tx_repeat))
+    }
     UHD_LOG_DEBUG("TX-BUFFER", format("Transmit start time: {:.3f} seconds", start_time.get_real_secs()))
-    UHD_LOG_DEBUG("TX-BUFFER", format("Current time: {:.3f} seconds", usrp->get_time_now().get_real_secs()))
+    UHD_LOG_DEBUG("TX-BUFFER", format("Current time: {:.3f} seconds", DeviceTime().get_real_secs()))
+
+    {
+        std::lock_guard lock(stats_mutex);
+        stats.tx_underflows = stats.tx_seq_errors = stats.tx_time_errors = 0;
+    }
+    // Underflows and late packets are only reported asynchronously
+    uhd::async_metadata_t async_md;
+    bool burst_acked = false;
+    auto handle_async = [&](double async_timeout) {
+        while (tx_stream->recv_async_msg(async_md, async_timeout)) {
+            std::lock_guard lock(stats_mutex);
+            switch (async_md.event_code) {
+                case uhd::async_metadata_t::EVENT_CODE_BURST_ACK:
+                    burst_acked = true;
+                    return;
+                case uhd::async_metadata_t::EVENT_CODE_UNDERFLOW:
+                case uhd::async_metadata_t::EVENT_CODE_UNDERFLOW_IN_PACKET:
+                    ++stats.tx_underflows;
+                    tx_metrics.RecordUnderflow();
+                    break;
+                case uhd::async_metadata_t::EVENT_CODE_SEQ_ERROR:
+                case uhd::async_metadata_t::EVENT_CODE_SEQ_ERROR_IN_BURST:
+                    ++stats.tx_seq_errors;
+                    tx_metrics.RecordSeqError();
+                    break;
+                case uhd::async_metadata_t::EVENT_CODE_TIME_ERROR:
+                    ++stats.tx_time_errors;
+                    tx_metrics.RecordLatePacket();
+                    break;
+                default:
+                    break;
+            }
+            async_timeout = 0;
+        }
+    };
 
-    while (!stop_signal.load(std::memory_order_acquire) && current_sample_idx < total_samples) {
+    // The pointer array is reused by every send(), keeping the loop free of allocations
+    const size_t num_channels = tx_stream->get_num_channels();
+    std::vector<const std::byte *> offset_ptrs(num_channels);
+    while (!stop_signal.load(std::memory_order_acquire) && total_samples > 0 && (loop_forever || samples_remaining > 0)) {
         /* ---------- Send samples from buffer ---------- */
-        size_t samps_to_send = std::min(usrp_config.spb, total_samples - current_sample_idx);
+        size_t samps_to_send = std::min(spb, total_samples - current_sample_idx);
+        if (not loop_forever) {
+            samps_to_send = std::min(samps_to_send, samples_remaining);
+        }
 
-        std::vector<complexf *> offset_ptrs(tx_stream->get_num_channels());
-        for (size_t ch = 0; ch < tx_stream->get_num_channels(); ++ch) {
-            offset_ptrs[ch] = buffs[ch].data() + current_sample_idx;
+        for (size_t ch = 0; ch < num_channels; ++ch) {
+            offset_ptrs[ch] = (*views)[ch].data() + current_sample_idx * sample_size;
         }
 
+        const auto send_begin = StreamMetrics::Clock::now();
         size_t samps_sent = tx_stream->send(offset_ptrs, samps_to_send, md, timeout);
+        tx_metrics.RecordCall(StreamMetrics::Clock::now() - send_begin, samps_sent * num_channels);
 
         if (samps_sent == 0) {
+            tx_metrics.RecordTimeout();
             UHD_LOG_WARNING("TX-BUFFER", format("send() returned 0 samples [{}/{}]", current_sample_idx, total_samples));
             continue;
         }
+        // Only the first packet carries the start time; the rest of the burst follows back-to-back
+        md.has_time_spec = false;
         num_samps_transmitted += samps_sent;
         current_sample_idx += samps_sent;
+        if (not loop_forever) {
+            samples_remaining -= samps_sent;
+        }
+        // Wrap around inside the same burst when repeating
+        if (current_sample_idx == total_samples) {
+            current_sample_idx = 0;
+        }
         timeout = 0.1;
+        handle_async(0);
     }
 
     // Finalize transmission
     md.end_of_burst = true;
     tx_stream->send("", 0, md);
 
+    // Collect the events of the burst's tail, up to its acknowledgement
+    const auto ack_deadline = std::chrono::steady_clock::now() + 100ms;
+    while (not burst_acked and std::chrono::steady_clock::now() < ack_deadline) {
+        handle_async(0.01);
+    }
+
     UHD_LOG_INFO("TX-BUFFER", "Transmit completed! Samples sent: " << num_samps_transmitted);
+    if (auto tx_stats = Stats(); tx_stats.tx_underflows > 0 or tx_stats.tx_seq_errors > 0 or tx_stats.tx_time_errors > 0) {
+        UHD_LOG_WARNING("TX-BUFFER", format("{} underflows, {} sequence errors, {} late packets", tx_stats.tx_underflows, tx_stats.tx_seq_errors,
+                                            tx_stats.tx_time_errors));
+    }
 }
 
-std::vector<std::vector<complexf>> UsrpTransceiver::ReceiveToBuffer(std::atomic<bool> &stop_signal) {
-    // Create RX stream
-    UHD_LOG_TRACE("STREAM", "Creating RX stream");
-    uhd::stream_args_t rx_stream_args("fc32", "sc16");
-    rx_stream_args.channels = usrp_config.rx_channels;
-    uhd::rx_streamer::sptr rx_stream = usrp->get_rx_stream(rx_stream_args);
-
+std::vector<SampleBuffer> UsrpTransceiver::ReceiveToBuffer(std::atomic<bool> &stop_signal) {
+    const size_t sample_size = SampleSize(usrp_config.cpu_format);
 
     // Create buffers for each channel
-    std::vector<std::vector<complexf>> buffs(rx_stream->get_num_channels(), std::vector<complexf>(usrp_config.rx_samps));
-    std::vector<complexf *> buff_ptrs;
+    std::vector<SampleBuffer> buffs(usrp_config.rx_channels.size());
+    std::vector<std::byte *> buff_ptrs;
     for (auto &buff: buffs) {
+        buff.resize(usrp_config.rx_samps * sample_size);
         buff_ptrs.push_back(buff.data());
     }
 
-    // Initialize reception parameters
-    double timeout = 5;
-    uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_NUM_SAMPS_AND_DONE);
-    stream_cmd.num_samps = usrp_config.rx_samps;
+    size_t num_samps_received = ReceiveToMemory(buff_ptrs, stop_signal);
+
+    // Resize buffers to actual received sample count
+    for (auto &buff: buffs) {
+        buff.resize(num_samps_received * sample_size);
+    }
+
+    return buffs;
+}
+
+size_t UsrpTransceiver::ReceiveToMemory(const std::vector<std::byte *> &buffs, std::atomic<bool> &stop_signal) {
+    if (usrp_config.rx_samps == 0) {
+        return 0;
+    }
+
+    // The whole destination is a single block
+    bool acquired = false;
+    auto acquire = [&]() -> RxBlock {
+        if (std::exchange(acquired, true)) {
+            return {};
+        }
+        return {buffs, usrp_config.rx_samps, 0};
+    };
+    auto commit = [](const RxBlock &, size_t, const uhd::time_spec_t &) {};
+
+    return ReceiveToBlocks(acquire, commit, stop_signal);
+}
+
+std::vector<std::vector<size_t>> UsrpTransceiver::RxStreamGroups() const {
+    if (usrp_config.rx_channels_per_stream == 0) {
+        return {stdr::to<vector>(stdv::iota(size_t{0}, usrp_config.rx_channels.size()))};
+    }
+    // Groups never span motherboards; channels keep their configured order within a motherboard
+    std::map<size_t, std::vector<size_t>> per_mboard;
+    for (size_t index = 0; index < usrp_config.rx_channels.size(); ++index) {
+        per_mboard[rx_mboards.at(usrp_config.rx_channels[index])].push_back(index);
+    }
+    std::vector<std::vector<size_t>> groups;
+    for (const auto &indices: per_mboard | stdv::values) {
+        for (size_t first = 0; first < indices.size(); first += usrp_config.rx_channels_per_stream) {
+            const size_t last = std::min(first + usrp_config.rx_channels_per_stream, indices.size());
+            groups.emplace_back(indices.begin() + first, indices.begin() + last);
+        }
+    }
+    return groups;
+}
+
+uhd::rx_streamer::sptr UsrpTransceiver::StartRxStream(const std::vector<size_t> &channels) {
+    // Get (cached) RX stream
+    uhd::stream_args_t rx_stream_args(usrp_config.cpu_format, usrp_config.otw_format);
+    rx_stream_args.channels = channels;
+    uhd::rx_streamer::sptr rx_stream = GetRxStream(rx_stream_args);
+
+    // Every streamer starts at the same device time, which keeps them sample-aligned
+    const bool continuous = DeviceRxSamples() == 0;
+    uhd::stream_cmd_t stream_cmd(continuous ? uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS : uhd::stream_cmd_t::STREAM_MODE_NUM_SAMPS_AND_DONE);
+    stream_cmd.num_samps = DeviceRxSamples();
     stream_cmd.stream_now = false;
     stream_cmd.time_spec = start_time;
+    rx_stream->issue_stream_cmd(stream_cmd);
+    return rx_stream;
+}
 
-    UHD_LOG_INFO("RX-BUFFER", format("Starting reception, will receive {} samples", usrp_config.rx_samps))
+void UsrpTransceiver::StopRxStream(const uhd::rx_streamer::sptr &rx_stream) {
+    // Stop the device and flush what is still in flight so the cached streamer starts clean next time
+    uhd::rx_metadata_t md;
+    rx_stream->issue_stream_cmd(uhd::stream_cmd_t(uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS));
+    const size_t spb = SamplesPerBuffer(rx_stream->get_max_num_samps());
+    SampleBuffer drain(spb * SampleSize(usrp_config.cpu_format));
+    std::vector<std::byte *> drain_ptrs(rx_stream->get_num_channels(), drain.data());
+    while (rx_stream->recv(drain_ptrs, spb, md, 0.1) > 0) {
+    }
+}
+
+size_t UsrpTransceiver::ReceiveToBlocks(const RxBlockAcquire &acquire, const RxBlockCommit &commit, std::atomic<bool> &stop_signal) {
+    {
+        std::lock_guard lock(stats_mutex);
+        stats.rx_overflows = stats.rx_dropped = 0;
+        stats.rx_gaps.clear();
+    }
+    rx_metrics.BeginBurst(StreamMetrics::Clock::now());
+    if (usrp_config.rx_decimation > 1) {
+        return ReceiveDecimated(acquire, commit, stop_signal);
+    }
+    return ReceiveDeviceToBlocks(acquire, commit, stop_signal);
+}
+
+size_t UsrpTransceiver::ReceiveDeviceToBlocks(const RxBlockAcquire &acquire, const RxBlockCommit &commit, std::atomic<bool> &stop_signal) {
+    const bool continuous = DeviceRxSamples() == 0;
+    const size_t sample_size = SampleSize(usrp_config.cpu_format);
+
+    if (continuous) {
+        UHD_LOG_INFO("RX-BUFFER", "Starting continuous reception")
+    } else {
+        UHD_LOG_INFO("RX-BUFFER", format("Starting reception, will receive {} samples", DeviceRxSamples()))
+    }
     UHD_LOG_DEBUG("RX-BUFFER", format("Reception start time: {:.3f} seconds", start_time.get_real_secs()))
-    UHD_LOG_DEBUG("RX-BUFFER", format("Current time: {:.3f} seconds", usrp->get_time_now().get_real_secs()))
-    // Issue stream command to start reception
-    rx_stream->issue_stream_cmd(stream_cmd);
+    UHD_LOG_DEBUG("RX-BUFFER", format("Current time: {:.3f} seconds", DeviceTime().get_real_secs()))
+
+    if (auto groups = RxStreamGroups(); groups.size() > 1) {
+        return ReceiveGroupsToBlocks(groups, acquire, commit, stop_signal);
+    }
+
+    SetupStreamingThread("txrx_rx", usrp_config.rx_cpus, usrp_config.thread_priority, usrp_config.numa_node);
+    uhd::rx_streamer::sptr rx_stream = StartRxStream(usrp_config.rx_channels);
+    RxStreamState state = NewRxStreamState();
 
+    // Initialize reception parameters
+    double timeout = 5;
     uhd::rx_metadata_t md;
     size_t num_samps_received = 0;
+    const size_t spb = SamplesPerBuffer(rx_stream->get_max_num_samps());
+    const size_t num_channels = rx_stream->get_num_channels();
+    std::vector<std::byte *> offset_ptrs(num_channels); // Reused by every recv()
+
+    RxBlock block;
+    size_t block_filled = 0;
+    uhd::time_spec_t block_time;
 
     // Main reception loop
-    while (not stop_signal.load(std::memory_order_acquire) && (num_samps_received < usrp_config.rx_samps)) {
+    while (not stop_signal.load(std::memory_order_acquire) && (continuous || num_samps_received < DeviceRxSamples())) {
+        // Move on to the next block once the current one is full
+        if (block_filled == block.capacity) {
+            if (block_filled > 0) {
+                commit(block, block_filled, block_time);
+            }
+            block = acquire();
+            block_filled = 0;
+            if (block.buffs.empty()) {
+                break;
+            }
+            if (block.buffs.size() != num_channels) {
+                throw std::runtime_error(format("Expected {} RX buffers, got {}", num_channels, block.buffs.size()));
+            }
+        }
+
         // Get real buffer pos
-        std::vector<complexf *> offset_ptrs(rx_stream->get_num_channels());
-        for (size_t ch = 0; ch < rx_stream->get_num_channels(); ++ch) {
-            offset_ptrs[ch] = buffs[ch].data() + num_samps_received;
+        for (size_t ch = 0; ch < num_channels; ++ch) {
+            offset_ptrs[ch] = block.buffs[ch] + block_filled * sample_size;
         }
 
+        // Never ask for more than the block has room for
+        size_t room = block.capacity - block_filled;
+        if (not continuous) {
+            room = std::min(room, DeviceRxSamples() - num_samps_received);
+        }
+
+        // Zeros standing in for samples lost to an overflow, and the samples received after them
+        if (const size_t pending = WritePending(offset_ptrs, room, state); pending > 0) {
+            if (block_filled == 0) {
+                block_time = state.first + uhd::time_spec_t::from_ticks(static_cast<long long>(num_samps_received), state.rate);
+            }
+            block_filled += pending;
+            num_samps_received += pending;
+            continue;
+        }
 
-        const size_t num_rx_samps = rx_stream->recv(offset_ptrs, usrp_config.spb, md, timeout);
+        const auto recv_begin = StreamMetrics::Clock::now();
+        const size_t num_rx_samps = rx_stream->recv(offset_ptrs, std::min(spb, room), md, timeout);
+        rx_metrics.RecordCall(StreamMetrics::Clock::now() - recv_begin, num_rx_samps * num_channels);
 
         timeout = 0.1; // Reduce timeout after first packet
 
@@ -359,26 +998,961 @@ std::vector<std::vector<complexf>> UsrpTransceiver::ReceiveToBuffer(std::atomic<
         // Handle different error conditions
         if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_TIMEOUT) {
             UHD_LOG_WARNING("RX-BUFFER", "RX channel received timeout.");
+            rx_metrics.RecordTimeout();
             continue;
         }
         if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_OVERFLOW) {
             UHD_LOG_WARNING("RX-BUFFER", "RX channel received overflow.");
+            rx_metrics.RecordOverflow();
+            {
+                std::lock_guard lock(stats_mutex);
+                ++stats.rx_overflows;
+            }
+            if (not continuous) {
+                RestartAfterOverflow(rx_stream, num_samps_received, state);
+            }
             continue;
         }
         if (md.error_code != uhd::rx_metadata_t::ERROR_CODE_NONE) {
             UHD_LOG_ERROR("RX-BUFFER", "RX channel received error: " << md.strerror());
             throw std::runtime_error("Receive error: " + md.strerror());
         }
+        if (num_rx_samps == 0) {
+            continue;
+        }
+        rx_metrics.RecordFirstSample((md.time_spec - start_time).get_real_secs());
+        for (size_t ch = 0; ch < offset_ptrs.size(); ++ch) {
+            CorrectRx(ch, offset_ptrs[ch], num_rx_samps);
+        }
+
+        const size_t used = AlignReceived(offset_ptrs, num_rx_samps, num_samps_received, room, md.time_spec, state);
+        if (block_filled == 0 and used > 0) {
+            block_time = usrp_config.rx_fill_gaps ? state.first + uhd::time_spec_t::from_ticks(static_cast<long long>(num_samps_received), state.rate)
+                                                  : md.time_spec;
+        }
+        block_filled += used;
+        num_samps_received += used;
+    }
+
+    if (block_filled > 0) {
+        commit(block, block_filled, block_time);
+    }
 
-        num_samps_received += num_rx_samps;
+    if (continuous || num_samps_received < DeviceRxSamples() || state.restarted) {
+        StopRxStream(rx_stream);
     }
 
     UHD_LOG_INFO("RX-BUFFER", "Receive completed! Samples received: " << num_samps_received);
+    LogRxStats();
 
-    // Resize buffers to actual received sample count
-    for (auto &buff: buffs) {
-        buff.resize(num_samps_received);
+    return num_samps_received;
+}
+
+size_t UsrpTransceiver::ReceiveGroupsToBlocks(const std::vector<std::vector<size_t>> &groups, const RxBlockAcquire &acquire, const RxBlockCommit &commit,
+                                              std::atomic<bool> &stop_signal) {
+    const bool continuous = DeviceRxSamples() == 0;
+    const size_t sample_size = SampleSize(usrp_config.cpu_format);
+    const size_t num_groups = groups.size();
+    UHD_LOG_INFO("RX-BUFFER", format("Receiving with {} streamers", num_groups))
+
+    // Shared state; between phases it is only changed by the barrier's completion step, while every thread waits
+    RxBlock block;
+    size_t block_target = 0; // Samples per channel each group receives into the current block
+    size_t num_samps_received = 0;
+    bool done = false;
+    std::vector<size_t> filled(num_groups, 0);
+    std::vector<uhd::time_spec_t> times(num_groups);
+    std::vector<std::exception_ptr> errors(num_groups + 1); // One per group, the last one for acquire/commit
+    std::atomic<bool> failed{false};
+
+    auto next_block = [&] {
+        block = acquire();
+        if (block.buffs.empty()) {
+            done = true;
+            return;
+        }
+        if (block.buffs.size() != usrp_config.rx_channels.size()) {
+            throw std::runtime_error(format("Expected {} RX buffers, got {}", usrp_config.rx_channels.size(), block.buffs.size()));
+        }
+        block_target = continuous ? block.capacity : std::min(block.capacity, DeviceRxSamples() - num_samps_received);
+    };
+
+    // Runs once all groups have filled their share of the block: hands it on and fetches the next one
+    auto complete = [&]() noexcept {
+        try {
+            const size_t nsamps = stdr::min(filled);
+            if (nsamps > 0) {
+                if (stdr::any_of(times, [&](const uhd::time_spec_t &time) { return time != times.front(); })) {
+                    UHD_LOG_WARNING("RX-BUFFER", format("RX streamers out of alignment at {:.6f} s", times.front().get_real_secs()));
+                }
+                commit(block, nsamps, times.front());
+                num_samps_received += nsamps;
+            }
+            // A group that fell short (stop, error) ends reception, as the groups would no longer be aligned
+            if (failed or nsamps < block_target or stop_signal.load(std::memory_order_acquire) or (not continuous and num_samps_received >= DeviceRxSamples())) {
+                done = true;
+            } else {
+                next_block();
+            }
+        } catch (...) {
+            errors.back() = std::current_exception();
+            done = true;
+        }
+        stdr::fill(filled, 0);
+    };
+    std::barrier sync(static_cast<std::ptrdiff_t>(num_groups), complete);
+
+    next_block();
+    if (done) {
+        return 0;
     }
 
-    return buffs;
+    auto receive_group = [&](size_t group) {
+        const auto &indices = groups[group];
+        uhd::rx_streamer::sptr rx_stream;
+        RxStreamState state = NewRxStreamState();
+        std::vector<std::byte *> offset_ptrs(indices.size());
+        uhd::rx_metadata_t md;
+        double timeout = 5;
+        size_t spb = usrp_config.spb;
+
+        try {
+            // With several RX CPUs, each streamer gets its own
+            auto cpus = usrp_config.rx_cpus.empty() ? usrp_config.rx_cpus : vector<size_t>{usrp_config.rx_cpus[group % usrp_config.rx_cpus.size()]};
+            SetupStreamingThread(format("txrx_rx{}", group), cpus, usrp_config.thread_priority, usrp_config.numa_node);
+            rx_stream = StartRxStream(stdr::to<vector>(indices | stdv::transform([&](size_t index) { return usrp_config.rx_channels[index]; })));
+            spb = SamplesPerBuffer(rx_stream->get_max_num_samps());
+        } catch (...) {
+            errors[group] = std::current_exception();
+            failed = true;
+        }
+
+        while (true) {
+            try {
+                while (rx_stream and not failed and filled[group] < block_target and not stop_signal.load(std::memory_order_acquire)) {
+                    for (size_t i = 0; i < indices.size(); ++i) {
+                        offset_ptrs[i] = block.buffs[indices[i]] + filled[group] * sample_size;
+                    }
+                    const size_t position = num_samps_received + filled[group];
+                    const size_t room = block_target - filled[group];
+                    if (const size_t pending = WritePending(offset_ptrs, room, state); pending > 0) {
+                        if (filled[group] == 0) {
+                            times[group] = state.first + uhd::time_spec_t::from_ticks(static_cast<long long>(position), state.rate);
+                        }
+                        filled[group] += pending;
+                        continue;
+                    }
+
+                    const auto recv_begin = StreamMetrics::Clock::now();
+                    const size_t num_rx_samps = rx_stream->recv(offset_ptrs, std::min(spb, room), md, timeout);
+                    rx_metrics.RecordCall(StreamMetrics::Clock::now() - recv_begin, num_rx_samps * indices.size());
+                    timeout = 0.1; // Reduce timeout after first packet
+
+                    if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_TIMEOUT) {
+                        UHD_LOG_WARNING("RX-BUFFER", format("RX streamer {} received timeout.", group));
+                        rx_metrics.RecordTimeout();
+                        continue;
+                    }
+                    if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_OVERFLOW) {
+                        UHD_LOG_WARNING("RX-BUFFER", format("RX streamer {} received overflow.", group));
+                        rx_metrics.RecordOverflow();
+                        {
+                            std::lock_guard lock(stats_mutex);
+                            ++stats.rx_overflows;
+                        }
+                        if (not continuous) {
+                            RestartAfterOverflow(rx_stream, position, state);
+                        }
+                        continue;
+                    }
+                    if (md.error_code != uhd::rx_metadata_t::ERROR_CODE_NONE) {
+                        UHD_LOG_ERROR("RX-BUFFER", format("RX streamer {} received error: {}", group, md.strerror()));
+                        throw std::runtime_error("Receive error: " + md.strerror());
+                    }
+                    if (num_rx_samps == 0) {
+                        continue;
+                    }
+                    rx_metrics.RecordFirstSample((md.time_spec - start_time).get_real_secs());
+                    for (size_t i = 0; i < indices.size(); ++i) {
+                        CorrectRx(indices[i], offset_ptrs[i], num_rx_samps);
+                    }
+
+                    const size_t used = AlignReceived(offset_ptrs, num_rx_samps, position, room, md.time_spec, state);
+                    if (filled[group] == 0 and used > 0) {
+                        times[group] = usrp_config.rx_fill_gaps ? state.first + uhd::time_spec_t::from_ticks(static_cast<long long>(position), state.rate)
+                                                                : md.time_spec;
+                    }
+                    filled[group] += used;
+                }
+            } catch (...) {
+                errors[group] = std::current_exception();
+                failed = true;
+            }
+            sync.arrive_and_wait();
+            if (done) {
+                break;
+            }
+        }
+
+        if (rx_stream and (continuous or num_samps_received < DeviceRxSamples() or state.restarted)) {
+            StopRxStream(rx_stream);
+        }
+    };
+
+    // Group 0 runs on the calling thread
+    std::vector<std::jthread> threads;
+    for (size_t group = 1; group < num_groups; ++group) {
+        threads.emplace_back(receive_group, group);
+    }
+    receive_group(0);
+    threads.clear();
+
+    for (const auto &error: errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    UHD_LOG_INFO("RX-BUFFER", format("Receive completed! Samples received: {} over {} streamers", num_samps_received, num_groups));
+    LogRxStats();
+    return num_samps_received;
+}
+
+size_t UsrpTransceiver::ReceiveDecimated(const RxBlockAcquire &acquire, const RxBlockCommit &commit, std::atomic<bool> &stop_signal) {
+    const bool continuous = DeviceRxSamples() == 0;
+    const size_t num_ch = usrp_config.rx_channels.size();
+    const size_t sample_size = SampleSize(usrp_config.cpu_format);
+    const size_t decimation = usrp_config.rx_decimation;
+    const double rate = RxRate();
+    RxDecimator decimator(num_ch, decimation, rate, usrp_config.rx_mix_freqs, usrp_config.rx_fir_taps, usrp_config.cpu_format);
+    UHD_LOG_INFO("RX-BUFFER", format("Decimating by {} on the host, {:.3f} MHz -> {:.3f} MHz", decimation, rate / 1e6, rate / decimation / 1e6))
+
+    // The device-rate stream is received on its own thread; the ring never blocks it
+    SampleRing ring(num_ch, sample_size, kDecimationBlockSamps, kDecimationBlocks, true, usrp_config.numa_node);
+    std::atomic<bool> consumer_done{false};
+    auto device = std::async(std::launch::async, [&] {
+        try {
+            const size_t received = ReceiveDeviceToBlocks([&] { return consumer_done ? RxBlock{} : ring.Acquire(); },
+                                                          [&](const RxBlock &block, size_t nsamps, const uhd::time_spec_t &time_spec) { ring.Commit(block, nsamps, time_spec); },
+                                                          stop_signal);
+            ring.Close();
+            return received;
+        } catch (...) {
+            ring.Close();
+            throw;
+        }
+    });
+
+    // Shared state; between phases it is only changed by the barrier's completion step, while every worker waits
+    std::vector<SampleBuffer> outputs(num_ch);
+    for (auto &buff: outputs) {
+        buff.resize(decimator.MaxOutput(kDecimationBlockSamps) * sample_size);
+    }
+    std::vector<size_t> produced(num_ch, 0);
+    std::vector<std::exception_ptr> errors(num_ch + 1); // One per channel, the last one for acquire/commit
+    std::atomic<bool> failed{false};
+    bool done = false;
+    bool have_front = false;
+
+    RxBlock block;
+    size_t block_filled = 0;
+    uhd::time_spec_t first_time; // Device time of device sample 0
+    long long next_input = 0; // Device sample expected next
+    long long output_input = 0; // Device sample of the next output sample
+    bool started = false;
+    uint64_t next_seq = 0; // Ring sequence number expected next; the ring counts the blocks it dropped too
+    size_t num_samps_received = 0;
+
+    // Copies n output samples of every channel (zeros when from is empty) into the caller's blocks
+    auto deliver = [&](const std::vector<const std::byte *> &from, size_t n) {
+        for (size_t offset = 0; offset < n and not done;) {
+            if (block_filled == block.capacity) {
+                block = acquire();
+                block_filled = 0;
+                if (block.buffs.empty()) {
+                    done = true;
+                    break;
+                }
+                if (block.buffs.size() != num_ch) {
+                    throw std::runtime_error(format("Expected {} RX buffers, got {}", num_ch, block.buffs.size()));
+                }
+            }
+            size_t count = std::min(n - offset, block.capacity - block_filled);
+            if (not continuous) {
+                count = std::min(count, usrp_config.rx_samps - num_samps_received);
+            }
+            for (size_t ch = 0; ch < num_ch; ++ch) {
+                std::byte *dst = block.buffs[ch] + block_filled * sample_size;
+                if (from.empty()) {
+                    std::memset(dst, 0, count * sample_size);
+                } else {
+                    std::memcpy(dst, from[ch] + offset * sample_size, count * sample_size);
+                }
+            }
+            block_filled += count;
+            offset += count;
+            num_samps_received += count;
+            output_input += static_cast<long long>(count * decimation);
+            if (block_filled == block.capacity or (not continuous and num_samps_received == usrp_config.rx_samps)) {
+                const long long first_input = output_input - static_cast<long long>(block_filled * decimation);
+                commit(block, block_filled, first_time + uhd::time_spec_t::from_ticks(first_input, rate));
+                block_filled = block.capacity;
+            }
+            if (not continuous and num_samps_received == usrp_config.rx_samps) {
+                done = true;
+            }
+        }
+    };
+
+    // Moves on to the next ring block, accounting for device samples missing in front of it
+    auto next_ring_block = [&] {
+        if (std::exchange(have_front, false)) {
+            ring.Release();
+        }
+        if (done or not ring.Wait()) {
+            done = true;
+            return;
+        }
+        have_front = true;
+        const auto &info = ring.FrontInfo();
+        if (not std::exchange(started, true)) {
+            first_time = info.time_spec;
+        }
+        const long long position = (info.time_spec - first_time).to_ticks(rate);
+        const bool dropped = info.seq != next_seq;
+        next_seq = info.seq + 1;
+        if (position > next_input) {
+            // Ring blocks the decimators were too slow for, or device gaps that were packed rather than zero-filled
+            const size_t missing = static_cast<size_t>(position - next_input);
+            size_t skipped = 0;
+            for (size_t ch = 0; ch < num_ch; ++ch) {
+                skipped = decimator.Skip(ch, missing);
+            }
+            if (dropped) {
+                RecordGap(static_cast<size_t>(output_input), skipped * decimation);
+            }
+            if (usrp_config.rx_fill_gaps) {
+                deliver({}, skipped);
+            } else {
+                output_input += static_cast<long long>(skipped * decimation);
+            }
+        }
+        next_input = position + static_cast<long long>(info.nsamps);
+    };
+
+    auto complete = [&]() noexcept {
+        try {
+            if (failed) {
+                done = true;
+                return;
+            }
+            deliver(stdr::to<vector>(outputs | stdv::transform([](const SampleBuffer &buff) { return buff.data(); })), produced.front());
+            next_ring_block();
+        } catch (...) {
+            errors.back() = std::current_exception();
+            done = true;
+        }
+    };
+    std::barrier sync(static_cast<std::ptrdiff_t>(num_ch), complete);
+
+    try {
+        block.capacity = 0;
+        next_ring_block();
+    } catch (...) {
+        errors.back() = std::current_exception();
+        done = true;
+    }
+
+    auto work = [&](size_t ch) {
+        if (ch > 0) {
+            SetupStreamingThread(format("txrx_dsp{}", ch), {}, 0, usrp_config.numa_node);
+        }
+        while (not done) {
+            try {
+                produced[ch] = decimator.Process(ch, ring.Front().buffs[ch], ring.FrontInfo().nsamps, outputs[ch].data());
+            } catch (...) {
+                errors[ch] = std::current_exception();
+                failed = true;
+            }
+            sync.arrive_and_wait();
+        }
+    };
+
+    // Channel 0 is decimated on the calling thread
+    std::vector<std::jthread> workers;
+    for (size_t ch = 1; ch < num_ch; ++ch) {
+        workers.emplace_back(work, ch);
+    }
+    work(0);
+    workers.clear();
+
+    // Stop the device thread and let it finish into the ring
+    consumer_done = true;
+    if (have_front) {
+        ring.Release();
+    }
+    while (ring.Wait()) {
+        ring.Release();
+    }
+    device.get();
+    if (block_filled > 0 and block_filled < block.capacity) {
+        const long long first_input = output_input - static_cast<long long>(block_filled * decimation);
+        commit(block, block_filled, first_time + uhd::time_spec_t::from_ticks(first_input, rate));
+    }
+    for (const auto &error: errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    if (ring.Overflows() > 0) {
+        UHD_LOG_WARNING("RX-BUFFER", format("Decimators fell behind: {} device blocks dropped", ring.Overflows()));
+    }
+    UHD_LOG_INFO("RX-BUFFER", format("Decimated receive completed! Samples received: {}", num_samps_received));
+    LogRxStats();
+    return num_samps_received;
+}
+
+UsrpTransceiver::RxStreamState UsrpTransceiver::NewRxStreamState() const {
+    RxStreamState state;
+    state.rate = RxRate();
+    // A finite capture starts at start_time, so even a gap before its first packet is placed correctly
+    if (DeviceRxSamples() > 0) {
+        state.started = true;
+        state.first = start_time;
+    }
+    return state;
+}
+
+size_t UsrpTransceiver::AlignReceived(const vector<std::byte *> &ptrs, size_t nsamps, size_t position, size_t room, const uhd::time_spec_t &time,
+                                      RxStreamState &state) {
+    if (not state.started) {
+        state.started = true;
+        state.first = time;
+    }
+    const long long offset = std::llround((time - state.first).get_real_secs() * state.rate) - state.next;
+    if (offset < 0) {
+        UHD_LOG_DEBUG("RX-BUFFER", format("Dropping stale packet at {:.6f} s", time.get_real_secs()));
+        return 0;
+    }
+    state.next += offset + static_cast<long long>(nsamps);
+    if (offset == 0) {
+        return nsamps;
+    }
+
+    const auto gap = static_cast<size_t>(offset);
+    UHD_LOG_WARNING("RX-BUFFER", format("{} samples lost before {:.6f} s", gap, time.get_real_secs()));
+    if (not usrp_config.rx_fill_gaps) {
+        RecordGap(position, gap);
+        return nsamps;
+    }
+    const size_t sample_size = SampleSize(usrp_config.cpu_format);
+    if (gap + nsamps <= room) {
+        for (auto *ptr: ptrs) {
+            std::memmove(ptr + gap * sample_size, ptr, nsamps * sample_size);
+            std::memset(ptr, 0, gap * sample_size);
+        }
+        RecordGap(position, gap);
+        return gap + nsamps;
+    }
+    // The packet does not fit behind the gap in what is left of the block: zero-fill what fits of the gap, and hold
+    // back the samples that do not fit for the next block
+    const size_t zeros = std::min(gap, room);
+    const size_t fit = room - zeros;
+    const size_t held = nsamps - fit;
+    state.carry.resize(ptrs.size());
+    for (size_t ch = 0; ch < ptrs.size(); ++ch) {
+        auto &carry = state.carry[ch];
+        if (carry.size() < held * sample_size) {
+            carry.resize(held * sample_size);
+        }
+        std::memcpy(carry.data(), ptrs[ch] + fit * sample_size, held * sample_size);
+        std::memmove(ptrs[ch] + zeros * sample_size, ptrs[ch], fit * sample_size);
+        std::memset(ptrs[ch], 0, zeros * sample_size);
+    }
+    RecordGap(position, gap);
+    state.pending_gap = gap - zeros;
+    state.carry_samps = held;
+    return room;
+}
+
+size_t UsrpTransceiver::WritePending(const vector<std::byte *> &ptrs, size_t room, RxStreamState &state) const {
+    const size_t sample_size = SampleSize(usrp_config.cpu_format);
+    const size_t zeros = std::min(state.pending_gap, room);
+    const size_t held = std::min(state.carry_samps, room - zeros);
+    for (size_t ch = 0; ch < ptrs.size(); ++ch) {
+        std::memset(ptrs[ch], 0, zeros * sample_size);
+        if (held > 0) {
+            std::byte *carry = state.carry[ch].data();
+            std::memcpy(ptrs[ch] + zeros * sample_size, carry, held * sample_size);
+            std::memmove(carry, carry + held * sample_size, (state.carry_samps - held) * sample_size);
+        }
+    }
+    state.pending_gap -= zeros;
+    state.carry_samps -= held;
+    return zeros + held;
+}
+
+void UsrpTransceiver::RestartAfterOverflow(const uhd::rx_streamer::sptr &rx_stream, size_t position, RxStreamState &state) {
+    // A NUM_SAMPS_AND_DONE command may end at an overflow: stop it for sure and ask again for the rest, shortly from now
+    rx_stream->issue_stream_cmd(uhd::stream_cmd_t(uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS));
+    state.restarted = true;
+
+    const auto resume = DeviceTime() + uhd::time_spec_t(kRxResumeLead);
+    const size_t remaining = DeviceRxSamples() - position;
+    size_t skipped = 0;
+    if (usrp_config.rx_fill_gaps) {
+        // Zero-filled positions count towards rx_samps, so only the samples from resume on are requested
+        const long long until_resume = std::llround((resume - state.first).get_real_secs() * state.rate) - state.next;
+        skipped = std::min(remaining, static_cast<size_t>(std::max(until_resume, 0LL)));
+    }
+    if (skipped == remaining) {
+        RecordGap(position, remaining);
+        state.pending_gap = remaining;
+        return;
+    }
+
+    uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_NUM_SAMPS_AND_DONE);
+    stream_cmd.num_samps = remaining - skipped;
+    stream_cmd.stream_now = false;
+    stream_cmd.time_spec = resume;
+    rx_stream->issue_stream_cmd(stream_cmd);
+    UHD_LOG_INFO("RX-BUFFER", format("Reissued stream command for {} samples at {:.6f} s", stream_cmd.num_samps, resume.get_real_secs()));
+}
+
+void UsrpTransceiver::RecordGap(size_t offset, size_t nsamps) {
+    // Gaps are reported in output samples, which are decimated when rx_decimation > 1
+    const size_t decimation = std::max<size_t>(usrp_config.rx_decimation, 1);
+    std::lock_guard lock(stats_mutex);
+    stats.rx_dropped += (nsamps + decimation - 1) / decimation;
+    if (stats.rx_gaps.size() < kMaxRxGaps) {
+        stats.rx_gaps.push_back({offset / decimation, (nsamps + decimation - 1) / decimation});
+    }
+}
+
+void UsrpTransceiver::LogRxStats() const {
+    std::lock_guard lock(stats_mutex);
+    if (stats.rx_overflows > 0 or stats.rx_dropped > 0) {
+        UHD_LOG_WARNING("RX-BUFFER", format("{} overflows, {} samples lost in {} gaps{}", stats.rx_overflows, stats.rx_dropped, stats.rx_gaps.size(),
+                                            usrp_config.rx_fill_gaps ? " (zero-filled)" : ""));
+    }
+}
+
+void UsrpTransceiver::CorrectRx(size_t index, std::byte *samples, size_t nsamps) const {
+    if (index < usrp_config.rx_corrections.size() and not usrp_config.rx_corrections[index].Identity()) {
+        ProcessSamples(samples, usrp_config.cpu_format, samples, usrp_config.cpu_format, nsamps, usrp_config.rx_corrections[index]);
+    }
+}
+
+uhd::tune_request_t UsrpTransceiver::HopRequest(double freq, double center, double bandwidth, double rate) const {
+    uhd::tune_request_t tune_req(freq);
+    tune_req.args = uhd::device_addr_t("mode_n=integer");
+    // While the hop stays within the front-end bandwidth around the LO, only the DSP has to move
+    if (usrp_config.sweep_dsp_tune and std::abs(freq - center) + rate / 2 <= bandwidth / 2) {
+        tune_req.rf_freq_policy = uhd::tune_request_t::POLICY_NONE;
+        tune_req.dsp_freq_policy = uhd::tune_request_t::POLICY_AUTO;
+    }
+    return tune_req;
+}
+
+void UsrpTransceiver::TuneAt(double freq, const uhd::time_spec_t &time) {
+    std::vector<std::pair<size_t, double>> tx_tunes, rx_tunes;
+    for (size_t index = 0; index < usrp_config.tx_channels.size(); ++index) {
+        tx_tunes.emplace_back(index, freq);
+    }
+    for (size_t index = 0; index < usrp_config.rx_channels.size(); ++index) {
+        rx_tunes.emplace_back(index, freq);
+    }
+    TuneAt(tx_tunes, rx_tunes, time);
+}
+
+void UsrpTransceiver::TuneAt(const vector<std::pair<size_t, double>> &tx_tunes, const vector<std::pair<size_t, double>> &rx_tunes, const uhd::time_spec_t &time) {
+    usrp->set_command_time(time, uhd::usrp::multi_usrp::ALL_MBOARDS);
+    // DSP-only hops are measured against where the RF LO actually is, which earlier hops may have moved
+    for (const auto &[index, freq]: tx_tunes) {
+        auto ch = usrp_config.tx_channels[index];
+        auto &applied = tx_settings[ch];
+        const auto tune_req = HopRequest(freq, applied.lo.value_or(usrp_config.tx_freqs[index]), usrp->get_tx_bandwidth(ch), usrp_config.tx_rates[index]);
+        usrp->set_tx_freq(tune_req, ch);
+        if (tune_req.rf_freq_policy != uhd::tune_request_t::POLICY_NONE) {
+            applied.lo = freq;
+        }
+    }
+    for (const auto &[index, freq]: rx_tunes) {
+        auto ch = usrp_config.rx_channels[index];
+        auto &applied = rx_settings[ch];
+        const auto tune_req = HopRequest(freq, applied.lo.value_or(usrp_config.rx_freqs[index]), usrp->get_rx_bandwidth(ch), usrp_config.rx_rates[index]);
+        usrp->set_rx_freq(tune_req, ch);
+        if (tune_req.rf_freq_policy != uhd::tune_request_t::POLICY_NONE) {
+            applied.lo = freq;
+        }
+    }
+    usrp->clear_command_time(uhd::usrp::multi_usrp::ALL_MBOARDS);
+}
+
+void UsrpTransceiver::ApplyTimedRetune(const UsrpConfig &config, const uhd::time_spec_t &tune_time) {
+    UsrpConfig others = config;
+    others.tx_freqs = usrp_config.tx_freqs;
+    others.rx_freqs = usrp_config.rx_freqs;
+    others.tx_samps = usrp_config.tx_samps;
+    others.rx_samps = usrp_config.rx_samps;
+    if (others != usrp_config) {
+        throw std::invalid_argument("A timed retune may only change frequencies and sample counts");
+    }
+    if (not usrp) {
+        usrp_config = config;
+        return;
+    }
+
+    std::vector<std::pair<size_t, double>> tx_tunes, rx_tunes;
+    for (size_t index = 0; index < config.tx_channels.size(); ++index) {
+        if (tx_settings[config.tx_channels[index]].freq != config.tx_freqs[index]) {
+            tx_tunes.emplace_back(index, config.tx_freqs[index]);
+        }
+    }
+    for (size_t index = 0; index < config.rx_channels.size(); ++index) {
+        if (rx_settings[config.rx_channels[index]].freq != config.rx_freqs[index]) {
+            rx_tunes.emplace_back(index, config.rx_freqs[index]);
+        }
+    }
+    if (not tx_tunes.empty() or not rx_tunes.empty()) {
+        TuneAt(tx_tunes, rx_tunes, tune_time);
+        UHD_LOG_DEBUG("CONFIG", format("Queued retune of {} channels at {:.6f} s", tx_tunes.size() + rx_tunes.size(), tune_time.get_real_secs()));
+    }
+
+    // Remembered now so the next retune compares against it; CheckRetuneLocks forgets them again if they do not lock
+    for (const auto &[index, freq]: tx_tunes) {
+        tx_settings[config.tx_channels[index]].freq = freq;
+        retuned_tx.push_back(config.tx_channels[index]);
+    }
+    for (const auto &[index, freq]: rx_tunes) {
+        rx_settings[config.rx_channels[index]].freq = freq;
+        retuned_rx.push_back(config.rx_channels[index]);
+    }
+    usrp_config = config;
+}
+
+void UsrpTransceiver::CheckRetuneLocks() {
+    if (retuned_tx.empty() and retuned_rx.empty()) {
+        return;
+    }
+    stdr::sort(retuned_tx);
+    retuned_tx.erase(stdr::unique(retuned_tx).begin(), retuned_tx.end());
+    stdr::sort(retuned_rx);
+    retuned_rx.erase(stdr::unique(retuned_rx).begin(), retuned_rx.end());
+
+    // On failure the channels stay listed, so the next ApplyConfiguration tunes them again
+    const auto now = std::chrono::steady_clock::now();
+    CheckLocks(retuned_tx, retuned_rx, usrp_config.clock_source, usrp_config.settle_time < 0 ? now + kLockTimeout : now);
+    retuned_tx.clear();
+    retuned_rx.clear();
+}
+
+std::vector<SweepSegment> UsrpTransceiver::ReceiveSweep(const std::vector<std::byte *> &buffs, std::atomic<bool> &stop_signal) {
+    {
+        std::lock_guard lock(stats_mutex);
+        stats.rx_overflows = stats.rx_dropped = 0;
+        stats.rx_gaps.clear();
+    }
+    SetupStreamingThread("txrx_rx", usrp_config.rx_cpus, usrp_config.thread_priority, usrp_config.numa_node);
+
+    // Get (cached) RX stream
+    uhd::stream_args_t rx_stream_args(usrp_config.cpu_format, usrp_config.otw_format);
+    rx_stream_args.channels = usrp_config.rx_channels;
+    uhd::rx_streamer::sptr rx_stream = GetRxStream(rx_stream_args);
+    if (buffs.size() != rx_stream->get_num_channels()) {
+        throw std::runtime_error(format("Expected {} RX buffers, got {}", rx_stream->get_num_channels(), buffs.size()));
+    }
+
+    // Plan the hops: retune at the start of each slot, capture once the LO has settled
+    const double settle = SweepSettle(usrp_config);
+    std::vector<SweepSegment> plan;
+    uhd::time_spec_t slot = start_time;
+    size_t offset = 0;
+    for (size_t hop = 0; hop < usrp_config.sweep_freqs.size(); ++hop) {
+        plan.push_back({usrp_config.sweep_freqs[hop], offset, DwellSamples(usrp_config, hop), slot + uhd::time_spec_t(settle)});
+        slot = slot + uhd::time_spec_t(settle + SweepDwell(usrp_config, hop));
+        offset += plan.back().nsamps;
+    }
+
+    size_t scheduled = 0;
+    std::vector<bool> skipped(plan.size()); // Hops whose start passed while recovering from a timeout
+    auto issue_capture = [&](const SweepSegment &segment) {
+        uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_NUM_SAMPS_AND_DONE);
+        stream_cmd.num_samps = segment.nsamps;
+        stream_cmd.stream_now = false;
+        stream_cmd.time_spec = segment.time_spec;
+        rx_stream->issue_stream_cmd(stream_cmd);
+    };
+    auto schedule_next = [&] {
+        const size_t hop = scheduled++;
+        if (skipped[hop]) {
+            return;
+        }
+        TuneAt(plan[hop].freq, plan[hop].time_spec - uhd::time_spec_t(settle));
+        issue_capture(plan[hop]);
+    };
+
+    UHD_LOG_INFO("RX-SWEEP", format("Starting sweep over {} frequencies, {} samples per channel", plan.size(), offset))
+    while (scheduled < std::min(kSweepLookahead, plan.size())) {
+        schedule_next();
+    }
+
+    const size_t sample_size = SampleSize(usrp_config.cpu_format);
+    const size_t spb = SamplesPerBuffer(rx_stream->get_max_num_samps());
+    std::vector<std::byte *> offset_ptrs(rx_stream->get_num_channels());
+    uhd::rx_metadata_t md;
+    double timeout = (plan.front().time_spec - usrp->get_time_now()).get_real_secs() + 0.1;
+    size_t hops_received = 0;
+    rx_metrics.BeginBurst(StreamMetrics::Clock::now());
+
+    for (size_t hop = 0; hop < plan.size(); ++hop) {
+        if (stop_signal.load(std::memory_order_acquire)) {
+            break;
+        }
+        SweepSegment &segment = plan[hop];
+        size_t received = 0;
+        bool timed_out = false;
+        while (not skipped[hop] and received < segment.nsamps and not stop_signal.load(std::memory_order_acquire)) {
+            for (size_t ch = 0; ch < offset_ptrs.size(); ++ch) {
+                offset_ptrs[ch] = buffs[ch] + (segment.offset + received) * sample_size;
+            }
+            const auto recv_begin = StreamMetrics::Clock::now();
+            const size_t num_rx_samps = rx_stream->recv(offset_ptrs, std::min(spb, segment.nsamps - received), md, timeout);
+            rx_metrics.RecordCall(StreamMetrics::Clock::now() - recv_begin, num_rx_samps * offset_ptrs.size());
+            timeout = settle + 0.1;
+
+            if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_TIMEOUT) {
+                UHD_LOG_WARNING("RX-SWEEP", format("Timeout in hop at {:.3f} MHz, {} of {} samples", segment.freq / 1e6, received, segment.nsamps));
+                rx_metrics.RecordTimeout();
+                timed_out = true;
+                break;
+            }
+            if (md.error_code == uhd::rx_metadata_t::ERROR_CODE_OVERFLOW) {
+                UHD_LOG_WARNING("RX-SWEEP", "RX channel received overflow.");
+                rx_metrics.RecordOverflow();
+                std::lock_guard lock(stats_mutex);
+                ++stats.rx_overflows;
+                continue;
+            }
+            if (md.error_code != uhd::rx_metadata_t::ERROR_CODE_NONE) {
+                UHD_LOG_ERROR("RX-SWEEP", "RX channel received error: " << md.strerror());
+                throw std::runtime_error("Receive error: " + md.strerror());
+            }
+            for (size_t ch = 0; ch < offset_ptrs.size(); ++ch) {
+                CorrectRx(ch, offset_ptrs[ch], num_rx_samps);
+            }
+            if (received == 0) {
+                segment.time_spec = md.time_spec;
+                rx_metrics.RecordFirstSample((md.time_spec - plan.front().time_spec).get_real_secs());
+            }
+            received += num_rx_samps;
+        }
+        if (received < segment.nsamps) {
+            // Buffers are not zeroed when allocated; the rest of a short hop must not hold stale samples
+            for (auto *buff: buffs) {
+                std::memset(buff + (segment.offset + received) * sample_size, 0, (segment.nsamps - received) * sample_size);
+            }
+        }
+        segment.nsamps = received;
+        ++hops_received;
+
+        if (timed_out) {
+            // The rest of this hop may still arrive and would land at the start of the next one: stop and flush the
+            // streamer, then requeue the hops already scheduled, skipping those that can no longer start on time
+            StopRxStream(rx_stream);
+            const uhd::time_spec_t now = usrp->get_time_now();
+            for (size_t next = hop + 1; next < plan.size(); ++next) {
+                if (plan[next].time_spec < now + uhd::time_spec_t(kRxResumeLead)) {
+                    UHD_LOG_WARNING("RX-SWEEP", format("Skipping hop at {:.3f} MHz, its start passed while recovering from the timeout", plan[next].freq / 1e6));
+                    skipped[next] = true;
+                } else if (next < scheduled) {
+                    issue_capture(plan[next]);
+                } else {
+                    break;
+                }
+            }
+            if (auto next = std::ranges::find(skipped.begin() + hop + 1, skipped.end(), false); next != skipped.end()) {
+                timeout = (plan[next - skipped.begin()].time_spec - now).get_real_secs() + 0.1;
+            }
+        }
+
+        if (scheduled < plan.size()) {
+            schedule_next();
+        }
+    }
+    plan.resize(hops_received);
+
+    // Hops already queued on the device are cancelled and flushed when stopping early
+    if (hops_received < usrp_config.sweep_freqs.size()) {
+        rx_stream->issue_stream_cmd(uhd::stream_cmd_t(uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS));
+        SampleBuffer drain(spb * sample_size);
+        std::vector<std::byte *> drain_ptrs(rx_stream->get_num_channels(), drain.data());
+        while (rx_stream->recv(drain_ptrs, spb, md, 0.1) > 0) {
+        }
+    }
+
+    // The channels are no longer at their configured frequencies: retune on the next ApplyConfiguration
+    for (size_t ch: usrp_config.tx_channels) {
+        tx_settings[ch].freq.reset();
+    }
+    for (size_t ch: usrp_config.rx_channels) {
+        rx_settings[ch].freq.reset();
+    }
+
+    UHD_LOG_INFO("RX-SWEEP", format("Sweep completed! {} hops received", hops_received));
+    return plan;
+}
+
+std::vector<TriggerWindow> UsrpTransceiver::ReceiveTriggered(const std::vector<std::byte *> &buffs, std::atomic<bool> &stop_signal) {
+    const size_t num_ch = usrp_config.rx_channels.size();
+    if (buffs.size() != num_ch) {
+        throw std::runtime_error(format("Expected {} RX buffers, got {}", num_ch, buffs.size()));
+    }
+    const size_t sample_size = SampleSize(usrp_config.cpu_format);
+    const double rate = RxRate() / static_cast<double>(std::max<size_t>(usrp_config.rx_decimation, 1));
+    const size_t pre = usrp_config.trigger_pre;
+    const size_t post = usrp_config.trigger_post;
+    TriggerDetector detector(usrp_config.trigger_mode, usrp_config.trigger_threshold, usrp_config.trigger_window, usrp_config.trigger_reference,
+                             usrp_config.cpu_format);
+
+    // The ring holds the pre-trigger history plus the detector's lag on top of the blocks in flight
+    const size_t history_blocks = (pre + detector.Lag()) / kTriggerBlockSamps + 2;
+    SampleRing ring(num_ch, sample_size, kTriggerBlockSamps, history_blocks + kTriggerBlocks, true, usrp_config.numa_node);
+    UHD_LOG_INFO("RX-TRIGGER", format("Starting triggered capture ({}, threshold {}), windows of {} + {} samples, room for {}", usrp_config.trigger_mode,
+                                      usrp_config.trigger_threshold, pre, post, usrp_config.rx_samps))
+
+    std::atomic<bool> consumer_done{false};
+    auto device = std::async(std::launch::async, [&] {
+        try {
+            const size_t received = ReceiveToBlocks([&] { return consumer_done ? RxBlock{} : ring.Acquire(); },
+                                                    [&](const RxBlock &block, size_t nsamps, const uhd::time_spec_t &time_spec) { ring.Commit(block, nsamps, time_spec); },
+                                                    stop_signal);
+            ring.Close();
+            return received;
+        } catch (...) {
+            ring.Close();
+            throw;
+        }
+    });
+
+    std::vector<TriggerWindow> windows;
+    size_t used = 0; // Samples per channel kept so far
+    size_t held = 0; // Blocks at the front of the ring still unreleased, the newest one included
+    bool started = false;
+    uhd::time_spec_t first_time; // Device time of stream position 0
+    long long stream_end = 0; // Stream position after the newest block
+    uint64_t next_seq = 0;
+    bool finishing = false; // No further window is wanted once the current one is complete
+    bool active = false; // The last window still waits for samples
+    long long window_start = 0, window_end = 0, copied = 0;
+    const long long timeout_end = usrp_config.trigger_timeout > 0 ? std::llround(usrp_config.trigger_timeout * rate) : 0;
+
+    auto block_start = [&](size_t i) { return (ring.InfoAt(i).time_spec - first_time).to_ticks(rate); };
+
+    // Copies the part of ring block i that belongs to the active window, zero-filling samples the stream lost
+    auto fill_window = [&](size_t i) {
+        const long long start = block_start(i);
+        const long long end = std::min(start + static_cast<long long>(ring.InfoAt(i).nsamps), window_end);
+        if (not active or end <= copied) {
+            return;
+        }
+        const size_t out = windows.back().offset + static_cast<size_t>(copied - window_start);
+        if (start > copied) {
+            const size_t gap = static_cast<size_t>(std::min(start, window_end) - copied);
+            for (size_t ch = 0; ch < num_ch; ++ch) {
+                std::memset(buffs[ch] + out * sample_size, 0, gap * sample_size);
+            }
+            copied += static_cast<long long>(gap);
+        }
+        if (copied < end) {
+            const size_t count = static_cast<size_t>(end - copied);
+            const size_t dst = windows.back().offset + static_cast<size_t>(copied - window_start);
+            for (size_t ch = 0; ch < num_ch; ++ch) {
+                std::memcpy(buffs[ch] + dst * sample_size, ring.At(i).buffs[ch] + static_cast<size_t>(copied - start) * sample_size, count * sample_size);
+            }
+            copied = end;
+        }
+        active = copied < window_end;
+    };
+
+    auto fire = [&](long long position, float metric) {
+        if (finishing) {
+            return;
+        }
+        // Windows start no earlier than the previous one ended or the history still held
+        const long long start = std::max({position - static_cast<long long>(pre), window_end, block_start(0)});
+        window_start = copied = start;
+        window_end = position + static_cast<long long>(post);
+        active = true;
+        windows.push_back({used, static_cast<size_t>(window_end - start), first_time + uhd::time_spec_t::from_ticks(start, rate),
+                           first_time + uhd::time_spec_t::from_ticks(position, rate), metric});
+        used += windows.back().nsamps;
+        detector.Arm(window_end);
+        UHD_LOG_DEBUG("RX-TRIGGER", format("Trigger at {:.9f} s, metric {:.3f}", windows.back().trigger_time.get_real_secs(), metric));
+
+        for (size_t i = 0; i < held; ++i) {
+            fill_window(i);
+        }
+        if ((usrp_config.trigger_max > 0 and windows.size() == usrp_config.trigger_max) or usrp_config.rx_samps - used < pre + post) {
+            finishing = true;
+        }
+    };
+
+    std::exception_ptr error;
+    try {
+        while (ring.WaitAvailable(held + 1)) {
+            const size_t i = held++;
+            const auto &info = ring.InfoAt(i);
+            if (not std::exchange(started, true)) {
+                first_time = info.time_spec;
+            }
+            const long long start = block_start(i);
+            if (info.seq != next_seq or start != stream_end) {
+                // Blocks the detector was too slow for, or a device gap: no detector window may span it
+                detector.Reset();
+            }
+            next_seq = info.seq + 1;
+            stream_end = start + static_cast<long long>(info.nsamps);
+
+            fill_window(i);
+            detector.Process(ring.At(i).buffs[usrp_config.trigger_channel], info.nsamps, start, fire);
+            if ((finishing and not active) or (timeout_end > 0 and stream_end >= timeout_end)) {
+                break;
+            }
+
+            // Release the history no detection can reach any more
+            const long long keep_from = std::min(active ? copied : stream_end, stream_end - static_cast<long long>(pre + detector.Lag()));
+            while (held > 0 and block_start(0) + static_cast<long long>(ring.InfoAt(0).nsamps) <= keep_from) {
+                ring.Release();
+                --held;
+            }
+        }
+        if (not finishing and (timeout_end == 0 or stream_end < timeout_end)) {
+            detector.Flush(fire);
+        }
+    } catch (...) {
+        error = std::current_exception();
+    }
+    if (active) {
+        // The stream ended inside the last window
+        used -= static_cast<size_t>(window_end - copied);
+        windows.back().nsamps = static_cast<size_t>(copied - window_start);
+    }
+
+    // Stop the device thread and let it finish into the ring
+    consumer_done = true;
+    while (held-- > 0) {
+        ring.Release();
+    }
+    while (ring.Wait()) {
+        ring.Release();
+    }
+    const size_t streamed = device.get();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    if (ring.Overflows() > 0) {
+        UHD_LOG_WARNING("RX-TRIGGER", format("Trigger detector fell behind: {} blocks dropped", ring.Overflows()));
+    }
+    UHD_LOG_INFO("RX-TRIGGER", format("Triggered capture completed! {} windows, {} of {} samples kept", windows.size(), used, streamed));
+    return windows;
 }
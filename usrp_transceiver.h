@@ -1,43 +1,425 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <complex>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <string>
+#include <tuple>
 #include <uhd/usrp/multi_usrp.hpp>
 #include <vector>
+
+#include "dsp_kernels.h"
+#include "sample_arena.h"
+#include "stream_metrics.h"
 using complexf = std::complex<float>;
 
+/**
+ * Owning buffer of one channel's samples in the configured CPU format
+ *
+ * Carved from the SampleArena when one is configured; new elements are left uninitialized.
+ */
+using SampleBuffer = std::vector<std::byte, ArenaAllocator<std::byte>>;
+
+/**
+ * Non-owning, read-only view of one TX channel's samples (e.g. over a mapped SHM region)
+ *
+ * The samples are in the configured CPU format; the view length is in bytes.
+ */
+using TxChannelView = std::span<const std::byte>;
+
+/**
+ * Size in bytes of one complex sample in a host (CPU) format
+ *
+ * @param cpu_format One of fc32, sc16 or sc8
+ */
+size_t SampleSize(const std::string &cpu_format);
+
+/**
+ * Destination block for block-wise reception, owned by the consumer
+ */
+struct RxBlock {
+    std::vector<std::byte *> buffs; // One pointer per RX channel
+    size_t capacity{0}; // Samples per channel
+    size_t index{0}; // Identifies the block to its owner
+};
+
+/**
+ * Returns the next block to receive into; a block without buffers stops reception
+ */
+using RxBlockAcquire = std::function<RxBlock()>;
+
+/**
+ * Hands a filled block back to its owner with the number of valid samples and the time of the first one
+ */
+using RxBlockCommit = std::function<void(const RxBlock &block, size_t nsamps, const uhd::time_spec_t &time_spec)>;
+
+/**
+ * Creates a streamer for the given stream args, in place of the device (see the simulated-streamer UsrpTransceiver)
+ */
+using TxStreamFactory = std::function<uhd::tx_streamer::sptr(const uhd::stream_args_t &stream_args)>;
+
+using RxStreamFactory = std::function<uhd::rx_streamer::sptr(const uhd::stream_args_t &stream_args)>;
+
+/**
+ * One hop of a frequency sweep within the segmented RX buffer
+ */
+struct SweepSegment {
+    double freq{0}; // Hop frequency in Hz
+    size_t offset{0}; // First sample of the hop in every channel's buffer
+    size_t nsamps{0}; // Samples captured (fewer than planned if the sweep stopped early)
+    uhd::time_spec_t time_spec; // Device time of the first sample
+};
+
+/**
+ * One pre/post-trigger window of a triggered capture within the RX buffer
+ */
+struct TriggerWindow {
+    size_t offset{0}; // First sample of the window in every channel's buffer
+    size_t nsamps{0}; // Samples kept (fewer than trigger_pre + trigger_post at the start or end of the stream)
+    uhd::time_spec_t time_spec; // Device time of the window's first sample
+    uhd::time_spec_t trigger_time; // Device time of the detection
+    float metric{0}; // Detector value: mean power in dBFS, or normalized correlation
+};
+
+/**
+ * Samples an overflow cost a capture, located in the received data
+ */
+struct RxGap {
+    size_t offset{0}; // Output sample (per channel) at which the gap starts
+    size_t nsamps{0}; // Samples lost
+};
+
+/**
+ * Streaming errors of the last burst or stream
+ */
+struct StreamStats {
+    size_t rx_overflows{0};
+    size_t rx_dropped{0}; // Samples lost to overflows, from the RX timestamps
+    std::vector<RxGap> rx_gaps; // The first gaps, in order (see kMaxRxGaps)
+    size_t tx_underflows{0};
+    size_t tx_seq_errors{0};
+    size_t tx_time_errors{0}; // TX packets that arrived late for their time_spec
+};
+
+struct UsrpConfig;
+
+/**
+ * Host format the TX streamer uses: tx_stream_format, or cpu_format when it is empty
+ */
+const std::string &TxStreamFormat(const UsrpConfig &config);
+
+/**
+ * Whether TX buffers need StageTxSamples before TransmitFromBuffer (conversion or corrections)
+ */
+bool NeedsTxStaging(const UsrpConfig &config);
+
+/**
+ * Copies TX buffers in cpu_format into new buffers in TxStreamFormat, applying tx_corrections
+ *
+ * @param views One view per TX channel, or with interleaved a single sample-major view of all channels
+ * @param interleaved The view holds sample 0 of every channel, then sample 1, ...
+ */
+std::vector<SampleBuffer> StageTxSamples(const std::vector<TxChannelView> &views, const UsrpConfig &config, bool interleaved = false);
+
+/**
+ * Total RX samples per channel a sweep captures (sum of all dwells at the first RX rate)
+ */
+size_t SweepSamples(const UsrpConfig &config);
+
+/**
+ * Time from a timed retune to the first sample taken at the new frequency: settle_time, or a 1 ms guard when it is negative
+ */
+double SweepSettle(const UsrpConfig &config);
+
 struct UsrpConfig {
     std::string clock_source, time_source;
     std::vector<size_t> tx_channels, rx_channels;
-    size_t spb; // Samples per buffer
+    size_t spb{0}; // Samples per send/recv call; 0 uses the streamer's get_max_num_samps() (one packet)
     double delay;
     size_t rx_samps{0};
     size_t tx_samps{0};
+    size_t tx_repeat{1}; // Times the TX buffer is sent back-to-back in one burst; 0 repeats until stopped
     std::vector<double> tx_rates, rx_rates;
     std::vector<std::string> tx_files, rx_files;
     std::vector<double> tx_freqs, rx_freqs;
     std::vector<double> tx_gains, rx_gains;
     std::vector<std::string> tx_ants, rx_ants;
+    std::string cpu_format{"fc32"}; // Host sample format: fc32, sc16 or sc8
+    std::string otw_format{"sc16"}; // Over-the-wire sample format: sc16 or sc8
+    std::vector<size_t> tx_cpus, rx_cpus; // CPUs the TX/RX streaming threads are pinned to; empty leaves them unpinned
+    float thread_priority{0}; // SCHED_FIFO priority of the streaming threads in (0, 1]; 0 keeps the default scheduler
+    int numa_node{-1}; // NUMA node for streaming threads and buffers (the NIC's node); -1 leaves placement to the kernel
+    size_t rx_channels_per_stream{0}; // RX channels per streamer and receive thread, within one motherboard; 0 receives all channels with one streamer
+    bool rx_fill_gaps{true}; // Zero-fill the samples lost to an overflow, keeping the sample positions time-aligned; false packs the data and only records the gaps
+    double settle_time{-1}; // Wait after a retune in seconds; negative polls the lo_locked sensors (1 ms guard between sweep hops)
+    std::vector<double> sweep_freqs; // Hop frequencies for every TX and RX channel; empty disables sweeping
+    std::vector<double> sweep_dwells; // RX capture time per hop in seconds, one per hop or one for all
+    bool sweep_dsp_tune{false}; // Hop with the DSP only while the hop stays within the front-end bandwidth around the LO
+    std::string tx_stream_format; // Host format of the TX streamer; empty uses cpu_format, otherwise the TX buffers are converted before streaming
+    std::vector<SampleCorrection> tx_corrections, rx_corrections; // Per-channel gain, DC offset and clip applied on the host; empty applies none
+    size_t rx_decimation{1}; // Host decimation of every RX channel (1 = off); rx_samps then counts decimated samples
+    std::vector<double> rx_mix_freqs; // Per-channel NCO frequency in Hz mixed down to DC before decimating; empty does not mix
+    std::vector<float> rx_fir_taps; // Decimation low-pass at the device rate; empty uses RxDecimator::DesignLowpass
+    std::string trigger_mode; // Triggered capture: "power" or "correlation" (see TriggerDetector); empty keeps every sample
+    double trigger_threshold{-30}; // Mean power in dBFS, or normalized correlation in (0, 1]
+    size_t trigger_window{64}; // Power averaging length in samples
+    std::vector<complexf> trigger_reference; // Preamble the correlation trigger looks for (fc32, full scale 1.0)
+    size_t trigger_pre{0}, trigger_post{0}; // Samples kept before and from each detection; rx_samps is then the room for all windows
+    size_t trigger_max{0}; // Windows after which the capture stops; 0 stops when rx_samps has no room for another one
+    size_t trigger_channel{0}; // RX channel (index into rx_channels) the detector watches
+    double trigger_timeout{0}; // Stream time in seconds after which a triggered capture stops; 0 waits for the windows
+
+    bool operator==(const UsrpConfig &) const = default;
 };
 
 class UsrpTransceiver {
 private:
     uhd::usrp::multi_usrp::sptr usrp;
     UsrpConfig usrp_config{};
+
+    // Last values set on each channel, so settings that did not change are not sent again
+    struct ChannelSettings {
+        std::optional<double> gain, rate, freq;
+        std::optional<double> lo; // Frequency of the last tune that moved the RF LO, the center of DSP-only hops
+        std::optional<std::string> ant;
+    };
+    std::map<size_t, ChannelSettings> tx_settings, rx_settings;
+
+    // Motherboard of each TX / RX channel, for fanning configuration out per motherboard
+    std::vector<size_t> tx_mboards, rx_mboards;
+
+    /**
+     * Runs task(mboard) for every listed motherboard concurrently and waits for all of them
+     *
+     * Each motherboard has its own control transport, so blocking property-tree calls on
+     * different motherboards overlap. The first exception thrown by a task is rethrown once
+     * all of them have finished.
+     */
+    void ForEachMboard(const std::vector<size_t> &mboards, const std::function<void(size_t mboard)> &task);
+
+    /**
+     * Checks lo_locked on the given channels and ref_locked / mimo_locked (per clock_source) on
+     * every motherboard, reading the motherboards concurrently
+     *
+     * Sensors are polled every millisecond until all of them report lock or the deadline has
+     * passed, then each reading is logged.
+     *
+     * @throws std::runtime_error naming the sensors that are not locked
+     */
+    void CheckLocks(const std::vector<size_t> &tx_chs, const std::vector<size_t> &rx_chs, const std::string &clock_source,
+                    std::chrono::steady_clock::time_point deadline);
+
+    // Streamers are expensive to create, so they are kept until the sample rates change
+    using StreamKey = std::tuple<std::vector<size_t>, std::string, std::string>; // channels, CPU format, OTW format
+    std::mutex stream_mutex;
+    std::map<StreamKey, uhd::tx_streamer::sptr> tx_streamers;
+    std::map<StreamKey, uhd::rx_streamer::sptr> rx_streamers;
+
+    // Where the streamers come from when there is no device (see the simulated-streamer constructor)
+    TxStreamFactory make_tx_stream;
+    RxStreamFactory make_rx_stream;
+
     /**
-     * Applies the USRP TuneRequest to the device
+     * Device time, or the host's steady clock without a device
      */
-    void ApplyTuneRequest(const UsrpConfig &config);
+    [[nodiscard]] uhd::time_spec_t DeviceTime() const;
 
+    /**
+     * Sample rate of the first RX / TX channel as set on the device (as configured without one)
+     */
+    [[nodiscard]] double RxRate() const;
+
+    [[nodiscard]] double TxRate() const;
+
+    /**
+     * Returns the cached TX streamer for these stream args, creating it on first use
+     */
+    uhd::tx_streamer::sptr GetTxStream(const uhd::stream_args_t &stream_args);
 
+    /**
+     * Returns the cached RX streamer for these stream args, creating it on first use
+     */
+    uhd::rx_streamer::sptr GetRxStream(const uhd::stream_args_t &stream_args);
+
+    /**
+     * Retunes the channels whose frequency changed, with one timed command for all of them
+     *
+     * @return Number of channels retuned
+     */
+    size_t ApplyTuneRequest(const UsrpConfig &config);
+
+    /**
+     * Tune request for one sweep hop of a channel whose LO sits at center
+     */
+    [[nodiscard]] uhd::tune_request_t HopRequest(double freq, double center, double bandwidth, double rate) const;
+
+    /**
+     * Queues a timed retune of every TX and RX channel to freq
+     */
+    void TuneAt(double freq, const uhd::time_spec_t &time);
+
+    /**
+     * Queues a timed retune of the listed channels, given as (index in tx/rx_channels, frequency)
+     */
+    void TuneAt(const std::vector<std::pair<size_t, double>> &tx_tunes, const std::vector<std::pair<size_t, double>> &rx_tunes, const uhd::time_spec_t &time);
+
+    // Channels retuned by ApplyTimedRetune whose locks CheckRetuneLocks has not checked yet
+    std::vector<size_t> retuned_tx, retuned_rx;
+
+    /**
+     * Checks whether the device already runs from the clock and time references of config, with
+     * the reference locked, the PPS present (external time) and the same time on every motherboard
+     */
+    bool TimeSynchronized(const UsrpConfig &config);
+
+    /**
+     * Sets the clock and time references and synchronizes the device time on the next PPS,
+     * unless TimeSynchronized already holds
+     */
     void ApplyTimeSync(const UsrpConfig &config, std::atomic<bool> &stop_signal);
 
+    // Streaming errors of the current (or last) burst; RX and TX threads update them
+    static constexpr size_t kMaxRxGaps = 1024;
+    mutable std::mutex stats_mutex;
+    StreamStats stats;
+
+    // Cumulative call latency, throughput and error counters, recorded lock-free in the send/recv loops
+    StreamMetrics tx_metrics;
+    StreamMetrics rx_metrics;
+
+    // Timestamp bookkeeping of one RX streamer, for placing samples after an overflow
+    struct RxStreamState {
+        double rate{0};
+        bool started{false};
+        uhd::time_spec_t first; // Device time of timeline sample 0
+        long long next{0}; // Timeline sample expected next
+        size_t pending_gap{0}; // Output samples still to zero-fill
+        std::vector<SampleBuffer> carry; // Per channel: received samples held back until the zeros before them are written
+        size_t carry_samps{0};
+        bool restarted{false}; // The stream command was reissued, so the streamer needs draining
+    };
+
+    /**
+     * Places the samples just received at output position by their timestamp
+     *
+     * A packet that starts later than expected follows a gap: the gap is recorded and, with
+     * rx_fill_gaps, the samples are moved behind it and the gap zero-filled. What does not fit in
+     * room is left pending in state, for WritePending to place at the start of the next block. A
+     * packet from before the expected time is stale and dropped.
+     *
+     * @return Output samples used up
+     */
+    size_t AlignReceived(const std::vector<std::byte *> &ptrs, size_t nsamps, size_t position, size_t room, const uhd::time_spec_t &time,
+                         RxStreamState &state);
+
+    /**
+     * Writes the zeros and then the held-back samples still pending in state, up to room
+     *
+     * @return Output samples written; 0 when nothing is pending
+     */
+    size_t WritePending(const std::vector<std::byte *> &ptrs, size_t room, RxStreamState &state) const;
+
+    /**
+     * Reissues a finite stream command after an overflow ended it, for the samples still missing
+     */
+    void RestartAfterOverflow(const uhd::rx_streamer::sptr &rx_stream, size_t position, RxStreamState &state);
+
+    [[nodiscard]] RxStreamState NewRxStreamState() const;
+
+    /**
+     * Samples per send/recv call: spb, or max_num_samps (one full packet) when spb is 0
+     */
+    [[nodiscard]] size_t SamplesPerBuffer(size_t max_num_samps) const { return usrp_config.spb > 0 ? usrp_config.spb : max_num_samps; }
+
+    void RecordGap(size_t offset, size_t nsamps);
+
+    void LogRxStats() const;
+
+    static constexpr size_t kDecimationBlockSamps = 1 << 15; // Device-rate samples per channel in each block handed to the decimators
+    static constexpr size_t kDecimationBlocks = 16;
+
+    static constexpr size_t kTriggerBlockSamps = 1 << 15; // Samples per channel in each block of the pre-trigger ring
+    static constexpr size_t kTriggerBlocks = 16; // Ring blocks on top of the pre-trigger history
+
+    /**
+     * Samples per channel the device streams for rx_samps output samples (rx_samps * rx_decimation)
+     *
+     * 0, i.e. continuous streaming, for a triggered capture.
+     */
+    [[nodiscard]] size_t DeviceRxSamples() const {
+        return usrp_config.trigger_mode.empty() ? usrp_config.rx_samps * std::max<size_t>(usrp_config.rx_decimation, 1) : 0;
+    }
+
+    /**
+     * ReceiveToBlocks at the device rate, without decimation
+     */
+    size_t ReceiveDeviceToBlocks(const RxBlockAcquire &acquire, const RxBlockCommit &commit, std::atomic<bool> &stop_signal);
+
+    /**
+     * ReceiveToBlocks through an RxDecimator
+     *
+     * The device-rate stream is received on its own thread into a SampleRing; one worker per
+     * channel mixes and decimates each ring block, and the decimated samples are copied into
+     * the caller's blocks once every channel is done. Ring blocks a slow decimator could not
+     * take are treated like overflows.
+     */
+    size_t ReceiveDecimated(const RxBlockAcquire &acquire, const RxBlockCommit &commit, std::atomic<bool> &stop_signal);
+
+    /**
+     * Applies rx_corrections[index] in place to samples just received for that RX channel (by config index)
+     */
+    void CorrectRx(size_t index, std::byte *samples, size_t nsamps) const;
+
+    /**
+     * Splits the RX channels into streamer groups according to rx_channels_per_stream
+     *
+     * @return Indices into rx_channels, one list per streamer
+     */
+    [[nodiscard]] std::vector<std::vector<size_t>> RxStreamGroups() const;
+
+    /**
+     * Gets the cached streamer for these channels and issues the timed start command at start_time
+     */
+    uhd::rx_streamer::sptr StartRxStream(const std::vector<size_t> &channels);
+
+    /**
+     * Stops a streamer early and drains the samples still in flight
+     */
+    void StopRxStream(const uhd::rx_streamer::sptr &rx_stream);
+
+    /**
+     * ReceiveToBlocks with one streamer and receive thread per group
+     *
+     * Every group fills its channels of the current block; once all of them are done (a
+     * std::barrier), the block is committed and the next one acquired. All streamers start at
+     * start_time, so their samples stay aligned.
+     */
+    size_t ReceiveGroupsToBlocks(const std::vector<std::vector<size_t>> &groups, const RxBlockAcquire &acquire, const RxBlockCommit &commit,
+                                 std::atomic<bool> &stop_signal);
+
 public:
     uhd::time_spec_t start_time;
 
     explicit UsrpTransceiver(const std::string &args);
 
+    /**
+     * Device-less transceiver streaming through simulated streamers, for benchmarking the host side
+     *
+     * Every configuration is only stored (nothing is tuned or synchronized), the device time
+     * is the host's steady clock and the streamers are created by the factories, with the
+     * same caching as the device's. Sweeps need a device.
+     *
+     * @param num_tx_channels Number of TX channels the configurations may use
+     * @param num_rx_channels Number of RX channels the configurations may use
+     */
+    UsrpTransceiver(size_t num_tx_channels, size_t num_rx_channels, TxStreamFactory make_tx_stream, RxStreamFactory make_rx_stream);
+
     ~UsrpTransceiver() = default;
 
     /**
@@ -48,21 +430,150 @@ public:
 
     /**
      * Applies the USRP configuration to the device
+     *
+     * Only settings that differ from what was last applied, per channel, are sent to the
+     * device, so re-applying an unchanged configuration costs no control-plane round trips.
      */
     void ApplyConfiguration(const UsrpConfig &config, std::atomic<bool> &stop_signal);
 
+    /**
+     * Applies a configuration that differs from the current one only in frequencies and sample counts
+     *
+     * Used between the bursts of a schedule. Unlike ApplyConfiguration it does not wait: the
+     * channels whose frequency changed are retuned by a timed command at tune_time, queued on the
+     * device like the hops of a sweep, so a burst starting SweepSettle after tune_time runs on the
+     * new frequencies. Call CheckRetuneLocks once the last retune has run.
+     *
+     * @throws std::invalid_argument if any other setting differs
+     */
+    void ApplyTimedRetune(const UsrpConfig &config, const uhd::time_spec_t &tune_time);
+
+    /**
+     * Checks the LO and reference locks of the channels retuned by ApplyTimedRetune since the last call
+     *
+     * @throws std::runtime_error naming the sensors that are not locked; those channels are tuned again by the next ApplyConfiguration
+     */
+    void CheckRetuneLocks();
+
     void CalculateTransmissionTime();
+
+    /**
+     * Schedules the next burst right after the previous one instead of delay seconds from now
+     *
+     * @param previous_end Device time at which the previous burst ended (see BurstEndTime)
+     * @param lead Minimum time from now needed to issue the timed commands, in seconds
+     */
+    void ScheduleAfter(const uhd::time_spec_t &previous_end, double lead);
+
+    /**
+     * Device time at which a burst starting at start_time ends, from the sample counts and rates
+     *
+     * A TX buffer repeated until stopped (tx_repeat = 0) ends with the reception.
+     */
+    [[nodiscard]] uhd::time_spec_t BurstEndTime() const;
+
+    /**
+     * @return Streaming errors of the last TX and RX, summed over all streamers
+     */
+    [[nodiscard]] StreamStats Stats() const {
+        std::lock_guard lock(stats_mutex);
+        return stats;
+    }
+
+    /**
+     * @return Counters of every TX burst since startup; safe to call while streaming
+     */
+    [[nodiscard]] StreamMetricsSnapshot TxMetrics() const { return tx_metrics.Snapshot(); }
+
+    /**
+     * @return Counters of every RX burst since startup; safe to call while streaming
+     */
+    [[nodiscard]] StreamMetricsSnapshot RxMetrics() const { return rx_metrics.Snapshot(); }
+
+    /**
+     * Configuration applied by the last ApplyConfiguration call
+     */
+    [[nodiscard]] const UsrpConfig &Config() const { return usrp_config; }
+
     /**
      * Transmits samples from a buffer to USRP using a streaming approach
      *
-     * @param buffs Buffer containing complex samples organized by channel
+     * The samples are streamed directly out of the viewed memory, which must stay valid
+     * until this call returns. With tx_repeat != 1 the buffer is replayed inside a single
+     * burst, wrapping around without gaps.
+     *
+     * The calling thread is pinned and prioritized according to tx_cpus, thread_priority
+     * and numa_node, so this is meant to run on a dedicated thread.
+     *
+     * @param buffs Views of the samples (in the CPU format) organized by channel, all of the same length
      */
-    void TransmitFromBuffer(std::vector<std::vector<complexf>> &buffs, std::atomic<bool> &stop_signal);
+    void TransmitFromBuffer(const std::vector<TxChannelView> &buffs, std::atomic<bool> &stop_signal);
 
     /**
      * Receives samples from USRP to a buffer using a streaming approach
      *
-     * @return A vector of vectors containing the received complex samples, one per channel
+     * @return A vector of buffers containing the received samples in the CPU format, one per channel
+     */
+    std::vector<SampleBuffer> ReceiveToBuffer(std::atomic<bool> &stop_signal);
+
+    /**
+     * Receives samples from USRP directly into caller-provided memory
+     *
+     * No intermediate buffer is allocated: rx_stream->recv writes straight into the destinations.
+     *
+     * @param buffs Destination pointers, one per RX channel, each with room for rx_samps samples in the CPU format
+     * @return Number of samples received per channel
+     */
+    size_t ReceiveToMemory(const std::vector<std::byte *> &buffs, std::atomic<bool> &stop_signal);
+
+    /**
+     * Receives samples from USRP as a sequence of consumer-provided blocks
+     *
+     * Receives rx_samps samples per channel, or streams continuously until stop_signal is set
+     * (or acquire returns no block) when rx_samps is 0. Like TransmitFromBuffer, the calling
+     * thread is set up according to rx_cpus, thread_priority and numa_node.
+     *
+     * With rx_channels_per_stream set, the channels are split over several streamers, each
+     * received on its own thread (pinned to successive rx_cpus); acquire and commit are still
+     * called from one thread at a time. With rx_decimation > 1 the blocks receive the mixed and
+     * decimated samples (see ReceiveDecimated).
+     *
+     * @param acquire Returns the next block to fill
+     * @param commit Called for every filled (or final partial) block
+     * @return Number of samples received per channel
+     */
+    size_t ReceiveToBlocks(const RxBlockAcquire &acquire, const RxBlockCommit &commit, std::atomic<bool> &stop_signal);
+
+    /**
+     * Hops through sweep_freqs, capturing each dwell into consecutive segments of caller-provided memory
+     *
+     * Every hop is a timed retune followed, settle_time later, by a timed capture of its dwell, so
+     * the hops follow each other on the device's command queue without host round trips. A few
+     * hops are kept queued ahead of the one being received. Run TransmitFromBuffer alongside to
+     * transmit during the sweep (with tx_repeat = 0 it stops with the sweep).
+     *
+     * A hop that times out is cut short, and the streamer is stopped and flushed before the next
+     * one; queued hops that can then no longer start on time are skipped (0 samples). Stats()
+     * covers this sweep only.
+     *
+     * @param buffs Destination pointers, one per RX channel, each with room for SweepSamples(config) samples
+     * @return The segment table, one entry per hop received
+     */
+    std::vector<SweepSegment> ReceiveSweep(const std::vector<std::byte *> &buffs, std::atomic<bool> &stop_signal);
+
+    /**
+     * Streams continuously and keeps only the samples around the detections of trigger_mode
+     *
+     * The stream (decimated with rx_decimation > 1) is received on its own thread into a
+     * SampleRing whose recent blocks stay unreleased as pre-trigger history. A TriggerDetector
+     * scans trigger_channel; every detection copies trigger_pre samples before it and
+     * trigger_post samples from it, of every channel, to the end of the windows kept so far.
+     * Windows never overlap: the detector is re-armed at the end of the previous window. The
+     * capture stops after trigger_max windows, when rx_samps has no room for another one,
+     * after trigger_timeout or on stop_signal.
+     *
+     * @param buffs Destination pointers, one per RX channel, each with room for rx_samps samples
+     * @return The window table, one entry per detection
      */
-    std::vector<std::vector<complexf>> ReceiveToBuffer(std::atomic<bool> &stop_signal);
+    std::vector<TriggerWindow> ReceiveTriggered(const std::vector<std::byte *> &buffs, std::atomic<bool> &stop_signal);
 };
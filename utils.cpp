@@ -1,7 +1,18 @@
 #include "utils.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <fstream>
 #include <filesystem>
+#include <utility>
+
+#include "async_file_io.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace fs = std::filesystem;
 using std::vector;
@@ -9,90 +20,213 @@ using std::string;
 using std::complex;
 using std::format;
 
-/**
- * Loads data from multiple TX files into a buffer
- *
- * This function reads complex floating-point samples from specified files and loads them
- * into a buffer organized by channel. Each channel has its own vector of complex samples.
- *
- * @param config USRP configuration containing the TX file paths
- * @return A vector of vectors containing the loaded complex samples, one per channel
- */
-std::vector<std::vector<complexf>> LoadFileToBuffer(const UsrpConfig &config) {
-    // Create buffers for each channel
-    std::vector<std::vector<complexf>> buffs(config.tx_channels.size());
-
-    // Load data from input files into buffers
-    for (size_t index = 0; index < config.tx_channels.size(); ++index) {
-        // Get file size using std::filesystem
-        std::uintmax_t file_size = fs::file_size(config.tx_files[index]);
-
-        // Calculate number of complex samples
-        std::uintmax_t num_samples = file_size / sizeof(complexf);
+namespace {
+    // Transfers are split into chunks so every file has several requests in flight
+    constexpr size_t kIoChunkBytes = 4 << 20;
+    constexpr size_t kChunksPerFile = 4;
+
+    // Files opened for one transfer, closed when it is done
+    class FileSet {
+    public:
+        FileSet(const vector<string> &names, int flags, const char *tag) : names(names) {
+            for (const auto &name: names) {
+                int fd = open(name.c_str(), flags, 0644);
+                if (fd == -1) {
+                    UHD_LOG_ERROR(tag, format("Cannot open file: {}", name));
+                    throw std::runtime_error(format("Cannot open {}: {}", name, strerror(errno)));
+                }
+                fds.push_back(fd);
+            }
+        }
 
-        // Resize buffer to accommodate all samples
-        buffs[index].resize(num_samples);
+        ~FileSet() {
+            for (int fd: fds) {
+                close(fd);
+            }
+        }
 
-        // Open input file and read all samples
-        std::ifstream infile(config.tx_files[index], std::ios::binary);
+        FileSet(const FileSet &) = delete;
 
-        if (!infile.is_open()) {
-            UHD_LOG_ERROR("BUFFER-LOAD", format("Cannot open TX file: {}", config.tx_files[index]));
-            throw std::runtime_error("Cannot open TX file: " + config.tx_files[index]);
-        }
+        FileSet &operator=(const FileSet &) = delete;
 
-        // Read all samples from the file
-        infile.read(reinterpret_cast<char*>(buffs[index].data()), file_size);
+        vector<string> names;
+        vector<int> fds;
+    };
 
-        // Check if read was successful
-        if (static_cast<std::uintmax_t>(infile.gcount()) != file_size) {
-            UHD_LOG_WARNING("BUFFER-LOAD", format("Incomplete read for TX file: {}", config.tx_files[index]));
+    // Queues chunk after chunk of every file in turn, so the files are transferred side by side
+    template <typename Queue>
+    void TransferChunks(AsyncFileIo &io, const vector<size_t> &sizes, Queue queue) {
+        const size_t longest = sizes.empty() ? 0 : *std::ranges::max_element(sizes);
+        for (size_t offset = 0; offset < longest; offset += kIoChunkBytes) {
+            for (size_t file = 0; file < sizes.size(); ++file) {
+                if (offset < sizes[file]) {
+                    queue(file, offset, std::min(kIoChunkBytes, sizes[file] - offset));
+                }
+            }
         }
+        io.Drain();
+    }
+} // namespace
 
-        infile.close();
+/**
+ * Loads data from multiple TX files into a buffer
+ *
+ * This function reads samples in the configured CPU format from specified files and loads them
+ * into a buffer organized by channel. Each channel has its own buffer of samples. The files
+ * are read concurrently, several chunks per file at a time (see AsyncFileIo).
+ *
+ * @param config USRP configuration containing the TX file paths
+ * @return A vector of buffers containing the loaded samples, one per channel
+ */
+std::vector<SampleBuffer> LoadFileToBuffer(const UsrpConfig &config) {
+    const size_t sample_size = SampleSize(config.cpu_format);
+    const vector<string> names(config.tx_files.begin(), config.tx_files.begin() + std::min(config.tx_files.size(), config.tx_channels.size()));
+
+    // Create buffers for each channel, sized to the whole samples in its file
+    std::vector<SampleBuffer> buffs(names.size());
+    vector<size_t> sizes;
+    for (size_t index = 0; index < names.size(); ++index) {
+        std::uintmax_t file_size = fs::file_size(names[index]);
+        file_size -= file_size % sample_size;
+        buffs[index].resize(file_size);
+        sizes.push_back(file_size);
     }
 
-    UHD_LOG_INFO("BUFFER-LOAD", format("Loaded {} channels of TX data", buffs.size()));
+    FileSet files(names, O_RDONLY, "BUFFER-LOAD");
+    AsyncFileIo io(files.fds, files.names, kChunksPerFile * names.size());
+    TransferChunks(io, sizes, [&](size_t file, size_t offset, size_t bytes) { io.Read(file, buffs[file].data() + offset, bytes, offset, file); });
+
+    UHD_LOG_INFO("BUFFER-LOAD", format("Loaded {} channels of TX data ({})", buffs.size(), io.Backend()));
     return buffs;
 }
 
 /**
  * Writes samples from a buffer to files
  *
- * This function takes complex floating-point samples from a buffer and writes them
- * to specified files. Each channel's samples are written to its corresponding file.
+ * This function takes samples in the configured CPU format from a buffer and writes them
+ * to specified files. Each channel's samples are written to its corresponding file; the
+ * files are written concurrently, several chunks per file at a time (see AsyncFileIo).
  *
  * @param config USRP configuration containing the RX file paths
- * @param buffs Buffer containing complex samples organized by channel
+ * @param buffs Buffer containing samples organized by channel
  */
-void WriteBufferToFile(const UsrpConfig &config, const std::vector<std::vector<complexf>> &buffs) {
+void WriteBufferToFile(const UsrpConfig &config, const std::vector<SampleBuffer> &buffs) {
     // Create output files for each channel
-    std::vector<std::shared_ptr<std::ofstream>> outfiles;
-
+    FileSet files(config.rx_files, O_WRONLY | O_CREAT | O_TRUNC, "BUFFER-WRITE");
     for (const auto &rx_file: config.rx_files) {
-        outfiles.push_back(std::make_shared<std::ofstream>(rx_file, std::ofstream::binary));
-
-        if (not outfiles.back()->is_open()) {
-            UHD_LOG_ERROR("BUFFER-WRITE", format("Cannot open receive file: {}", rx_file));
-            throw std::runtime_error("Cannot open receive file: " + rx_file);
-        }
         UHD_LOG_INFO("BUFFER-WRITE", format("Rx channel saving to file: {}", rx_file));
     }
 
     // Write samples from buffer to files
-    for (size_t i = 0; i < outfiles.size(); ++i) {
-        if (i < buffs.size()) {
-            outfiles[i]->write(reinterpret_cast<const char*>(buffs[i].data()),
-                               buffs[i].size() * sizeof(complexf));
+    vector<size_t> sizes;
+    for (size_t i = 0; i < files.fds.size() and i < buffs.size(); ++i) {
+        sizes.push_back(buffs[i].size());
+    }
+    AsyncFileIo io(files.fds, files.names, kChunksPerFile * files.fds.size());
+    TransferChunks(io, sizes, [&](size_t file, size_t offset, size_t bytes) { io.Write(file, buffs[file].data() + offset, bytes, offset, file); });
+
+    UHD_LOG_INFO("BUFFER-WRITE", format("Write completed! Files written: {} ({})", files.fds.size(), io.Backend()));
+}
+
+void WriteSweepTable(const string &filename, const vector<SweepSegment> &segments) {
+    std::ofstream table(filename);
+    if (not table.is_open()) {
+        UHD_LOG_ERROR("BUFFER-WRITE", format("Cannot open sweep table: {}", filename));
+        throw std::runtime_error("Cannot open sweep table: " + filename);
+    }
+    table << "freq_hz,start_sample,nsamps,time_s\n";
+    for (const auto &segment: segments) {
+        table << format("{:.3f},{},{},{:.9f}\n", segment.freq, segment.offset, segment.nsamps, segment.time_spec.get_real_secs());
+    }
+    UHD_LOG_INFO("BUFFER-WRITE", format("Sweep table written to {} ({} hops)", filename, segments.size()));
+}
+
+void WriteTriggerTable(const string &filename, const vector<TriggerWindow> &windows) {
+    std::ofstream table(filename);
+    if (not table.is_open()) {
+        UHD_LOG_ERROR("BUFFER-WRITE", format("Cannot open trigger table: {}", filename));
+        throw std::runtime_error("Cannot open trigger table: " + filename);
+    }
+    table << "start_sample,nsamps,time_s,trigger_time_s,metric\n";
+    for (const auto &window: windows) {
+        table << format("{},{},{:.9f},{:.9f},{:.3f}\n", window.offset, window.nsamps, window.time_spec.get_real_secs(), window.trigger_time.get_real_secs(),
+                        window.metric);
+    }
+    UHD_LOG_INFO("BUFFER-WRITE", format("Trigger table written to {} ({} windows)", filename, windows.size()));
+}
+namespace {
+    // How much of each file the kernel is asked to read ahead before transmission starts
+    constexpr size_t kInitialReadahead = 64 << 20;
+}
+
+MappedFile::MappedFile(const std::string &filename, const size_t sample_size) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+        UHD_LOG_ERROR("BUFFER-MAP", format("Cannot open TX file: {}", filename));
+        throw std::runtime_error(format("Cannot open TX file {}: {}", filename, strerror(errno)));
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        throw std::runtime_error(format("Cannot stat TX file {}: {}", filename, strerror(errno)));
+    }
+
+    mapped_bytes = st.st_size - st.st_size % sample_size;
+    if (mapped_bytes != static_cast<size_t>(st.st_size)) {
+        UHD_LOG_WARNING("BUFFER-MAP", format("TX file {} has a trailing partial sample, ignoring it", filename));
+    }
+
+    if (mapped_bytes > 0) {
+        void *ptr = mmap(nullptr, mapped_bytes, PROT_READ, MAP_SHARED, fd, 0);
+        if (ptr == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error(format("Cannot map TX file {}: {}", filename, strerror(errno)));
         }
+        data = static_cast<const std::byte *>(ptr);
+
+        // Samples are consumed front to back: read ahead aggressively and drop pages behind
+        madvise(ptr, mapped_bytes, MADV_SEQUENTIAL);
+        madvise(ptr, std::min(mapped_bytes, kInitialReadahead), MADV_WILLNEED);
     }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data) {
+        munmap(const_cast<std::byte *>(data), mapped_bytes);
+    }
+}
 
-    // Close all output files
-    for (auto &outfile: outfiles) {
-        if (outfile->is_open()) {
-            outfile->close();
+MappedFile::MappedFile(MappedFile &&other) noexcept :
+    data(std::exchange(other.data, nullptr)), mapped_bytes(std::exchange(other.mapped_bytes, 0)) {}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+        if (data) {
+            munmap(const_cast<std::byte *>(data), mapped_bytes);
         }
+        data = std::exchange(other.data, nullptr);
+        mapped_bytes = std::exchange(other.mapped_bytes, 0);
     }
+    return *this;
+}
 
-    UHD_LOG_INFO("BUFFER-WRITE", "Write completed! Files written: " << outfiles.size());
-}
\ No newline at end of file
+/**
+ * Maps multiple TX files into memory
+ *
+ * @param config USRP configuration containing the TX file paths
+ * @return One mapping per TX channel
+ */
+std::vector<MappedFile> MapFilesToBuffer(const UsrpConfig &config) {
+    const size_t sample_size = SampleSize(config.cpu_format);
+
+    std::vector<MappedFile> files;
+    files.reserve(config.tx_channels.size());
+    for (size_t index = 0; index < config.tx_channels.size(); ++index) {
+        files.emplace_back(config.tx_files[index], sample_size);
+    }
+
+    UHD_LOG_INFO("BUFFER-MAP", format("Mapped {} channels of TX data", files.size()));
+    return files;
+}
@@ -2,30 +2,97 @@
 #include <uhd/usrp/multi_usrp.hpp>
 #include <complex>
 #include <csignal>
+#include <string>
 #include <vector>
 #include "usrp_transceiver.h"
-// Complex floating-point type for samples (fc32 format)
-using complexf = std::complex<float>;
 
 
 /**
  * Loads data from multiple TX files into a buffer
  *
- * This function reads complex floating-point samples from specified files and loads them
- * into a buffer organized by channel. Each channel has its own vector of complex samples.
+ * This function reads samples in the configured CPU format from specified files and loads them
+ * into a buffer organized by channel. Each channel has its own buffer of samples.
  *
  * @param config USRP configuration containing the TX file paths
- * @return A vector of vectors containing the loaded complex samples, one per channel
+ * @return A vector of buffers containing the loaded samples, one per channel
  */
-std::vector<std::vector<complexf>> LoadFileToBuffer(const UsrpConfig &config);
+std::vector<SampleBuffer> LoadFileToBuffer(const UsrpConfig &config);
 
 /**
  * Writes samples from a buffer to files
  *
- * This function takes complex floating-point samples from a buffer and writes them
+ * This function takes samples in the configured CPU format from a buffer and writes them
  * to specified files. Each channel's samples are written to its corresponding file.
  *
  * @param config USRP configuration containing the RX file paths
- * @param buffs Buffer containing complex samples organized by channel
+ * @param buffs Buffer containing samples organized by channel
  */
-void WriteBufferToFile(const UsrpConfig &config, const std::vector<std::vector<complexf>> &buffs);
+void WriteBufferToFile(const UsrpConfig &config, const std::vector<SampleBuffer> &buffs);
+
+/**
+ * Writes the segment table of a frequency sweep as CSV
+ *
+ * One line per hop: frequency, first sample and number of samples within each RX file,
+ * and the device time of the first sample.
+ *
+ * @param filename CSV file to write
+ * @param segments Hops as returned by UsrpTransceiver::ReceiveSweep
+ */
+void WriteSweepTable(const std::string &filename, const std::vector<SweepSegment> &segments);
+
+/**
+ * Writes the window table of a triggered capture as CSV
+ *
+ * One line per trigger: first sample and number of samples within each RX file, the device
+ * times of the first sample and of the detection, and the detector metric.
+ *
+ * @param filename CSV file to write
+ * @param windows Windows as returned by UsrpTransceiver::ReceiveTriggered
+ */
+void WriteTriggerTable(const std::string &filename, const std::vector<TriggerWindow> &windows);
+
+/**
+ * Read-only memory mapping of a sample file
+ *
+ * The file is paged in on demand while it is being transmitted, so transmission can start
+ * without reading the whole file first and the samples are not duplicated outside the page cache.
+ */
+class MappedFile {
+public:
+    /**
+     * @param filename Sample file to map
+     * @param sample_size Size of one sample in the file's format, in bytes
+     */
+    MappedFile(const std::string &filename, size_t sample_size);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile &&other) noexcept;
+
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    /**
+     * @return View of the samples in the file
+     */
+    [[nodiscard]] TxChannelView view() const { return {data, mapped_bytes}; }
+
+private:
+    const std::byte *data{nullptr};
+    size_t mapped_bytes{0};
+};
+
+/**
+ * Maps multiple TX files into memory
+ *
+ * Replaces LoadFileToBuffer for transmission: the returned mappings are read sequentially
+ * by the kernel (MADV_SEQUENTIAL with read-ahead), so start-up does not wait for the files
+ * to be read and resident memory stays close to the working set.
+ *
+ * @param config USRP configuration containing the TX file paths
+ * @return One mapping per TX channel
+ */
+std::vector<MappedFile> MapFilesToBuffer(const UsrpConfig &config);